@@ -0,0 +1,74 @@
+#ifndef __DEEP_PHYSICS_BENCH_H__
+#define __DEEP_PHYSICS_BENCH_H__
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+namespace DPhy
+{
+struct BenchResult
+{
+	std::string name;
+	int iterations;
+	double mean_us;
+	double median_us;
+	double min_us;
+	double max_us;
+};
+// Times fn() iterations times after a short warm-up and reports per-call statistics in microseconds.
+template<class F>
+BenchResult RunBench(const std::string& name, int iterations, F fn)
+{
+	for(int i = 0; i < std::max(1, iterations / 10); i++)
+		fn();
+
+	std::vector<double> times(iterations);
+	for(int i = 0; i < iterations; i++) {
+		auto t0 = std::chrono::steady_clock::now();
+		fn();
+		auto t1 = std::chrono::steady_clock::now();
+		times[i] = std::chrono::duration<double, std::micro>(t1 - t0).count();
+	}
+	BenchResult r;
+	r.name = name;
+	r.iterations = iterations;
+	r.mean_us = 0;
+	for(int i = 0; i < iterations; i++)
+		r.mean_us += times[i];
+	r.mean_us /= iterations;
+	r.min_us = *std::min_element(times.begin(), times.end());
+	r.max_us = *std::max_element(times.begin(), times.end());
+	std::nth_element(times.begin(), times.begin() + iterations / 2, times.end());
+	r.median_us = times[iterations / 2];
+	return r;
+}
+inline void PrintBench(const BenchResult& r)
+{
+	std::cout << std::left << std::setw(40) << r.name << std::right
+			  << " mean " << std::setw(10) << std::fixed << std::setprecision(3) << r.mean_us << " us"
+			  << "  median " << std::setw(10) << r.median_us << " us"
+			  << "  min " << std::setw(10) << r.min_us << " us"
+			  << "  max " << std::setw(10) << r.max_us << " us"
+			  << "  (" << r.iterations << " iterations)" << std::endl;
+}
+// One object per run, {"tag": ..., "results": [{"name": ..., "iterations": ..., "mean_us": ...}, ...]}, so runs of
+// different commits can be compared by name.
+inline void WriteBenchJSON(const std::string& path, const std::string& tag, const std::vector<BenchResult>& results)
+{
+	std::ofstream ofs(path);
+	ofs << std::setprecision(6) << std::fixed;
+	ofs << "{\n  \"tag\": \"" << tag << "\",\n  \"results\": [";
+	for(int i = 0; i < results.size(); i++) {
+		const BenchResult& r = results[i];
+		ofs << (i == 0 ? "\n" : ",\n")
+			<< "    {\"name\": \"" << r.name << "\", \"iterations\": " << r.iterations
+			<< ", \"mean_us\": " << r.mean_us << ", \"median_us\": " << r.median_us
+			<< ", \"min_us\": " << r.min_us << ", \"max_us\": " << r.max_us << "}";
+	}
+	ofs << "\n  ]\n}\n";
+}
+}
+#endif
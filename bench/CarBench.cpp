@@ -0,0 +1,340 @@
+#include "Controller.h"
+#include "ReferenceManager.h"
+#include "RegressionMemory.h"
+#include "MultilevelSpline.h"
+#include "BVH.h"
+#include "Bench.h"
+#include <boost/program_options.hpp>
+#include <functional>
+#include <random>
+// Suite of the hot paths of training on the bundled assets. Every benchmark is registered by name with its own
+// iteration count (scaled by --scale), --filter runs the ones whose name contains the given string and --json
+// writes the results for comparing commits.
+struct BenchSetup
+{
+	std::string bvh;
+	DPhy::Character* character;
+	DPhy::ReferenceManager* referenceManager;
+	DPhy::Controller* controller;
+	DPhy::RegressionMemory* regressionMemory;
+};
+struct BenchEntry
+{
+	std::string name;
+	int iterations;
+	std::function<DPhy::BenchResult(BenchSetup&, const std::string&, int)> run;
+};
+static DPhy::RegressionMemory*
+CreateRegressionMemory(BenchSetup& setup, int num_samples)
+{
+	int dof = setup.character->GetSkeleton()->getNumDofs() + 1;
+	int num_knots = setup.referenceManager->GetNumCPS();
+	Eigen::VectorXd base(1), lo(1), hi(1), unit(1);
+	base << 0;
+	lo << -2;
+	hi << 0.5;
+	unit << 0.1;
+	DPhy::RegressionMemory* memory = new DPhy::RegressionMemory();
+	memory->InitParamSpace(base, std::make_pair(lo, hi), unit, dof, num_knots);
+
+	std::mt19937 gen(0);
+	std::uniform_real_distribution<double> param(-2, 0.5), reward(0, 1);
+	for(int i = 0; i < num_samples; i++) {
+		Eigen::VectorXd p(1);
+		p << param(gen);
+		std::vector<Eigen::VectorXd> cps(num_knots, Eigen::VectorXd::Constant(dof, reward(gen)));
+		memory->UpdateParamSpace(std::make_tuple(cps, p, reward(gen)));
+	}
+	return memory;
+}
+static std::vector<BenchEntry>
+CreateBenchmarks()
+{
+	std::vector<BenchEntry> b;
+	b.push_back({"Controller::Step", 300, [](BenchSetup& s, const std::string& name, int n) {
+		DPhy::Controller* c = s.controller;
+		Eigen::VectorXd action = Eigen::VectorXd::Zero(c->GetNumAction());
+		return DPhy::RunBench(name, n, [&]() {
+			if(c->IsTerminalState())
+				c->Reset(true);
+			c->SetAction(action);
+			c->Step();
+		});
+	}});
+	b.push_back({"Controller::Step (warm started contacts)", 300, [](BenchSetup& s, const std::string& name, int n) {
+		DPhy::Controller* c = s.controller;
+		Eigen::VectorXd action = Eigen::VectorXd::Zero(c->GetNumAction());
+		c->SetWarmStartContacts(true);
+		c->GetContactSolver()->ClearStats();
+		DPhy::BenchResult r = DPhy::RunBench(name, n, [&]() {
+			if(c->IsTerminalState())
+				c->Reset(true);
+			c->SetAction(action);
+			c->Step();
+		});
+		DPhy::WarmStartPgsSolver* solver = c->GetContactSolver();
+		std::cout << "sweeps per solve : " << solver->GetNumIterations() / std::max(1.0, (double)solver->GetNumSolves())
+				  << ", warm started solves : " << solver->GetNumWarmStarts() << " / " << solver->GetNumSolves() << std::endl;
+
+		// the same zero action rollout from frame 0 with the cold and the warm started solver
+		std::vector<Eigen::VectorXd> positions[2];
+		int reason[2];
+		for(int k = 0; k < 2; k++) {
+			c->SetWarmStartContacts(k == 1);
+			c->Reset(false);
+			while(!c->IsTerminalState() && positions[k].size() < 300) {
+				c->SetAction(action);
+				c->Step();
+				positions[k].push_back(c->GetSkeleton()->getPositions());
+			}
+			reason[k] = c->GetTerminationReason();
+		}
+		c->SetWarmStartContacts(false);
+		double diff = 0;
+		for(int i = 0; i < std::min(positions[0].size(), positions[1].size()); i++)
+			diff = std::max(diff, (positions[0][i] - positions[1][i]).cwiseAbs().maxCoeff());
+		std::cout << "warm rollout : " << positions[1].size() << " steps, termination " << reason[1]
+				  << ", cold : " << positions[0].size() << " steps, termination " << reason[0]
+				  << ", max position difference : " << diff << std::endl;
+		return r;
+	}});
+	b.push_back({"Controller::Step (filtered collisions)", 300, [](BenchSetup& s, const std::string& name, int n) {
+		DPhy::Controller* c = s.controller;
+		Eigen::VectorXd action = Eigen::VectorXd::Zero(c->GetNumAction());
+		c->SetCollisionFiltering(true);
+		DPhy::BenchResult r = DPhy::RunBench(name, n, [&]() {
+			if(c->IsTerminalState())
+				c->Reset(true);
+			c->SetAction(action);
+			c->Step();
+		});
+
+		// the ground plane cull only skips pairs that cannot touch, so a falling rollout must not change with it
+		std::vector<Eigen::VectorXd> positions[2];
+		int reason[2];
+		for(int k = 0; k < 2; k++) {
+			c->SetCollisionFiltering(k == 1);
+			c->Reset(false);
+			while(!c->IsTerminalState() && positions[k].size() < 300) {
+				c->SetAction(action);
+				c->Step();
+				positions[k].push_back(c->GetSkeleton()->getPositions());
+			}
+			reason[k] = c->GetTerminationReason();
+		}
+		c->SetCollisionFiltering(false);
+		double diff = 0;
+		for(int i = 0; i < std::min(positions[0].size(), positions[1].size()); i++)
+			diff = std::max(diff, (positions[0][i] - positions[1][i]).cwiseAbs().maxCoeff());
+		std::cout << "filtered rollout : " << positions[1].size() << " steps, termination " << reason[1]
+				  << ", unfiltered : " << positions[0].size() << " steps, termination " << reason[0]
+				  << ", max position difference : " << diff << std::endl;
+		return r;
+	}});
+	b.push_back({"Character::GetSPDForces (dense inverse)", 2000, [](BenchSetup& s, const std::string& name, int n) {
+		DPhy::Character* c = s.character;
+		c->SetPDParameters(600, 49);
+		c->GetSkeleton()->setPositions(s.referenceManager->GetPosition(0, false));
+		Eigen::VectorXd target = s.referenceManager->GetPosition(1, false);
+		Eigen::VectorXd zero = Eigen::VectorXd::Zero(target.rows());
+		return DPhy::RunBench(name, n, [&]() {
+			Eigen::VectorXd tau = c->GetSPDForces(target, zero);
+		});
+	}});
+	b.push_back({"Character::GetFactorizedSPDForces", 2000, [](BenchSetup& s, const std::string& name, int n) {
+		DPhy::Character* c = s.character;
+		c->SetPDParameters(600, 49);
+		c->GetSkeleton()->setPositions(s.referenceManager->GetPosition(0, false));
+		Eigen::VectorXd target = s.referenceManager->GetPosition(1, false);
+		Eigen::VectorXd zero = Eigen::VectorXd::Zero(target.rows());
+		Eigen::VectorXd diff = c->GetSPDForces(target, zero) - c->GetFactorizedSPDForces(target, zero);
+		std::cout << "max difference to the dense inverse : " << diff.cwiseAbs().maxCoeff() << std::endl;
+		return DPhy::RunBench(name, n, [&]() {
+			// forces a new factorization every call, like a substep with changed positions
+			c->InvalidateSPDFactor();
+			Eigen::VectorXd tau = c->GetFactorizedSPDForces(target, zero);
+		});
+	}});
+	b.push_back({"Controller::GetState", 5000, [](BenchSetup& s, const std::string& name, int n) {
+		return DPhy::RunBench(name, n, [&]() {
+			Eigen::VectorXd state = s.controller->GetState();
+		});
+	}});
+	b.push_back({"ReferenceManager::GetMotion", 20000, [](BenchSetup& s, const std::string& name, int n) {
+		std::mt19937 gen(0);
+		std::uniform_real_distribution<double> t(0, s.referenceManager->GetPhaseLength() * 3);
+		return DPhy::RunBench(name, n, [&]() {
+			DPhy::Motion* m = s.referenceManager->GetMotion(t(gen), false);
+			delete m;
+		});
+	}});
+	b.push_back({"ReferenceManager::AddDisplacementToBVH", 200, [](BenchSetup& s, const std::string& name, int n) {
+		DPhy::ReferenceManager* rm = s.referenceManager;
+		int len = rm->GetPhaseLength();
+		std::vector<Eigen::VectorXd> zero(len, Eigen::VectorXd::Zero(rm->GetDOF())), position;
+		DPhy::BenchResult r = DPhy::RunBench(name, n, [&]() {
+			rm->AddDisplacementToBVH(zero, position);
+		});
+
+		// a zero displacement gives back the reference, and the reference has a zero displacement, with foot lock on
+		std::vector<std::pair<Eigen::VectorXd, double>> reference, displacement;
+		double diff_add = 0;
+		for(int i = 0; i < len; i++) {
+			reference.push_back(std::make_pair(rm->GetPhasePosition(i), (double)i));
+			diff_add = std::max(diff_add, (position[i] - reference[i].first).cwiseAbs().maxCoeff());
+		}
+		rm->GetDisplacementWithBVH(reference, displacement);
+		double diff_get = 0;
+		for(int i = 0; i < len; i++)
+			diff_get = std::max(diff_get, displacement[i].first.cwiseAbs().maxCoeff());
+		std::cout << "max difference of zero displacement to the reference : " << diff_add
+				  << ", max displacement of the reference : " << diff_get << std::endl;
+		return r;
+	}});
+	b.push_back({"ReferenceManager::GenerateMotionsFromSinglePhase (no foot lock)", 20, [](BenchSetup& s, const std::string& name, int n) {
+		std::vector<DPhy::Motion*> phase, gen;
+		for(int i = 0; i < s.referenceManager->GetPhaseLength(); i++)
+			phase.push_back(s.referenceManager->GetMotion(i, false));
+		s.referenceManager->SetFootLock(false);
+		DPhy::BenchResult r = DPhy::RunBench(name, n, [&]() {
+			s.referenceManager->GenerateMotionsFromSinglePhase(1000, false, phase, gen);
+		});
+		s.referenceManager->SetFootLock(true);
+		for(int i = 0; i < phase.size(); i++)
+			delete phase[i];
+		for(int i = 0; i < gen.size(); i++)
+			delete gen[i];
+		return r;
+	}});
+	b.push_back({"ReferenceManager::GenerateMotionsFromSinglePhase", 20, [](BenchSetup& s, const std::string& name, int n) {
+		std::vector<DPhy::Motion*> phase, gen;
+		for(int i = 0; i < s.referenceManager->GetPhaseLength(); i++)
+			phase.push_back(s.referenceManager->GetMotion(i, false));
+		DPhy::BenchResult r = DPhy::RunBench(name, n, [&]() {
+			s.referenceManager->GenerateMotionsFromSinglePhase(1000, false, phase, gen);
+		});
+		for(int i = 0; i < phase.size(); i++)
+			delete phase[i];
+		for(int i = 0; i < gen.size(); i++)
+			delete gen[i];
+		return r;
+	}});
+	b.push_back({"RegressionMemory::UpdateParamSpace", 2000, [](BenchSetup& s, const std::string& name, int n) {
+		DPhy::RegressionMemory* memory = CreateRegressionMemory(s, 0);
+		int dof = s.character->GetSkeleton()->getNumDofs() + 1;
+		std::vector<Eigen::VectorXd> cps(s.referenceManager->GetNumCPS(), Eigen::VectorXd::Zero(dof));
+		std::mt19937 gen(1);
+		std::uniform_real_distribution<double> param(-2, 0.5), reward(0, 1);
+		DPhy::BenchResult r = DPhy::RunBench(name, n, [&]() {
+			Eigen::VectorXd p(1);
+			p << param(gen);
+			memory->UpdateParamSpace(std::make_tuple(cps, p, reward(gen)));
+		});
+		delete memory;
+		return r;
+	}});
+	b.push_back({"RegressionMemory::GetDensity", 20000, [](BenchSetup& s, const std::string& name, int n) {
+		std::mt19937 gen(2);
+		std::uniform_real_distribution<double> param(0, 1);
+		return DPhy::RunBench(name, n, [&]() {
+			Eigen::VectorXd p(1);
+			p << param(gen);
+			s.regressionMemory->GetDensity(p);
+		});
+	}});
+	b.push_back({"RegressionMemory::GetNearestParams", 20000, [](BenchSetup& s, const std::string& name, int n) {
+		std::mt19937 gen(3);
+		std::uniform_real_distribution<double> param(0, 1);
+		return DPhy::RunBench(name, n, [&]() {
+			Eigen::VectorXd p(1);
+			p << param(gen);
+			s.regressionMemory->GetNearestParams(p, 5, true);
+		});
+	}});
+	b.push_back({"BVH::Parse", 50, [](BenchSetup& s, const std::string& name, int n) {
+		std::string path = std::string(CAR_DIR) + "/motion/" + s.bvh;
+		return DPhy::RunBench(name, n, [&]() {
+			DPhy::BVH* bvh = new DPhy::BVH();
+			bvh->Parse(path);
+			delete bvh;
+		});
+	}});
+	b.push_back({"MultilevelSpline::ConvertMotionToSpline", 200, [](BenchSetup& s, const std::string& name, int n) {
+		int phase_length = s.referenceManager->GetPhaseLength();
+		std::vector<std::pair<Eigen::VectorXd, double>> motion;
+		for(int i = 0; i < phase_length; i++)
+			motion.push_back(std::make_pair(s.referenceManager->GetPosition(i, false), (double)i));
+		DPhy::MultilevelSpline* spline = new DPhy::MultilevelSpline(1, phase_length);
+		spline->SetKnots(0, 4.0);
+		DPhy::BenchResult r = DPhy::RunBench(name, n, [&]() {
+			spline->ConvertMotionToSpline(motion);
+		});
+		delete spline;
+		return r;
+	}});
+	b.push_back({"MultilevelSpline::ConvertMotionToSpline (cold)", 50, [](BenchSetup& s, const std::string& name, int n) {
+		int phase_length = s.referenceManager->GetPhaseLength();
+		std::vector<std::pair<Eigen::VectorXd, double>> motion;
+		for(int i = 0; i < phase_length; i++)
+			motion.push_back(std::make_pair(s.referenceManager->GetPosition(i, false), (double)i));
+		DPhy::MultilevelSpline* spline = new DPhy::MultilevelSpline(1, phase_length);
+		spline->SetKnots(0, 4.0);
+		DPhy::BenchResult r = DPhy::RunBench(name, n, [&]() {
+			DPhy::Spline::ClearFitCache();
+			spline->ConvertMotionToSpline(motion);
+		});
+		delete spline;
+		return r;
+	}});
+	return b;
+}
+int main(int argc, char** argv)
+{
+	boost::program_options::options_description desc("allowed options");
+	desc.add_options()
+	("bvh,b", boost::program_options::value<std::string>()->default_value("walk_phase.bvh"))
+	("filter,f", boost::program_options::value<std::string>()->default_value(""))
+	("scale,s", boost::program_options::value<double>()->default_value(1.0))
+	("json,j", boost::program_options::value<std::string>()->default_value(""))
+	("tag,t", boost::program_options::value<std::string>()->default_value(""))
+	("list,l", "list benchmarks")
+	;
+	boost::program_options::variables_map vm;
+	boost::program_options::store(boost::program_options::parse_command_line(argc, argv, desc), vm);
+
+	std::vector<BenchEntry> benchmarks = CreateBenchmarks();
+	if(vm.count("list")) {
+		for(int i = 0; i < benchmarks.size(); i++)
+			std::cout << benchmarks[i].name << std::endl;
+		return 0;
+	}
+	std::string filter = vm["filter"].as<std::string>();
+	double scale = vm["scale"].as<double>();
+
+	BenchSetup setup;
+	setup.bvh = vm["bvh"].as<std::string>();
+	std::string path = std::string(CAR_DIR)+std::string("/character/") + std::string(REF_CHARACTER_TYPE) + std::string(".xml");
+	setup.character = new DPhy::Character(path);
+	setup.referenceManager = new DPhy::ReferenceManager(setup.character);
+	setup.referenceManager->LoadMotionFromBVH("/motion/" + setup.bvh);
+	setup.referenceManager->InitOptimization(1, "");
+	setup.controller = new DPhy::Controller(setup.referenceManager, false, false, false, 0);
+	setup.controller->Reset(true);
+	setup.regressionMemory = CreateRegressionMemory(setup, 2000);
+	std::cout << "car bench : " << setup.bvh << ", dof " << setup.character->GetSkeleton()->getNumDofs()
+			  << ", phase length " << setup.referenceManager->GetPhaseLength() << std::endl;
+
+	std::vector<DPhy::BenchResult> results;
+	for(int i = 0; i < benchmarks.size(); i++) {
+		if(benchmarks[i].name.find(filter) == std::string::npos)
+			continue;
+		int n = std::max(1, (int)(benchmarks[i].iterations * scale));
+		results.push_back(benchmarks[i].run(setup, benchmarks[i].name, n));
+		DPhy::PrintBench(results.back());
+	}
+
+	std::string json = vm["json"].as<std::string>();
+	if(json != "")
+		DPhy::WriteBenchJSON(json, vm["tag"].as<std::string>(), results);
+	return 0;
+}
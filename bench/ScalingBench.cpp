@@ -0,0 +1,107 @@
+#include "Controller.h"
+#include "ReferenceManager.h"
+#include "SlaveScheduler.h"
+#include "Bench.h"
+#include <boost/program_options.hpp>
+#include <omp.h>
+#include <random>
+#include <sstream>
+// Throughput of stepping all slaves through the work-stealing scheduler, for every combination of slave and thread
+// counts. Actions are fixed random vectors so runs are repeatable. One CSV row per combination:
+// num_slaves, num_threads, steps, samples_per_sec, p50_ms, p99_ms, efficiency
+// where efficiency is samples/sec divided by num_threads times the single thread rate with the same slaves.
+static std::vector<int>
+ParseList(const std::string& s)
+{
+	std::vector<int> l;
+	std::stringstream ss(s);
+	std::string item;
+	while(std::getline(ss, item, ','))
+		l.push_back(std::atoi(item.c_str()));
+	return l;
+}
+int main(int argc, char** argv)
+{
+	boost::program_options::options_description desc("allowed options");
+	desc.add_options()
+	("bvh,b", boost::program_options::value<std::string>()->default_value("walk_phase.bvh"))
+	("slaves,n", boost::program_options::value<std::string>()->default_value("1,2,4,8,16"))
+	("threads,t", boost::program_options::value<std::string>()->default_value("1,2,4,8,16"))
+	("steps,s", boost::program_options::value<int>()->default_value(200))
+	("csv,c", boost::program_options::value<std::string>()->default_value(""))
+	;
+	boost::program_options::variables_map vm;
+	boost::program_options::store(boost::program_options::parse_command_line(argc, argv, desc), vm);
+
+	std::string bvh = vm["bvh"].as<std::string>();
+	std::vector<int> slave_counts = ParseList(vm["slaves"].as<std::string>());
+	std::vector<int> thread_counts = ParseList(vm["threads"].as<std::string>());
+	int num_steps = vm["steps"].as<int>();
+
+	std::string path = std::string(CAR_DIR)+std::string("/character/") + std::string(REF_CHARACTER_TYPE) + std::string(".xml");
+	DPhy::Character* character = new DPhy::Character(path);
+	DPhy::ReferenceManager* referenceManager = new DPhy::ReferenceManager(character);
+	referenceManager->LoadMotionFromBVH("/motion/" + bvh);
+	int max_slaves = *std::max_element(slave_counts.begin(), slave_counts.end());
+	referenceManager->InitOptimization(max_slaves, "");
+
+	std::vector<DPhy::Controller*> slaves;
+	for(int i = 0; i < max_slaves; i++)
+		slaves.push_back(new DPhy::Controller(referenceManager, false, false, false, i));
+
+	std::mt19937 gen(0);
+	std::normal_distribution<double> noise(0.0, 1.0);
+	std::vector<Eigen::VectorXd> actions(max_slaves, Eigen::VectorXd(slaves[0]->GetNumAction()));
+	for(int i = 0; i < max_slaves; i++) {
+		for(int j = 0; j < actions[i].rows(); j++)
+			actions[i][j] = noise(gen);
+	}
+
+	std::stringstream csv;
+	csv << "num_slaves,num_threads,steps,samples_per_sec,p50_ms,p99_ms,efficiency" << std::endl;
+	for(int num_slaves : slave_counts) {
+		double base_rate = 0;
+		for(int num_threads : thread_counts) {
+			SlaveScheduler scheduler(num_threads);
+			std::vector<int> jobs;
+			for(int i = 0; i < num_slaves; i++) {
+				jobs.push_back(i);
+				slaves[i]->Reset(true);
+			}
+
+			std::vector<double> latency(num_steps);
+			double t0 = omp_get_wtime();
+			for(int k = 0; k < num_steps; k++) {
+				double t_step = omp_get_wtime();
+				scheduler.Run(jobs, [&](int id) {
+					slaves[id]->SetAction(actions[id]);
+					slaves[id]->Step();
+					if(slaves[id]->IsTerminalState()) {
+						// RSI draws from the shared dart random generator
+#pragma omp critical(scaling_reset)
+						slaves[id]->Reset(true);
+					}
+				});
+				latency[k] = (omp_get_wtime() - t_step) * 1000;
+			}
+			double rate = num_slaves * num_steps / (omp_get_wtime() - t0);
+
+			std::sort(latency.begin(), latency.end());
+			if(base_rate == 0)
+				base_rate = rate / num_threads;
+			csv << num_slaves << "," << num_threads << "," << num_steps << "," << rate << ","
+				<< latency[num_steps / 2] << "," << latency[std::min(num_steps - 1, num_steps * 99 / 100)] << ","
+				<< rate / (num_threads * base_rate) << std::endl;
+			std::cout << num_slaves << " slaves, " << num_threads << " threads : " << rate << " samples/sec" << std::endl;
+		}
+	}
+
+	std::string csv_path = vm["csv"].as<std::string>();
+	if(csv_path != "") {
+		std::ofstream ofs(csv_path);
+		ofs << csv.str();
+	} else {
+		std::cout << csv.str();
+	}
+	return 0;
+}
@@ -0,0 +1,79 @@
+#include "ReferenceManager.h"
+#include "MultilevelSpline.h"
+#include "Bench.h"
+#include <cstdlib>
+#include <random>
+// Compares spline to motion conversion frame by frame (one GetPosition per level per frame, the path
+// render/SplineWindow used) against the batch evaluator, on the phase length of a reference motion with knots
+// every knot_interval frames.
+int main(int argc, char** argv)
+{
+	std::string bvh = "walk_phase.bvh";
+	int num_levels = 1;
+	int knot_interval = 4;
+	int iterations = 2000;
+	if(argc > 1) bvh = argv[1];
+	if(argc > 2) num_levels = std::atoi(argv[2]);
+	if(argc > 3) knot_interval = std::atoi(argv[3]);
+	if(argc > 4) iterations = std::atoi(argv[4]);
+
+	std::string path = std::string(CAR_DIR)+std::string("/character/") + std::string(REF_CHARACTER_TYPE) + std::string(".xml");
+	DPhy::Character* character = new DPhy::Character(path);
+	DPhy::ReferenceManager* referenceManager = new DPhy::ReferenceManager(character);
+	referenceManager->LoadMotionFromBVH("/motion/" + bvh);
+	referenceManager->InitOptimization(1, "");
+
+	int dof = character->GetSkeleton()->getNumDofs();
+	int phase_length = referenceManager->GetPhaseLength();
+	std::vector<double> knots;
+	for(int i = 0; i < phase_length; i += knot_interval)
+		knots.push_back(i);
+
+	std::vector<int> nc;
+	nc.push_back(3);
+	nc.push_back(5);
+
+	DPhy::MultilevelSpline* s = new DPhy::MultilevelSpline(num_levels, phase_length, nc);
+	std::mt19937 gen(0);
+	std::normal_distribution<double> noise(0.0, 0.1);
+	for(int i = 0; i < num_levels; i++) {
+		s->SetKnots(i, knots);
+		std::vector<Eigen::VectorXd> cps;
+		for(int j = 0; j < knots.size() + 3; j++) {
+			Eigen::VectorXd cp(dof);
+			for(int k = 0; k < dof; k++)
+				cp[k] = noise(gen);
+			cps.push_back(cp);
+		}
+		s->SetControlPoints(i, cps);
+	}
+	std::cout << "spline bench : " << bvh << ", " << num_levels << " levels, " << knots.size() << " knots, "
+			  << phase_length << " frames, dof " << dof << std::endl;
+
+	std::vector<DPhy::Spline*> splines;
+	for(int i = 0; i < num_levels; i++) {
+		DPhy::Spline* sp = new DPhy::Spline(knots, phase_length);
+		sp->SetNonCircular(nc);
+		sp->SetControlPoints(s->GetControlPoints(i));
+		splines.push_back(sp);
+	}
+	std::vector<Eigen::VectorXd> motion(phase_length);
+	DPhy::PrintBench(DPhy::RunBench("per frame GetPosition", iterations, [&]() {
+		for(int j = 0; j < phase_length; j++) {
+			motion[j].setZero(dof);
+			for(int i = 0; i < num_levels; i++)
+				motion[j] += splines[i]->GetPosition(j);
+		}
+	}));
+
+	Eigen::MatrixXd batch;
+	DPhy::PrintBench(DPhy::RunBench("batch ConvertSplineToMotion", iterations, [&]() {
+		s->ConvertSplineToMotion(batch);
+	}));
+
+	double max_diff = 0;
+	for(int j = 0; j < phase_length; j++)
+		max_diff = std::max(max_diff, (batch.row(j).transpose() - motion[j]).cwiseAbs().maxCoeff());
+	std::cout << "max difference " << max_diff << std::endl;
+	return 0;
+}
@@ -0,0 +1,50 @@
+#include "Controller.h"
+#include "ReferenceManager.h"
+#include "Bench.h"
+#include <cstdlib>
+// Measures observation extraction per slave: allocating GetState, WriteState into a preallocated buffer,
+// and the end effector state of the next reference pose which GetState evaluates every call.
+int main(int argc, char** argv)
+{
+	std::string bvh = "walk_phase.bvh";
+	int num_slaves = 4;
+	int iterations = 2000;
+	if(argc > 1) bvh = argv[1];
+	if(argc > 2) num_slaves = std::atoi(argv[2]);
+	if(argc > 3) iterations = std::atoi(argv[3]);
+
+	std::string path = std::string(CAR_DIR)+std::string("/character/") + std::string(REF_CHARACTER_TYPE) + std::string(".xml");
+	DPhy::Character* character = new DPhy::Character(path);
+	DPhy::ReferenceManager* referenceManager = new DPhy::ReferenceManager(character);
+	referenceManager->LoadMotionFromBVH("/motion/" + bvh);
+	referenceManager->InitOptimization(num_slaves, "");
+
+	std::vector<DPhy::Controller*> slaves;
+	for(int i = 0; i < num_slaves; i++) {
+		slaves.push_back(new DPhy::Controller(referenceManager, false, false, false, i));
+		slaves[i]->Reset(true);
+	}
+	int num_state = slaves[0]->GetNumState();
+	std::cout << "state bench : " << bvh << ", " << num_slaves << " slaves, state dim " << num_state << std::endl;
+
+	DPhy::PrintBench(DPhy::RunBench("GetState (per slave)", iterations, [&]() {
+		for(int i = 0; i < num_slaves; i++) {
+			Eigen::VectorXd s = slaves[i]->GetState();
+		}
+	}));
+
+	Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> states(num_slaves, num_state);
+	DPhy::PrintBench(DPhy::RunBench("WriteState (per slave)", iterations, [&]() {
+		for(int i = 0; i < num_slaves; i++)
+			slaves[i]->WriteState(states.row(i).data());
+	}));
+
+	DPhy::Motion* m = referenceManager->GetMotion(1, false);
+	Eigen::VectorXd pos = m->GetPosition();
+	Eigen::VectorXd vel = m->GetVelocity();
+	delete m;
+	DPhy::PrintBench(DPhy::RunBench("GetEndEffectorStatePosAndVel", iterations, [&]() {
+		Eigen::VectorXd ee = slaves[0]->GetEndEffectorStatePosAndVel(pos, vel);
+	}));
+	return 0;
+}
@@ -0,0 +1,226 @@
+#include "RolloutBuffer.h"
+#include <cmath>
+#include <algorithm>
+RolloutBuffer::
+RolloutBuffer(int num_slaves, int num_state, int num_action, int num_param)
+	:mNumState(num_state), mNumAction(num_action), mNumParam(num_param)
+{
+	mRunning.resize(num_slaves);
+}
+void
+RolloutBuffer::
+Record(int id, const float* state, const float* action, double reward, double value, double neglogp, double time)
+{
+	Episode& e = mRunning[id];
+	e.states.insert(e.states.end(), state, state + mNumState);
+	e.actions.insert(e.actions.end(), action, action + mNumAction);
+	e.rewards.push_back(reward);
+	e.values.push_back(value);
+	e.neglogprobs.push_back(neglogp);
+	e.times.push_back(time);
+}
+void
+RolloutBuffer::
+RecordAdaptive(int id, double param_reward, const double* param, int param_info)
+{
+	Episode& e = mRunning[id];
+	e.param_rewards.push_back(param_reward);
+	e.params.insert(e.params.end(), param, param + mNumParam);
+	e.param_infos.push_back(param_info);
+}
+void
+RolloutBuffer::
+EndEpisode(int id)
+{
+	Episode& e = mRunning[id];
+	if(e.rewards.size() != 0) {
+		mStates.insert(mStates.end(), e.states.begin(), e.states.end());
+		mActions.insert(mActions.end(), e.actions.begin(), e.actions.end());
+		mRewards.insert(mRewards.end(), e.rewards.begin(), e.rewards.end());
+		mValues.insert(mValues.end(), e.values.begin(), e.values.end());
+		mNegLogProbs.insert(mNegLogProbs.end(), e.neglogprobs.begin(), e.neglogprobs.end());
+		mTimes.insert(mTimes.end(), e.times.begin(), e.times.end());
+		mParamRewards.insert(mParamRewards.end(), e.param_rewards.begin(), e.param_rewards.end());
+		mParams.insert(mParams.end(), e.params.begin(), e.params.end());
+		mParamInfos.insert(mParamInfos.end(), e.param_infos.begin(), e.param_infos.end());
+		mEpisodeEnds.push_back(mRewards.size());
+	}
+	this->DiscardEpisode(id);
+}
+void
+RolloutBuffer::
+DiscardEpisode(int id)
+{
+	// clear keeps the capacity, episodes of the next iteration reuse it
+	Episode& e = mRunning[id];
+	e.states.clear();
+	e.actions.clear();
+	e.rewards.clear();
+	e.values.clear();
+	e.neglogprobs.clear();
+	e.times.clear();
+	e.param_rewards.clear();
+	e.params.clear();
+	e.param_infos.clear();
+}
+void
+RolloutBuffer::
+Clear()
+{
+	for(int id = 0; id < mRunning.size(); id++)
+		this->DiscardEpisode(id);
+	mStates.clear();
+	mActions.clear();
+	mRewards.clear();
+	mValues.clear();
+	mNegLogProbs.clear();
+	mTimes.clear();
+	mParamRewards.clear();
+	mParams.clear();
+	mParamInfos.clear();
+	mEpisodeEnds.clear();
+}
+void
+RolloutBuffer::
+ComputeTDandGAE(double gamma, double lambda, double phase_length, std::vector<float>& td, std::vector<float>& gae)
+{
+	int n = mRewards.size();
+	td.resize(n);
+	gae.resize(n);
+	double log_gamma = std::log(gamma);
+	int begin = 0;
+	for(int k = 0; k < mEpisodeEnds.size(); k++) {
+		int end = mEpisodeEnds[k];
+		double ad_t = 0;
+		for(int i = end - 1; i >= begin; i--) {
+			double timestep;
+			if(i == end - 1)
+				timestep = 0;
+			else if(mTimes[i] > mTimes[i+1])
+				timestep = phase_length - mTimes[i];
+			else
+				timestep = mTimes[i+1] - mTimes[i];
+
+			// integral of gamma^x over [0, timestep]
+			double gamma_t = std::pow(gamma, timestep);
+			double t = timestep == 0 ? 0 : (gamma_t - 1) / log_gamma;
+			double next_value = i == end - 1 ? 0 : mValues[i+1];
+			double delta = t * mRewards[i] + next_value * gamma_t - mValues[i];
+			ad_t = delta + std::pow(lambda, timestep) * gamma_t * ad_t;
+			gae[i] = ad_t;
+			td[i] = mValues[i] + ad_t;
+		}
+		begin = end;
+	}
+}
+// moves n samples of stride values from sample src to sample dst <= src
+template<typename T>
+static void
+MoveSamples(std::vector<T>& v, int src, int dst, int n, int stride)
+{
+	if(v.size() != 0 && src != dst)
+		std::copy(v.begin() + src*stride, v.begin() + (src+n)*stride, v.begin() + dst*stride);
+}
+template<typename T>
+static void
+ResizeSamples(std::vector<T>& v, int n, int stride)
+{
+	if(v.size() != 0)
+		v.resize(n*stride);
+}
+void
+RolloutBuffer::
+TruncateEpisodes(double phase_length)
+{
+	int begin = 0;
+	int dst = 0;
+	for(int k = 0; k < mEpisodeEnds.size(); k++) {
+		int end = mEpisodeEnds[k];
+		int size = end - begin;
+		// an episode cut at the maximum length keeps its phases up to the last completed one
+		if(size == phase_length * 3 + 10 + 1 && mTimes[end-1] < phase_length - 1.8) {
+			for(int i = end - 2; i >= begin; i--) {
+				if(mTimes[i] > mTimes[i+1]) {
+					size = i - begin + 1;
+					break;
+				}
+			}
+		}
+		MoveSamples(mStates, begin, dst, size, mNumState);
+		MoveSamples(mActions, begin, dst, size, mNumAction);
+		MoveSamples(mRewards, begin, dst, size, 1);
+		MoveSamples(mValues, begin, dst, size, 1);
+		MoveSamples(mNegLogProbs, begin, dst, size, 1);
+		MoveSamples(mTimes, begin, dst, size, 1);
+		MoveSamples(mParamRewards, begin, dst, size, 1);
+		MoveSamples(mParams, begin, dst, size, mNumParam);
+		MoveSamples(mParamInfos, begin, dst, size, 1);
+		dst += size;
+		mEpisodeEnds[k] = dst;
+		begin = end;
+	}
+	ResizeSamples(mStates, dst, mNumState);
+	ResizeSamples(mActions, dst, mNumAction);
+	ResizeSamples(mRewards, dst, 1);
+	ResizeSamples(mValues, dst, 1);
+	ResizeSamples(mNegLogProbs, dst, 1);
+	ResizeSamples(mTimes, dst, 1);
+	ResizeSamples(mParamRewards, dst, 1);
+	ResizeSamples(mParams, dst, mNumParam);
+	ResizeSamples(mParamInfos, dst, 1);
+}
+void
+RolloutBuffer::
+ComputeTDandGAEAdaptive(double gamma, double lambda, double phase_length, std::vector<float>& td, std::vector<float>& gae,
+						std::vector<float>& target_params, std::vector<float>& target_values, std::vector<int>& target_infos)
+{
+	this->TruncateEpisodes(phase_length);
+	int n = mRewards.size();
+	td.resize(n);
+	gae.resize(n);
+	target_params.clear();
+	target_values.clear();
+	target_infos.clear();
+	double log_gamma = std::log(gamma);
+	int begin = 0;
+	for(int k = 0; k < mEpisodeEnds.size(); k++) {
+		int end = mEpisodeEnds[k];
+		double ad_t = 0;
+		double V = 0;
+		double sum_V = 0;
+		int count_V = 0;
+		for(int i = end - 1; i >= begin; i--) {
+			// unlike ComputeTDandGAE the step over a phase boundary also covers the start of the next phase
+			double timestep;
+			if(i == end - 1 || (i == end - 2 && mTimes[i+1] == 0))
+				timestep = 0;
+			else if(mTimes[i] > mTimes[i+1])
+				timestep = phase_length - mTimes[i] + mTimes[i+1];
+			else
+				timestep = mTimes[i+1] - mTimes[i];
+
+			double gamma_t = std::pow(gamma, timestep);
+			double t = timestep == 0 ? 0 : (gamma_t - 1) / log_gamma;
+			double next_value = i == end - 1 ? 0 : mValues[i+1];
+			double delta = t * mRewards[i] + next_value * gamma_t - mValues[i];
+			V = t * mRewards[i] + 2 * mParamRewards[i] + V * gamma_t;
+			if(mParamRewards[i] != 0)
+				delta += mParamRewards[i];
+			ad_t = delta + std::pow(lambda, timestep) * gamma_t * ad_t;
+			gae[i] = ad_t;
+			td[i] = mValues[i] + ad_t;
+
+			sum_V += V;
+			count_V += 1;
+			if(i != end - 1 && (i == begin || mTimes[i-1] > mTimes[i])) {
+				target_params.insert(target_params.end(), mParams.begin() + i*mNumParam, mParams.begin() + (i+1)*mNumParam);
+				target_values.push_back(sum_V / count_V);
+				target_infos.push_back(mParamInfos[i]);
+				count_V = 0;
+				sum_V = 0;
+				V = 0;
+			}
+		}
+		begin = end;
+	}
+}
@@ -0,0 +1,71 @@
+#ifndef __DEEP_PHYSICS_ROLLOUT_BUFFER_H__
+#define __DEEP_PHYSICS_ROLLOUT_BUFFER_H__
+#include <vector>
+/**
+*
+* @brief Transitions of all slaves for one policy update, stored contiguously.
+* @details Every slave appends to its running episode, finished episodes are moved to flat arrays in the order they
+* end, so a minibatch is a slice of each array. TD targets and advantages are computed per episode with the variable
+* time step GAE of ppo.computeTDandGAE: the step length is the phase advanced between two samples, rewards are
+* integrated over it and episodes end without bootstrap. Adaptive training also records the parameter reward, the
+* goal parameters and the goal sample of each step for ppo.computeTDandGAEAdaptive.
+*
+*/
+class RolloutBuffer
+{
+public:
+	RolloutBuffer(int num_slaves, int num_state, int num_action, int num_param=0);
+
+	void Record(int id, const float* state, const float* action, double reward, double value, double neglogp, double time);
+	// adaptive terms of the sample recorded last for slave id, param has num_param entries
+	void RecordAdaptive(int id, double param_reward, const double* param, int param_info);
+	// moves the running episode of slave id to the finished ones
+	void EndEpisode(int id);
+	// drops the running episode of slave id
+	void DiscardEpisode(int id);
+	void Clear();
+
+	// finished samples and episodes
+	int GetNumSamples() { return mRewards.size(); }
+	int GetNumEpisodes() { return mEpisodeEnds.size(); }
+	const std::vector<float>& GetStates() { return mStates; }
+	const std::vector<float>& GetActions() { return mActions; }
+	const std::vector<float>& GetNegLogProbs() { return mNegLogProbs; }
+
+	void ComputeTDandGAE(double gamma, double lambda, double phase_length, std::vector<float>& td, std::vector<float>& gae);
+	// drops the unfinished last phase of episodes cut at the maximum length first, so the samples shrink.
+	// targets are the mean discounted value of every phase, with the goal parameters and goal sample of its first step
+	void ComputeTDandGAEAdaptive(double gamma, double lambda, double phase_length, std::vector<float>& td, std::vector<float>& gae,
+								 std::vector<float>& target_params, std::vector<float>& target_values, std::vector<int>& target_infos);
+private:
+	void TruncateEpisodes(double phase_length);
+
+	struct Episode
+	{
+		std::vector<float> states;
+		std::vector<float> actions;
+		std::vector<float> rewards;
+		std::vector<float> values;
+		std::vector<float> neglogprobs;
+		std::vector<float> times;
+		std::vector<float> param_rewards;
+		std::vector<float> params;
+		std::vector<int> param_infos;
+	};
+	int mNumState;
+	int mNumAction;
+	int mNumParam;
+	std::vector<Episode> mRunning;
+
+	std::vector<float> mStates;
+	std::vector<float> mActions;
+	std::vector<float> mRewards;
+	std::vector<float> mValues;
+	std::vector<float> mNegLogProbs;
+	std::vector<float> mTimes;
+	std::vector<float> mParamRewards;
+	std::vector<float> mParams;
+	std::vector<int> mParamInfos;
+	std::vector<int> mEpisodeEnds;
+};
+#endif
@@ -0,0 +1,74 @@
+#ifndef __DEEP_PHYSICS_SHARD_MEMORY_H__
+#define __DEEP_PHYSICS_SHARD_MEMORY_H__
+#include <cstddef>
+#include <semaphore.h>
+
+/**
+*
+* @brief Shared memory block of one shard.
+* @details The parent pushes commands into a single-producer ring and posts mRequest, the worker answers each command
+* with mReply. Actions, states, rewards and terminal info of the shard's slaves follow the header in the same mapping,
+* so no data is copied through pipes. The block is a named POSIX shared memory object, the worker is a separate
+* executable that maps it by name.
+*
+*/
+enum ShardCommandType
+{
+	SHARD_STEPS,
+	SHARD_STEP,
+	SHARD_RESETS,
+	SHARD_RESET,
+	SHARD_SHUTDOWN
+};
+struct ShardCommand
+{
+	int type;
+	int id;
+	int RSI;
+};
+struct ShardTerminal
+{
+	int terminal;
+	int nan;
+	int start;
+	int reason;
+	double length;
+	double time;
+};
+#define SHARD_RING_SIZE 64
+struct ShardHeader
+{
+	sem_t mRequest;
+	sem_t mReply;
+	ShardCommand mRing[SHARD_RING_SIZE];
+	unsigned int mHead;
+	unsigned int mTail;
+	int mNumSlaves;
+	int mNumState;
+	int mNumAction;
+	int mNumParts;
+};
+// every array of the block starts on a cache line
+inline size_t ShardAlign(size_t size) { return (size + 63) & ~((size_t)63); }
+inline size_t ShardBlockSize(int n, int num_state, int num_action, int num_parts)
+{
+	return ShardAlign(sizeof(ShardHeader)) + ShardAlign(sizeof(double)*n*num_action) + ShardAlign(sizeof(double)*n*num_state) +
+		   ShardAlign(sizeof(double)*n*num_parts) + ShardAlign(sizeof(ShardTerminal)*n);
+}
+inline double* ShardActionBlock(ShardHeader* h)
+{
+	return (double*)((char*)h + ShardAlign(sizeof(ShardHeader)));
+}
+inline double* ShardStateBlock(ShardHeader* h)
+{
+	return (double*)((char*)ShardActionBlock(h) + ShardAlign(sizeof(double)*h->mNumSlaves*h->mNumAction));
+}
+inline double* ShardRewardBlock(ShardHeader* h)
+{
+	return (double*)((char*)ShardStateBlock(h) + ShardAlign(sizeof(double)*h->mNumSlaves*h->mNumState));
+}
+inline ShardTerminal* ShardTerminalBlock(ShardHeader* h)
+{
+	return (ShardTerminal*)((char*)ShardRewardBlock(h) + ShardAlign(sizeof(double)*h->mNumSlaves*h->mNumParts));
+}
+#endif
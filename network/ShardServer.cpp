@@ -0,0 +1,358 @@
+#include "ShardServer.h"
+#include "Functions.h"
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <csignal>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+ShardEnv::
+ShardEnv(int num_slaves, std::string ref, std::string training_path, bool adaptive, bool parametric, int num_shards)
+	:mRef(ref), mParametric(parametric), mNumSlaves(num_slaves), mNumRespawns(0), mTimeout(60), mReadyTimeout(600)
+{
+	// boost.python translates the exception into a python ValueError
+	if(adaptive)
+		throw std::invalid_argument("ShardEnv : adaptive mode shares one regression memory and is not supported, use simEnv.Env");
+	mNumShards = std::max(1, std::min(num_shards, num_slaves));
+
+	std::string path = std::string(CAR_DIR)+std::string("/character/") + std::string(REF_CHARACTER_TYPE) + std::string(".xml");
+	DPhy::Character* character = new DPhy::Character(path);
+	mReferenceManager = new DPhy::ReferenceManager(character);
+	mReferenceManager->LoadMotionFromBVH(ref);
+	mReferenceManager->InitOptimization(num_slaves, "");
+
+	// the layout of the shared blocks depends on the observation size, so probe it once in the parent
+	DPhy::Controller* probe = new DPhy::Controller(mReferenceManager, false, parametric, false, 0);
+	mNumState = probe->GetNumState();
+	mNumAction = probe->GetNumAction();
+	mNumParts = probe->GetRewardByParts().size();
+	mRewardLabels = probe->GetRewardLabels();
+	delete probe;
+
+	for(int i = 0; i <= mNumShards; i++)
+		mShardBegin.push_back((long)num_slaves * i / mNumShards);
+
+	// names are unique per process and instance, the workers open the blocks by name
+	static int instance = 0;
+	std::string prefix = "/car_shard_" + std::to_string(getpid()) + "_" + std::to_string(instance++) + "_";
+
+	mBlocks.resize(mNumShards);
+	mBlockSize.resize(mNumShards);
+	mBlockNames.resize(mNumShards);
+	mPids.resize(mNumShards);
+	mInFlight.resize(mNumShards);
+	for(int i = 0; i < mNumShards; i++) {
+		int n = mShardBegin[i+1] - mShardBegin[i];
+		mBlockSize[i] = ShardBlockSize(n, mNumState, mNumAction, mNumParts);
+		mBlockNames[i] = prefix + std::to_string(i);
+		int fd = shm_open(mBlockNames[i].c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+		if(fd < 0 || ftruncate(fd, mBlockSize[i]) != 0) {
+			std::cout << "ShardEnv : shm_open failed for shard " << i << " : " << std::strerror(errno) << std::endl;
+			std::exit(1);
+		}
+		mBlocks[i] = mmap(NULL, mBlockSize[i], PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		if(mBlocks[i] == MAP_FAILED) {
+			std::cout << "ShardEnv : mmap failed for shard " << i << " : " << std::strerror(errno) << std::endl;
+			std::exit(1);
+		}
+		std::memset(mBlocks[i], 0, mBlockSize[i]);
+		ShardHeader* header = GetHeader(i);
+		header->mNumSlaves = n;
+		header->mNumState = mNumState;
+		header->mNumAction = mNumAction;
+		header->mNumParts = mNumParts;
+	}
+	for(int i = 0; i < mNumShards; i++)
+		this->Spawn(i);
+	for(int i = 0; i < mNumShards; i++)
+		this->WaitReady(i);
+}
+ShardEnv::
+~ShardEnv()
+{
+	ShardCommand cmd = {SHARD_SHUTDOWN, 0, 0};
+	for(int i = 0; i < mNumShards; i++)
+		this->Post(i, cmd);
+	for(int i = 0; i < mNumShards; i++) {
+		// a shard that does not answer is killed and reaped by Wait
+		if(this->Wait(i, mTimeout)) {
+			int status;
+			waitpid(mPids[i], &status, 0);
+		}
+		sem_destroy(&GetHeader(i)->mRequest);
+		sem_destroy(&GetHeader(i)->mReply);
+		munmap(mBlocks[i], mBlockSize[i]);
+		shm_unlink(mBlockNames[i].c_str());
+	}
+}
+void
+ShardEnv::
+Spawn(int shard)
+{
+	ShardHeader* header = GetHeader(shard);
+	sem_init(&header->mRequest, 1, 0);
+	sem_init(&header->mReply, 1, 0);
+	header->mHead = 0;
+	header->mTail = 0;
+
+	// everything exec needs is built before fork, the child only calls exec
+	std::string worker = std::string(CAR_DIR) + std::string("/network/shard_worker");
+	std::string parametric = mParametric ? "1" : "0";
+	std::string parent = std::to_string(getpid());
+	std::vector<char*> argv;
+	argv.push_back(const_cast<char*>(worker.c_str()));
+	argv.push_back(const_cast<char*>(mBlockNames[shard].c_str()));
+	argv.push_back(const_cast<char*>(mRef.c_str()));
+	argv.push_back(const_cast<char*>(parametric.c_str()));
+	argv.push_back(const_cast<char*>(parent.c_str()));
+	argv.push_back(NULL);
+
+	pid_t pid = fork();
+	if(pid < 0) {
+		std::cout << "ShardEnv : fork failed : " << std::strerror(errno) << std::endl;
+		std::exit(1);
+	}
+	if(pid == 0) {
+		execv(argv[0], argv.data());
+		_exit(127);
+	}
+	mPids[shard] = pid;
+}
+void
+ShardEnv::
+WaitReady(int shard)
+{
+	// the worker posts one reply once its controllers are built
+	if(!this->Wait(shard, mReadyTimeout)) {
+		std::cout << "ShardEnv : shard " << shard << " died during initialization, is " << CAR_DIR << "/network/shard_worker built?" << std::endl;
+		std::exit(1);
+	}
+}
+void
+ShardEnv::
+Post(int shard, ShardCommand cmd)
+{
+	ShardHeader* header = GetHeader(shard);
+	mInFlight[shard] = cmd;
+	header->mRing[header->mHead % SHARD_RING_SIZE] = cmd;
+	header->mHead++;
+	sem_post(&header->mRequest);
+}
+bool
+ShardEnv::
+Wait(int shard, int timeout)
+{
+	ShardHeader* header = GetHeader(shard);
+	int elapsed = 0;
+	while(true) {
+		struct timespec ts;
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec += 1;
+		if(sem_timedwait(&header->mReply, &ts) == 0)
+			return true;
+		if(errno == EINTR)
+			continue;
+
+		int status;
+		if(waitpid(mPids[shard], &status, WNOHANG) == mPids[shard])
+			return false;
+
+		// a worker that is alive but does not answer (deadlock, endless solve, stopped) is killed
+		elapsed += 1;
+		if(elapsed >= timeout) {
+			std::cout << "ShardEnv : shard " << shard << " (pid " << mPids[shard] << ") did not answer in "
+					  << timeout << "s, killing it" << std::endl;
+			kill(mPids[shard], SIGKILL);
+			waitpid(mPids[shard], &status, 0);
+			return false;
+		}
+	}
+}
+void
+ShardEnv::
+HandleCrash(int shard)
+{
+	std::cout << "ShardEnv : shard " << shard << " (pid " << mPids[shard] << ") crashed, respawning" << std::endl;
+	mNumRespawns += 1;
+	this->Spawn(shard);
+	this->WaitReady(shard);
+
+	// the new controllers have valid fresh states. A reset that was in flight is replayed, every other slave lost the
+	// episode it was in and is reported as a nan termination so the caller drops it and resets the slave.
+	ShardCommand cmd = mInFlight[shard];
+	if(cmd.type == SHARD_RESETS || cmd.type == SHARD_RESET) {
+		this->Post(shard, cmd);
+		if(!this->Wait(shard, mTimeout)) {
+			std::cout << "ShardEnv : shard " << shard << " crashed again replaying a reset" << std::endl;
+			std::exit(1);
+		}
+	}
+	ShardTerminal* terminal = GetTerminalBlock(shard);
+	for(int i = 0; i < mShardBegin[shard+1] - mShardBegin[shard]; i++) {
+		if(cmd.type == SHARD_RESETS || (cmd.type == SHARD_RESET && i == cmd.id))
+			continue;
+		terminal[i].terminal = 1;
+		terminal[i].nan = 1;
+	}
+}
+void
+ShardEnv::
+Steps()
+{
+	ShardCommand cmd = {SHARD_STEPS, 0, 0};
+	for(int i = 0; i < mNumShards; i++)
+		this->Post(i, cmd);
+	for(int i = 0; i < mNumShards; i++) {
+		if(!this->Wait(i, mTimeout))
+			this->HandleCrash(i);
+	}
+}
+void
+ShardEnv::
+Resets(bool RSI)
+{
+	ShardCommand cmd = {SHARD_RESETS, 0, RSI};
+	for(int i = 0; i < mNumShards; i++)
+		this->Post(i, cmd);
+	for(int i = 0; i < mNumShards; i++) {
+		if(!this->Wait(i, mTimeout))
+			this->HandleCrash(i);
+	}
+}
+void
+ShardEnv::
+Step(int id)
+{
+	int shard = std::upper_bound(mShardBegin.begin(), mShardBegin.end(), id) - mShardBegin.begin() - 1;
+	ShardCommand cmd = {SHARD_STEP, id - mShardBegin[shard], 0};
+	this->Post(shard, cmd);
+	if(!this->Wait(shard, mTimeout))
+		this->HandleCrash(shard);
+}
+void
+ShardEnv::
+Reset(int id, bool RSI)
+{
+	int shard = std::upper_bound(mShardBegin.begin(), mShardBegin.end(), id) - mShardBegin.begin() - 1;
+	ShardCommand cmd = {SHARD_RESET, id - mShardBegin[shard], RSI};
+	this->Post(shard, cmd);
+	if(!this->Wait(shard, mTimeout))
+		this->HandleCrash(shard);
+}
+p::tuple
+ShardEnv::
+IsNanAtTerminal(int id)
+{
+	int shard = std::upper_bound(mShardBegin.begin(), mShardBegin.end(), id) - mShardBegin.begin() - 1;
+	ShardTerminal& t = GetTerminalBlock(shard)[id - mShardBegin[shard]];
+	return p::make_tuple((bool)t.terminal, (bool)t.nan, t.start, t.length, t.time, t.reason);
+}
+np::ndarray
+ShardEnv::
+GetState(int id)
+{
+	int shard = std::upper_bound(mShardBegin.begin(), mShardBegin.end(), id) - mShardBegin.begin() - 1;
+	double* state = GetStateBlock(shard) + (id - mShardBegin[shard]) * mNumState;
+	return DPhy::toNumPyArray(Eigen::VectorXd(Eigen::Map<Eigen::VectorXd>(state, mNumState)));
+}
+void
+ShardEnv::
+SetAction(np::ndarray np_array, int id)
+{
+	int shard = std::upper_bound(mShardBegin.begin(), mShardBegin.end(), id) - mShardBegin.begin() - 1;
+	double* action = GetActionBlock(shard) + (id - mShardBegin[shard]) * mNumAction;
+	Eigen::Map<Eigen::VectorXd>(action, mNumAction) = DPhy::toEigenVector(np_array, mNumAction);
+}
+double
+ShardEnv::
+GetReward(int id)
+{
+	int shard = std::upper_bound(mShardBegin.begin(), mShardBegin.end(), id) - mShardBegin.begin() - 1;
+	return GetRewardBlock(shard)[(id - mShardBegin[shard]) * mNumParts];
+}
+np::ndarray
+ShardEnv::
+GetRewardByParts(int id)
+{
+	int shard = std::upper_bound(mShardBegin.begin(), mShardBegin.end(), id) - mShardBegin.begin() - 1;
+	double* reward = GetRewardBlock(shard) + (id - mShardBegin[shard]) * mNumParts;
+	return DPhy::toNumPyArray(std::vector<double>(reward, reward + mNumParts));
+}
+np::ndarray
+ShardEnv::
+GetStates()
+{
+	Eigen::MatrixXd states(mNumSlaves, mNumState);
+	for(int i = 0; i < mNumShards; i++) {
+		int n = mShardBegin[i+1] - mShardBegin[i];
+		states.middleRows(mShardBegin[i], n) =
+			Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>(GetStateBlock(i), n, mNumState);
+	}
+	return DPhy::toNumPyArray(states);
+}
+void
+ShardEnv::
+SetActions(np::ndarray np_array)
+{
+	Eigen::MatrixXd action = DPhy::toEigenMatrix(np_array, mNumSlaves, mNumAction);
+	for(int i = 0; i < mNumShards; i++) {
+		int n = mShardBegin[i+1] - mShardBegin[i];
+		Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>(GetActionBlock(i), n, mNumAction) =
+			action.middleRows(mShardBegin[i], n);
+	}
+}
+p::list
+ShardEnv::
+GetRewardLabels()
+{
+	p::list l;
+	for(int i = 0; i < mRewardLabels.size(); i++) l.append(mRewardLabels[i]);
+	return l;
+}
+np::ndarray
+ShardEnv::
+GetRewards()
+{
+	std::vector<float> rewards(mNumSlaves);
+	for(int id = 0; id < mNumSlaves; ++id)
+		rewards[id] = this->GetReward(id);
+	return DPhy::toNumPyArray(rewards);
+}
+np::ndarray
+ShardEnv::
+GetRewardsByParts()
+{
+	Eigen::MatrixXd rewards(mNumSlaves, mNumParts);
+	for(int i = 0; i < mNumShards; i++) {
+		int n = mShardBegin[i+1] - mShardBegin[i];
+		rewards.middleRows(mShardBegin[i], n) =
+			Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>(GetRewardBlock(i), n, mNumParts);
+	}
+	return DPhy::toNumPyArray(rewards);
+}
+np::ndarray
+ShardEnv::
+GetParamGoal()
+{
+	return DPhy::toNumPyArray(mReferenceManager->GetParamGoal());
+}
+double
+ShardEnv::
+GetPhaseLength()
+{
+	return mReferenceManager->GetPhaseLength();
+}
+int
+ShardEnv::
+GetDOF()
+{
+	return mReferenceManager->GetDOF();
+}
@@ -0,0 +1,95 @@
+#ifndef __DEEP_PHYSICS_SHARD_SERVER_H__
+#define __DEEP_PHYSICS_SHARD_SERVER_H__
+#include "Controller.h"
+#include "ReferenceManager.h"
+#include "ShardMemory.h"
+#include <vector>
+#include <string>
+#include <sys/types.h>
+#include <boost/python.hpp>
+#include <boost/python/numpy.hpp>
+
+namespace p = boost::python;
+namespace np = boost::python::numpy;
+
+/**
+*
+* @brief Slaves split into shards that run in worker processes.
+* @details Every shard is served by a shard_worker process built next to simEnv, started with fork and exec so that
+* respawning a crashed worker never runs code in a copy of the multi-threaded trainer. When a shard is respawned the
+* reset it was running is replayed; its other slaves lost their episode, are reported as nan terminations and must be
+* Reset by the caller. Adaptive training is not supported, the constructor throws when asked for it.
+*
+*/
+class ShardEnv
+{
+public:
+	ShardEnv(int num_slaves, std::string ref, std::string training_path, bool adaptive, bool parametric, int num_shards);
+	~ShardEnv();
+
+	int GetNumState() { return mNumState; }
+	int GetNumAction() { return mNumAction; }
+
+	void Step(int id);
+	void Reset(int id, bool RSI);
+	p::tuple IsNanAtTerminal(int id);
+	np::ndarray GetState(int id);
+	void SetAction(np::ndarray np_array, int id);
+	double GetReward(int id);
+	np::ndarray GetRewardByParts(int id);
+
+	void Steps();
+	void Resets(bool RSI);
+	np::ndarray GetStates();
+	void SetActions(np::ndarray np_array);
+	p::list GetRewardLabels();
+	np::ndarray GetRewards();
+	np::ndarray GetRewardsByParts();
+	np::ndarray GetParamGoal();
+
+	double GetPhaseLength();
+	int GetDOF();
+	int GetNumShards() { return mNumShards; }
+	int GetNumRespawns() { return mNumRespawns; }
+	// seconds a shard may take to answer one command before it is killed and respawned
+	void SetTimeout(int seconds) { mTimeout = seconds; }
+
+private:
+	void Spawn(int shard);
+	void WaitReady(int shard);
+	void Post(int shard, ShardCommand cmd);
+	// false if the worker died, or did not answer within timeout seconds and was killed
+	bool Wait(int shard, int timeout);
+	void HandleCrash(int shard);
+
+	ShardHeader* GetHeader(int shard) { return (ShardHeader*)mBlocks[shard]; }
+	double* GetActionBlock(int shard) { return ShardActionBlock(GetHeader(shard)); }
+	double* GetStateBlock(int shard) { return ShardStateBlock(GetHeader(shard)); }
+	double* GetRewardBlock(int shard) { return ShardRewardBlock(GetHeader(shard)); }
+	ShardTerminal* GetTerminalBlock(int shard) { return ShardTerminalBlock(GetHeader(shard)); }
+
+	std::string mRef;
+	bool mParametric;
+
+	int mNumSlaves;
+	int mNumShards;
+	int mNumState;
+	int mNumAction;
+	int mNumParts;
+	int mNumRespawns;
+	int mTimeout;
+	// building the controllers of a shard takes longer than a command
+	int mReadyTimeout;
+
+	std::vector<int> mShardBegin;
+	std::vector<void*> mBlocks;
+	std::vector<size_t> mBlockSize;
+	std::vector<std::string> mBlockNames;
+	std::vector<pid_t> mPids;
+	// last command posted to each shard, every command is waited for before the next one
+	std::vector<ShardCommand> mInFlight;
+
+	DPhy::ReferenceManager* mReferenceManager;
+	std::vector<std::string> mRewardLabels;
+};
+#endif
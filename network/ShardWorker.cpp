@@ -0,0 +1,131 @@
+#include "ShardMemory.h"
+#include "SlaveScheduler.h"
+#include "Controller.h"
+#include "ReferenceManager.h"
+#include <omp.h>
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/prctl.h>
+
+static void
+WriteSlave(DPhy::Controller* c, double* state, double* reward, ShardTerminal* terminal, int num_state, int num_parts)
+{
+	c->WriteState(state);
+	std::vector<double> r = c->GetRewardByParts();
+	for(int j = 0; j < num_parts && j < r.size(); j++)
+		reward[j] = r[j];
+
+	terminal->terminal = c->IsTerminalState();
+	terminal->nan = c->IsNanAtTerminal();
+	terminal->start = c->GetStartFrame();
+	terminal->reason = c->GetTerminationReason();
+	terminal->length = c->GetCurrentLength();
+	terminal->time = c->GetTimeElapsed();
+}
+// Worker of one shard, started by ShardEnv with fork and exec so it never inherits the threads and locks of the
+// trainer. It owns its own reference manager and controllers and never touches python.
+// usage : shard_worker shm_name ref parametric parent_pid
+int
+main(int argc, char** argv)
+{
+	if(argc < 5) {
+		std::cout << "usage : shard_worker shm_name ref parametric parent_pid" << std::endl;
+		return 1;
+	}
+	prctl(PR_SET_PDEATHSIG, SIGKILL);
+	// the parent may have died before the death signal was set
+	if(getppid() != (pid_t)atoi(argv[4]))
+		return 1;
+
+	int fd = shm_open(argv[1], O_RDWR, 0);
+	if(fd < 0) {
+		std::cout << "shard_worker : shm_open " << argv[1] << " failed : " << std::strerror(errno) << std::endl;
+		return 1;
+	}
+	struct stat st;
+	fstat(fd, &st);
+	void* block = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(block == MAP_FAILED) {
+		std::cout << "shard_worker : mmap failed : " << std::strerror(errno) << std::endl;
+		return 1;
+	}
+
+	ShardHeader* header = (ShardHeader*)block;
+	double* action = ShardActionBlock(header);
+	double* state = ShardStateBlock(header);
+	double* reward = ShardRewardBlock(header);
+	ShardTerminal* terminal = ShardTerminalBlock(header);
+	std::string ref = argv[2];
+	bool parametric = atoi(argv[3]);
+
+	int n = header->mNumSlaves;
+	int ns = header->mNumState;
+	int na = header->mNumAction;
+	int num_parts = header->mNumParts;
+
+	std::string path = std::string(CAR_DIR)+std::string("/character/") + std::string(REF_CHARACTER_TYPE) + std::string(".xml");
+	dart::math::seedRand();
+	omp_set_num_threads(n);
+
+	DPhy::Character* character = new DPhy::Character(path);
+	DPhy::ReferenceManager* referenceManager = new DPhy::ReferenceManager(character);
+	referenceManager->LoadMotionFromBVH(ref);
+	referenceManager->InitOptimization(n, "");
+
+	std::vector<DPhy::Controller*> slaves;
+	for(int i = 0; i < n; i++) {
+		slaves.push_back(new DPhy::Controller(referenceManager, false, parametric, false, i));
+		WriteSlave(slaves[i], state + i*ns, reward + i*num_parts, terminal + i, ns, num_parts);
+	}
+	SlaveScheduler scheduler(n);
+	sem_post(&header->mReply);
+
+	while(true) {
+		if(sem_wait(&header->mRequest) != 0)
+			continue;
+		ShardCommand cmd = header->mRing[header->mTail % SHARD_RING_SIZE];
+		header->mTail++;
+
+		if(cmd.type == SHARD_STEPS) {
+			std::vector<int> active;
+			for(int i = 0; i < n; i++) {
+				if(slaves[i]->IsTerminalState())
+					continue;
+				slaves[i]->SetAction(Eigen::Map<Eigen::VectorXd>(action + i*na, na));
+				active.push_back(i);
+			}
+			scheduler.Run(active, [&](int i) {
+				slaves[i]->Step();
+				WriteSlave(slaves[i], state + i*ns, reward + i*num_parts, terminal + i, ns, num_parts);
+			});
+		} else if(cmd.type == SHARD_STEP) {
+			if(!slaves[cmd.id]->IsTerminalState()) {
+				slaves[cmd.id]->SetAction(Eigen::Map<Eigen::VectorXd>(action + cmd.id*na, na));
+				slaves[cmd.id]->Step();
+				WriteSlave(slaves[cmd.id], state + cmd.id*ns, reward + cmd.id*num_parts, terminal + cmd.id, ns, num_parts);
+			}
+		} else if(cmd.type == SHARD_RESETS) {
+			for(int i = 0; i < n; i++) {
+				slaves[i]->Reset(cmd.RSI);
+				WriteSlave(slaves[i], state + i*ns, reward + i*num_parts, terminal + i, ns, num_parts);
+			}
+		} else if(cmd.type == SHARD_RESET) {
+			slaves[cmd.id]->Reset(cmd.RSI);
+			WriteSlave(slaves[cmd.id], state + cmd.id*ns, reward + cmd.id*num_parts, terminal + cmd.id, ns, num_parts);
+		} else if(cmd.type == SHARD_SHUTDOWN) {
+			sem_post(&header->mReply);
+			break;
+		}
+		sem_post(&header->mReply);
+	}
+	// skip the destructors of the controllers, the parent only waits for the exit
+	_exit(0);
+}
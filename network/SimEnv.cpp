@@ -1,17 +1,21 @@
 #include "SimEnv.h"
+#include "ShardServer.h"
 #include <omp.h>
 #include "dart/math/math.hpp"
 #include "Functions.h"
 #include <iostream>
+#include <algorithm>
 SimEnv::
 SimEnv(int num_slaves, std::string ref, std::string training_path, bool adaptive, bool parametric)
-	:mNumSlaves(num_slaves)
+	:mNumSlaves(num_slaves), mAdaptive(adaptive), mParametric(parametric)
 {
 	std::string path = std::string(CAR_DIR)+std::string("/character/") + std::string(REF_CHARACTER_TYPE) + std::string(".xml");
 	mPath = training_path;
 
 	dart::math::seedRand();
-	omp_set_num_threads(num_slaves);
+	// OMP_NUM_THREADS or the number of cores, so slaves outnumber the threads of the scheduler and can be stolen
+	int num_threads = std::max(1, std::min(omp_get_max_threads(), num_slaves));
+	omp_set_num_threads(num_threads);
 
 	DPhy::Character* character = new DPhy::Character(path);
 	mReferenceManager = new DPhy::ReferenceManager(character);
@@ -56,6 +60,21 @@ SimEnv(int num_slaves, std::string ref, std::string training_path, bool adaptive
 	mNumState = mSlaves[0]->GetNumState();
 	mNumAction = mSlaves[0]->GetNumAction();
 	mExUpdate = 0;
+
+	mScheduler = new SlaveScheduler(num_threads);
+	mSubSteps = 1;
+	mAutoReset = false;
+	mRewardParts.resize(num_slaves);
+	mPendingTerminal.assign(num_slaves, false);
+	mTerminalInfo.resize(num_slaves);
+	for(int i = 0; i < num_slaves; i++)
+		mRewardParts[i] = mSlaves[i]->GetRewardByParts();
+	mRollout = nullptr;
+	mRolloutPending = false;
+	mRolloutParamInfo = -1;
+	mNormalizer = nullptr;
+	mNormalizerUpdate.assign(num_slaves, true);
+	mStepPhase.assign(num_slaves, 0);
 }
 
 //For general properties
@@ -80,18 +99,54 @@ Step(int id)
 	if(mSlaves[id]->IsTerminalState()){
 		return;
 	}
+	this->StepSlave(id);
+}
+void
+SimEnv::
+StepSlave(int id)
+{
 	mSlaves[id]->Step();
+	mRewardParts[id] = mSlaves[id]->GetRewardByParts();
+	for(int i = 1; i < mSubSteps && !mSlaves[id]->IsTerminalState(); i++) {
+		mSlaves[id]->Step();
+		std::vector<double> r = mSlaves[id]->GetRewardByParts();
+		for(int j = 0; j < r.size(); j++)
+			mRewardParts[id][j] += r[j];
+	}
+	mStepPhase[id] = mSlaves[id]->GetCurrentFrameOnPhase();
+	if(mAutoReset && mSlaves[id]->IsTerminalState()) {
+		bool n = mSlaves[id]->IsNanAtTerminal();
+		int start = mSlaves[id]->GetStartFrame();
+		double e = mSlaves[id]->GetCurrentLength();
+		double tt = mSlaves[id]->GetTimeElapsed();
+		int term = mSlaves[id]->GetTerminationReason();
+		// RSI draws from the shared dart random generator
+#pragma omp critical(auto_reset)
+		{
+			mTerminalInfo[id] = std::make_tuple(n, start, e, tt, term);
+			mPendingTerminal[id] = true;
+			mSlaves[id]->Reset(true);
+		}
+	}
 }
 void 
 SimEnv::
 Reset(int id,bool RSI)
 {
 	mSlaves[id]->Reset(RSI);
+	mRewardParts[id] = mSlaves[id]->GetRewardByParts();
+	mPendingTerminal[id] = false;
+	if(mRollout != nullptr)
+		mRollout->DiscardEpisode(id);
 }
 p::tuple 
 SimEnv::
 IsNanAtTerminal(int id)
 {
+	if(mPendingTerminal[id]) {
+		std::tuple<bool, int, double, double, int>& info = mTerminalInfo[id];
+		return p::make_tuple(true, std::get<0>(info), std::get<1>(info), std::get<2>(info), std::get<3>(info), std::get<4>(info));
+	}
 	bool t = mSlaves[id]->IsTerminalState();
 	bool n = mSlaves[id]->IsNanAtTerminal();
 	int start = mSlaves[id]->GetStartFrame();
@@ -125,32 +180,248 @@ double
 SimEnv::
 GetReward(int id)
 {
-	return mSlaves[id]->GetReward();
+	return mRewardParts[id][0];
 }
 np::ndarray
 SimEnv::
 GetRewardByParts(int id)
 {
-	std::vector<double> ret;
-	if(dynamic_cast<DPhy::Controller*>(mSlaves[id])!=nullptr){
-		ret = dynamic_cast<DPhy::Controller*>(mSlaves[id])->GetRewardByParts();
-	}
-	return DPhy::toNumPyArray(ret);
+	return DPhy::toNumPyArray(mRewardParts[id]);
 }
 void
 SimEnv::
 Steps()
 {
-	if( mNumSlaves == 1){
-		this->Step(0);
+	std::vector<int> active;
+	for (int id = 0; id < mNumSlaves; ++id)
+	{
+		mPendingTerminal[id] = false;
+		if(!mSlaves[id]->IsTerminalState())
+			active.push_back(id);
 	}
-	else{
-#pragma omp parallel for
-		for (int id = 0; id < mNumSlaves; ++id)
-		{
-			this->Step(id);
+	mScheduler->Run(active, [this](int id) { this->StepSlave(id); });
+	if(mRollout != nullptr && mRolloutPending)
+		this->RecordRollout(active);
+}
+void
+SimEnv::
+RecordRollout(const std::vector<int>& stepped)
+{
+	// same samples as the python loop of ppo.train: nan steps are dropped and end the episode
+	for(int i = 0; i < stepped.size(); i++) {
+		int id = stepped[i];
+		if(!mRolloutRecording[id])
+			continue;
+		bool terminal = mPendingTerminal[id] || mSlaves[id]->IsTerminalState();
+		bool nan = mPendingTerminal[id] ? std::get<0>(mTerminalInfo[id]) : mSlaves[id]->IsNanAtTerminal();
+		if(!nan) {
+			mRollout->Record(id, &mRolloutStates[id*mNumState], &mRolloutActions[id*mNumAction], mRewardParts[id][0],
+							 mRolloutValues[id], mRolloutNegLogProbs[id], mStepPhase[id]);
+			// the goal parameters are the ones of the state after the step, as read from the raw states by monitor.step
+			if(mAdaptive)
+				mRollout->RecordAdaptive(id, mRewardParts[id][1], mSlaves[id]->GetGoalParameters().data(), mRolloutParamInfo);
+		}
+		if(terminal)
+			mRollout->EndEpisode(id);
+	}
+	mRolloutPending = false;
+}
+void
+SimEnv::
+EnableRollout(bool on)
+{
+	delete mRollout;
+	mRollout = nullptr;
+	if(on)
+		mRollout = new RolloutBuffer(mNumSlaves, mNumState, mNumAction, mAdaptive && mParametric ? mSlaves[0]->GetGoalParameters().rows() : 0);
+	mRolloutPending = false;
+}
+void
+SimEnv::
+SetPolicyOutputs(np::ndarray states, np::ndarray values, np::ndarray neglogprobs, np::ndarray recording)
+{
+	if(mRollout == nullptr)
+		return;
+	const float* s = reinterpret_cast<float*>(states.get_data());
+	mRolloutStates.assign(s, s + mNumSlaves * mNumState);
+	Eigen::VectorXd v = DPhy::toEigenVector(values, mNumSlaves);
+	Eigen::VectorXd n = DPhy::toEigenVector(neglogprobs, mNumSlaves);
+	Eigen::VectorXd r = DPhy::toEigenVector(recording, mNumSlaves);
+	mRolloutValues.resize(mNumSlaves);
+	mRolloutNegLogProbs.resize(mNumSlaves);
+	mRolloutRecording.resize(mNumSlaves);
+	for(int id = 0; id < mNumSlaves; id++) {
+		mRolloutValues[id] = v[id];
+		mRolloutNegLogProbs[id] = n[id];
+		mRolloutRecording[id] = r[id] != 0;
+	}
+	mRolloutPending = true;
+}
+static np::ndarray
+ToNumPyMatrix(const std::vector<float>& val, int rows, int cols)
+{
+	np::ndarray array = np::empty(p::make_tuple(rows, cols), np::dtype::get_builtin<float>());
+	std::copy(val.begin(), val.begin() + rows * cols, reinterpret_cast<float*>(array.get_data()));
+	return array;
+}
+p::list
+SimEnv::
+GetRolloutBatch(double gamma, double lambda)
+{
+	p::list l;
+	if(mRollout == nullptr)
+		return l;
+	std::vector<float> td, gae;
+	mRollout->ComputeTDandGAE(gamma, lambda, mReferenceManager->GetPhaseLength(), td, gae);
+	int n = mRollout->GetNumSamples();
+	l.append(ToNumPyMatrix(mRollout->GetStates(), n, mNumState));
+	l.append(ToNumPyMatrix(mRollout->GetActions(), n, mNumAction));
+	l.append(DPhy::toNumPyArray(td));
+	l.append(DPhy::toNumPyArray(mRollout->GetNegLogProbs()));
+	l.append(DPhy::toNumPyArray(gae));
+	return l;
+}
+void
+SimEnv::
+SetRolloutParamInfo(int param_info)
+{
+	mRolloutParamInfo = param_info;
+}
+p::list
+SimEnv::
+GetRolloutBatchAdaptive(double gamma, double lambda)
+{
+	p::list l;
+	if(mRollout == nullptr)
+		return l;
+	std::vector<float> td, gae, target_params, target_values;
+	std::vector<int> target_infos;
+	mRollout->ComputeTDandGAEAdaptive(gamma, lambda, mReferenceManager->GetPhaseLength(), td, gae, target_params, target_values, target_infos);
+	int n = mRollout->GetNumSamples();
+	int num_param = mParametric ? mSlaves[0]->GetGoalParameters().rows() : 0;
+	l.append(ToNumPyMatrix(mRollout->GetStates(), n, mNumState));
+	l.append(ToNumPyMatrix(target_params, target_values.size(), num_param));
+	l.append(ToNumPyMatrix(mRollout->GetActions(), n, mNumAction));
+	l.append(DPhy::toNumPyArray(td));
+	l.append(DPhy::toNumPyArray(target_values));
+	l.append(DPhy::toNumPyArray(mRollout->GetNegLogProbs()));
+	l.append(DPhy::toNumPyArray(gae));
+	// goal samples are indices of the sampler, kept as python ints
+	p::list infos;
+	for(int i = 0; i < target_infos.size(); i++)
+		infos.append(target_infos[i]);
+	l.append(infos);
+	return l;
+}
+int
+SimEnv::
+GetRolloutSize()
+{
+	if(mRollout == nullptr)
+		return 0;
+	return mRollout->GetNumSamples();
+}
+void
+SimEnv::
+ClearRollout()
+{
+	if(mRollout != nullptr)
+		mRollout->Clear();
+}
+void
+SimEnv::
+SetSchedulerOptions(int sub_steps, bool auto_reset)
+{
+	mSubSteps = std::max(sub_steps, 1);
+	mAutoReset = auto_reset;
+}
+void
+SimEnv::
+SetNumThreads(int num_threads)
+{
+	delete mScheduler;
+	mScheduler = new SlaveScheduler(num_threads);
+	omp_set_num_threads(mScheduler->GetNumThreads());
+}
+void
+SimEnv::
+SetFactorizedSPD(bool on, int refactor_interval)
+{
+	for(int id = 0; id < mNumSlaves; ++id)
+		mSlaves[id]->SetFactorizedSPD(on, refactor_interval);
+}
+np::ndarray
+SimEnv::
+GetThreadUtilization()
+{
+	return DPhy::toNumPyArray(mScheduler->GetUtilization());
+}
+p::list
+SimEnv::
+GetProfile(bool reset)
+{
+	int n = DPhy::NUM_PROFILE_STAGES;
+	p::list labels;
+	for(int j = 0; j < n; j++)
+		labels.append(std::string(DPhy::StageProfile::GetName((DPhy::ProfileStage)j)));
+
+	Eigen::MatrixXd totals(mNumSlaves, n), counts(mNumSlaves, n), histograms(mNumSlaves * n, PROFILE_NUM_BINS);
+	for(int id = 0; id < mNumSlaves; id++) {
+		DPhy::StageProfile& profile = mSlaves[id]->GetProfile();
+		for(int j = 0; j < n; j++) {
+			DPhy::ProfileStage stage = (DPhy::ProfileStage)j;
+			totals(id, j) = profile.GetTotal(stage);
+			counts(id, j) = profile.GetCount(stage);
+			for(int k = 0; k < PROFILE_NUM_BINS; k++)
+				histograms(id * n + j, k) = profile.GetHistogram(stage, k);
+		}
+		if(reset)
+			profile.Clear();
+	}
+
+	p::list l;
+	l.append(labels);
+	l.append(DPhy::toNumPyArray(totals));
+	l.append(DPhy::toNumPyArray(counts));
+	l.append(DPhy::toNumPyArray(histograms));
+	return l;
+}
+void
+SimEnv::
+OpenRecordFiles(std::string prefix)
+{
+	for(int id = 0; id < mNumSlaves; id++)
+		mSlaves[id]->OpenRecordFile(prefix + std::to_string(id) + ".rec");
+}
+void
+SimEnv::
+CloseRecordFiles()
+{
+	for(int id = 0; id < mNumSlaves; id++)
+		mSlaves[id]->CloseRecordFile();
+}
+void
+SimEnv::
+ExportRecordsToBVH(p::list records)
+{
+	std::vector<std::string> paths;
+	std::vector<std::vector<Eigen::VectorXd>> pos;
+	for(int i = 0; i < p::len(records); i++) {
+		std::string record = p::extract<std::string>(records[i]);
+		DPhy::RolloutReader reader;
+		if(!reader.Load(record))
+			continue;
+		std::string prefix = record.substr(0, record.rfind(".rec"));
+		std::vector<std::pair<int, int>> episodes = reader.GetEpisodes();
+		for(int j = 0; j < episodes.size(); j++) {
+			std::vector<Eigen::VectorXd> episode;
+			for(int k = episodes[j].first; k < episodes[j].second; k++)
+				episode.push_back(reader.GetPositions(k));
+			paths.push_back(prefix + "_" + std::to_string(j) + ".bvh");
+			pos.push_back(episode);
 		}
 	}
+	mReferenceManager->GetBVHWriter()->WriteBatch(paths, pos);
 }
 void
 SimEnv::
@@ -161,23 +432,151 @@ Resets(bool RSI)
 		this->Reset(id,RSI);
 	}
 }
+void
+SimEnv::
+Fork(int src, int dst)
+{
+	if(src == dst)
+		return;
+	DPhy::ControllerState state;
+	mSlaves[src]->SaveState(state);
+	mSlaves[dst]->RestoreState(state);
+	if(mRollout != nullptr)
+		mRollout->DiscardEpisode(dst);
+	mRewardParts[dst] = mRewardParts[src];
+	mPendingTerminal[dst] = mPendingTerminal[src];
+	mTerminalInfo[dst] = mTerminalInfo[src];
+}
+int
+SimEnv::
+SaveSnapshot(int id)
+{
+	mSnapshots.push_back(DPhy::ControllerState());
+	mSlaves[id]->SaveState(mSnapshots.back());
+	return mSnapshots.size() - 1;
+}
+void
+SimEnv::
+RestoreSnapshot(int snapshot, int id)
+{
+	if(snapshot < 0 || snapshot >= mSnapshots.size()) {
+		std::cout << "restore snapshot : no snapshot " << snapshot << std::endl;
+		return;
+	}
+	mSlaves[id]->RestoreState(mSnapshots[snapshot]);
+	if(mRollout != nullptr)
+		mRollout->DiscardEpisode(id);
+	mRewardParts[id] = mSlaves[id]->GetRewardByParts();
+	mPendingTerminal[id] = false;
+}
+void
+SimEnv::
+ClearSnapshots()
+{
+	mSnapshots.clear();
+}
 np::ndarray
 SimEnv::
 GetStates()
 {
-	Eigen::MatrixXd states(mNumSlaves,mNumState);
-
-	for (int id = 0; id < mNumSlaves; ++id)
-	{
-		states.row(id) = mSlaves[id]->GetState().transpose();
+	Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>& states = mRawStates;
+	states.resize(mNumSlaves, mNumState);
+	if(mNormalizer == nullptr) {
+		for (int id = 0; id < mNumSlaves; ++id)
+		{
+			mSlaves[id]->WriteState(states.row(id).data());
+		}
+		return DPhy::toNumPyArray(Eigen::MatrixXd(states));
 	}
-	return DPhy::toNumPyArray(states);
+
+	// writing states costs the same for every slave, and the utilization of the scheduler only describes Steps
+#pragma omp parallel for
+	for(int id = 0; id < mNumSlaves; ++id)
+		mSlaves[id]->WriteState(states.row(id).data());
+	mNormalizer->Update(states.data(), mNumSlaves, mNormalizerUpdate);
+
+	np::ndarray array = np::empty(p::make_tuple(mNumSlaves, mNumState), np::dtype::get_builtin<float>());
+	float* dest = reinterpret_cast<float*>(array.get_data());
+#pragma omp parallel for
+	for(int id = 0; id < mNumSlaves; ++id)
+		mNormalizer->Apply(states.row(id).data(), dest + id * mNumState);
+	return array;
+}
+void
+SimEnv::
+SetStateNormalization(bool on)
+{
+	delete mNormalizer;
+	mNormalizer = nullptr;
+	if(on)
+		mNormalizer = new StateNormalizer(mNumState);
+}
+void
+SimEnv::
+SetNormalizerUpdate(np::ndarray mask)
+{
+	Eigen::VectorXd m = DPhy::toEigenVector(mask, mNumSlaves);
+	for(int id = 0; id < mNumSlaves; ++id)
+		mNormalizerUpdate[id] = m[id] != 0;
+}
+np::ndarray
+SimEnv::
+GetRawStates()
+{
+	return DPhy::toNumPyArray(Eigen::MatrixXd(mRawStates));
+}
+np::ndarray
+SimEnv::
+GetNormalizedState(int id)
+{
+	Eigen::VectorXd state = mSlaves[id]->GetState();
+	if(mNormalizer == nullptr)
+		return DPhy::toNumPyArray(state);
+	mNormalizer->Update(state.data(), 1, std::vector<bool>(1, true));
+	np::ndarray array = np::empty(p::make_tuple(mNumState), np::dtype::get_builtin<float>());
+	mNormalizer->Apply(state.data(), reinterpret_cast<float*>(array.get_data()));
+	return array;
+}
+static np::ndarray
+ToNumPyArray64(const Eigen::VectorXd& vec)
+{
+	np::ndarray array = np::empty(p::make_tuple((int)vec.rows()), np::dtype::get_builtin<double>());
+	Eigen::Map<Eigen::VectorXd>(reinterpret_cast<double*>(array.get_data()), vec.rows()) = vec;
+	return array;
+}
+p::list
+SimEnv::
+GetStateNormalizer()
+{
+	p::list l;
+	if(mNormalizer == nullptr)
+		return l;
+	l.append(ToNumPyArray64(mNormalizer->GetMean()));
+	l.append(ToNumPyArray64(mNormalizer->GetVar()));
+	l.append(mNormalizer->GetCount());
+	return l;
+}
+void
+SimEnv::
+SetStateNormalizer(np::ndarray mean, np::ndarray var, double count)
+{
+	if(mNormalizer == nullptr)
+		return;
+	// float64 arrays, as stored in the rms files
+	int n = mean.shape(0);
+	Eigen::VectorXd m = Eigen::Map<Eigen::VectorXd>(reinterpret_cast<double*>(mean.get_data()), n);
+	Eigen::VectorXd v = Eigen::Map<Eigen::VectorXd>(reinterpret_cast<double*>(var.get_data()), var.shape(0));
+	mNormalizer->Set(m, v, count);
 }
 void
 SimEnv::
 SetActions(np::ndarray np_array)
 {
 	Eigen::MatrixXd action = DPhy::toEigenMatrix(np_array,mNumSlaves,mNumAction);
+	if(mRollout != nullptr) {
+		const float* a = reinterpret_cast<float*>(np_array.get_data());
+		mRolloutActions.assign(a, a + mNumSlaves * mNumAction);
+	}
 
 	for (int id = 0; id < mNumSlaves; ++id)
 	{
@@ -200,20 +599,13 @@ np::ndarray
 SimEnv::
 GetRewardsByParts()
 {
-	std::vector<std::vector<double>> rewards(mNumSlaves);
-	for (int id = 0; id < mNumSlaves; ++id)
-	{
-		if(dynamic_cast<DPhy::Controller*>(mSlaves[id])!=nullptr){
-			rewards[id] = dynamic_cast<DPhy::Controller*>(mSlaves[id])->GetRewardByParts();
-		}
-	}
-
-	return DPhy::toNumPyArray(rewards);
+	return DPhy::toNumPyArray(mRewardParts);
 }
 void 
 SimEnv::
 TrainRegressionNetwork()
 {
+	mReferenceManager->WaitTrajectories();
 	std::tuple<std::vector<Eigen::VectorXd>, 
 			   std::vector<Eigen::VectorXd>, 
 			   std::vector<double>> x_y_z = mRegressionMemory->GetTrainingData();
@@ -252,6 +644,7 @@ GetDOF()
 void 
 SimEnv::
 UpdateReference() {
+	mReferenceManager->WaitTrajectories();
 	Eigen::VectorXd tp = mReferenceManager->GetParamGoal();		
 		
 	std::vector<Eigen::VectorXd> cps = mRegressionMemory->GetCPSFromNearestParams(tp);
@@ -264,6 +657,7 @@ UpdateReference() {
 void 
 SimEnv::
 SetGoalParameters(np::ndarray np_array, bool mem_only) {
+	mReferenceManager->WaitTrajectories();
 
 	int dim = mRegressionMemory->GetDim();
 	Eigen::VectorXd tp = DPhy::toEigenVector(np_array, dim);
@@ -318,6 +712,7 @@ UniformSampleWithConstraints(double d0, double d1) {
 void
 SimEnv::
 SaveParamSpace(int n) {
+	mReferenceManager->WaitTrajectories();
 	if(n != -1) {
 		mRegressionMemory->SaveParamSpace(mPath + "param_space" + std::to_string(n));
 	} else {
@@ -326,7 +721,14 @@ SaveParamSpace(int n) {
 }
 void
 SimEnv::
+SetCPSEncoding(int encoding) {
+	mReferenceManager->WaitTrajectories();
+	mRegressionMemory->SetCPSEncoding((DPhy::CPSEncoding)encoding);
+}
+void
+SimEnv::
 SaveParamSpaceLog(int n) {
+	mReferenceManager->WaitTrajectories();
 	mRegressionMemory->SaveLog(mPath + "log");
 
 }
@@ -416,9 +818,34 @@ BOOST_PYTHON_MODULE(simEnv)
 		.def("GetRewardByParts",&SimEnv::GetRewardByParts)
 		.def("Steps",&SimEnv::Steps)
 		.def("Resets",&SimEnv::Resets)
+		.def("Fork",&SimEnv::Fork)
+		.def("SaveSnapshot",&SimEnv::SaveSnapshot)
+		.def("RestoreSnapshot",&SimEnv::RestoreSnapshot)
+		.def("ClearSnapshots",&SimEnv::ClearSnapshots)
+		.def("SetSchedulerOptions",&SimEnv::SetSchedulerOptions)
+		.def("GetThreadUtilization",&SimEnv::GetThreadUtilization)
+		.def("SetNumThreads",&SimEnv::SetNumThreads)
+		.def("SetFactorizedSPD",&SimEnv::SetFactorizedSPD)
+		.def("GetProfile",&SimEnv::GetProfile)
+		.def("OpenRecordFiles",&SimEnv::OpenRecordFiles)
+		.def("CloseRecordFiles",&SimEnv::CloseRecordFiles)
+		.def("ExportRecordsToBVH",&SimEnv::ExportRecordsToBVH)
 		.def("IsNanAtTerminal",&SimEnv::IsNanAtTerminal)
 		.def("GetStates",&SimEnv::GetStates)
 		.def("SetActions",&SimEnv::SetActions)
+		.def("EnableRollout",&SimEnv::EnableRollout)
+		.def("SetPolicyOutputs",&SimEnv::SetPolicyOutputs)
+		.def("GetRolloutBatch",&SimEnv::GetRolloutBatch)
+		.def("SetRolloutParamInfo",&SimEnv::SetRolloutParamInfo)
+		.def("GetRolloutBatchAdaptive",&SimEnv::GetRolloutBatchAdaptive)
+		.def("GetRolloutSize",&SimEnv::GetRolloutSize)
+		.def("ClearRollout",&SimEnv::ClearRollout)
+		.def("SetStateNormalization",&SimEnv::SetStateNormalization)
+		.def("SetNormalizerUpdate",&SimEnv::SetNormalizerUpdate)
+		.def("GetRawStates",&SimEnv::GetRawStates)
+		.def("GetNormalizedState",&SimEnv::GetNormalizedState)
+		.def("GetStateNormalizer",&SimEnv::GetStateNormalizer)
+		.def("SetStateNormalizer",&SimEnv::SetStateNormalizer)
 		.def("GetRewards",&SimEnv::GetRewards)
 		.def("GetRewardsByParts",&SimEnv::GetRewardsByParts)
 		.def("GetParamGoal",&SimEnv::GetParamGoal)
@@ -433,9 +860,34 @@ BOOST_PYTHON_MODULE(simEnv)
 		.def("SetGoalParameters",&SimEnv::SetGoalParameters)
 		.def("SaveParamSpace",&SimEnv::SaveParamSpace)
 		.def("SaveParamSpaceLog",&SimEnv::SaveParamSpaceLog)
+		.def("SetCPSEncoding",&SimEnv::SetCPSEncoding)
 		.def("UpdateReference",&SimEnv::UpdateReference)
 		.def("GetVisitedRatio",&SimEnv::GetVisitedRatio)
 		.def("GetFitnessMean",&SimEnv::GetFitnessMean)
 		.def("GetDensity",&SimEnv::GetDensity);
 
+	class_<ShardEnv, boost::noncopyable>("ShardEnv",init<int, std::string, std::string, bool, bool, int>())
+		.def("GetNumState",&ShardEnv::GetNumState)
+		.def("GetNumAction",&ShardEnv::GetNumAction)
+		.def("Step",&ShardEnv::Step)
+		.def("Reset",&ShardEnv::Reset)
+		.def("GetState",&ShardEnv::GetState)
+		.def("SetAction",&ShardEnv::SetAction)
+		.def("GetRewardLabels",&ShardEnv::GetRewardLabels)
+		.def("GetReward",&ShardEnv::GetReward)
+		.def("GetRewardByParts",&ShardEnv::GetRewardByParts)
+		.def("Steps",&ShardEnv::Steps)
+		.def("Resets",&ShardEnv::Resets)
+		.def("IsNanAtTerminal",&ShardEnv::IsNanAtTerminal)
+		.def("GetStates",&ShardEnv::GetStates)
+		.def("SetActions",&ShardEnv::SetActions)
+		.def("GetRewards",&ShardEnv::GetRewards)
+		.def("GetRewardsByParts",&ShardEnv::GetRewardsByParts)
+		.def("GetParamGoal",&ShardEnv::GetParamGoal)
+		.def("GetPhaseLength",&ShardEnv::GetPhaseLength)
+		.def("GetDOF",&ShardEnv::GetDOF)
+		.def("GetNumShards",&ShardEnv::GetNumShards)
+		.def("GetNumRespawns",&ShardEnv::GetNumRespawns)
+		.def("SetTimeout",&ShardEnv::SetTimeout);
+
 }
\ No newline at end of file
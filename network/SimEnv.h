@@ -4,6 +4,9 @@
 // #include "SimpleController.h"
 #include "ReferenceManager.h"
 #include "RegressionMemory.h"
+#include "SlaveScheduler.h"
+#include "RolloutBuffer.h"
+#include "StateNormalizer.h"
 #include <vector>
 #include <string>
 #include <boost/python.hpp>
@@ -37,9 +40,51 @@ public:
 
 	void Steps();
 	void Resets(bool RSI);
+	// continues slave dst from the current state of slave src
+	void Fork(int src, int dst);
+	// snapshots of a slave kept by index, to branch rollouts from the same state later
+	int SaveSnapshot(int id);
+	void RestoreSnapshot(int snapshot, int id);
+	void ClearSnapshots();
+	void SetSchedulerOptions(int sub_steps, bool auto_reset);
+	// busy over wall time of each thread in Steps
+	np::ndarray GetThreadUtilization();
+	// number of threads stepping the slaves, defaults to OMP_NUM_THREADS or the number of cores, at most the number of slaves
+	void SetNumThreads(int num_threads);
+	void SetFactorizedSPD(bool on, int refactor_interval);
+	// [stage names, total seconds (slaves x stages), call counts (slaves x stages),
+	//  histograms (slaves * stages x bins)], optionally clearing the profiles
+	p::list GetProfile(bool reset);
+	// slave i streams its steps to prefix + i + ".rec"
+	void OpenRecordFiles(std::string prefix);
+	void CloseRecordFiles();
+	// writes every episode of each record file to <record>_<episode>.bvh
+	void ExportRecordsToBVH(p::list records);
 
+	// normalized by the running moments of the states when state normalization is on
 	np::ndarray GetStates();
 	void SetActions(np::ndarray np_array);
+	void SetStateNormalization(bool on);
+	// slaves whose states are added to the moments by GetStates, all by default
+	void SetNormalizerUpdate(np::ndarray mask);
+	// states of the last GetStates before normalization
+	np::ndarray GetRawStates();
+	np::ndarray GetNormalizedState(int id);
+	// [mean, var, count] as float64, the contents of the rms files of utils.RunningMeanStd
+	p::list GetStateNormalizer();
+	void SetStateNormalizer(np::ndarray mean, np::ndarray var, double count);
+	// rollout buffer filled by Steps, for policy updates without per-step python lists
+	void EnableRollout(bool on);
+	// network inputs and outputs of the next Steps, recording[id] == 0 skips slave id
+	void SetPolicyOutputs(np::ndarray states, np::ndarray values, np::ndarray neglogprobs, np::ndarray recording);
+	// [states, actions, TD, neglogprobs, GAE] of the finished episodes
+	p::list GetRolloutBatch(double gamma, double lambda);
+	// goal sample of the next steps, recorded with the samples of adaptive training
+	void SetRolloutParamInfo(int param_info);
+	// [states, target params, actions, TD, target values, neglogprobs, GAE, target infos] as ppo.computeTDandGAEAdaptive
+	p::list GetRolloutBatchAdaptive(double gamma, double lambda);
+	int GetRolloutSize();
+	void ClearRollout();
 	p::list GetRewardLabels();
 	np::ndarray GetRewards();
 	np::ndarray GetRewardsByParts();
@@ -57,6 +102,8 @@ public:
 	void UpdateReference();
 	void SaveParamSpace(int n);
 	void SaveParamSpaceLog(int n);
+	// 0: double, 1: float, 2: 16-bit fixed point
+	void SetCPSEncoding(int encoding);
 
 	double GetVisitedRatio();
 	double GetDensity(np::ndarray np_array);
@@ -67,6 +114,9 @@ public:
 
 	double GetFitnessMean();
 private:
+	void StepSlave(int id);
+	void RecordRollout(const std::vector<int>& stepped);
+
 	std::vector<DPhy::Controller*> mSlaves;
 	DPhy::ReferenceManager* mReferenceManager;
 	DPhy::RegressionMemory* mRegressionMemory;
@@ -75,9 +125,35 @@ private:
 	int mNumSlaves;
 	int mNumState;
 	int mNumAction;
+	bool mAdaptive;
+	bool mParametric;
 	
 	p::object mRegression;
 
+	SlaveScheduler* mScheduler;
+	int mSubSteps;
+	bool mAutoReset;
+	// reward accumulated over sub-steps, and terminal info of slaves reset in place
+	std::vector<std::vector<double>> mRewardParts;
+	std::vector<bool> mPendingTerminal;
+	std::vector<std::tuple<bool, int, double, double, int>> mTerminalInfo;
+	std::vector<DPhy::ControllerState> mSnapshots;
+
+	StateNormalizer* mNormalizer;
+	std::vector<bool> mNormalizerUpdate;
+	Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> mRawStates;
+
+	RolloutBuffer* mRollout;
+	bool mRolloutPending;
+	std::vector<float> mRolloutStates;
+	std::vector<float> mRolloutActions;
+	std::vector<float> mRolloutValues;
+	std::vector<float> mRolloutNegLogProbs;
+	std::vector<bool> mRolloutRecording;
+	int mRolloutParamInfo;
+	// phase after the last step of each slave, before an auto reset
+	std::vector<double> mStepPhase;
+
 	std::string mPath;
 };
 
@@ -0,0 +1,94 @@
+#include "SlaveScheduler.h"
+#include <omp.h>
+#include <algorithm>
+SlaveScheduler::
+SlaveScheduler(int num_threads)
+	:mNumThreads(std::max(num_threads, 1)), mRanges(std::max(num_threads, 1))
+{
+	this->ClearStats();
+}
+void
+SlaveScheduler::
+ClearStats()
+{
+	mBusyTime.assign(mNumThreads, 0);
+	mWallTime.assign(mNumThreads, 0);
+	mNumStolen.assign(mNumThreads, 0);
+}
+std::vector<double>
+SlaveScheduler::
+GetUtilization()
+{
+	std::vector<double> utilization(mNumThreads, 0);
+	for(int i = 0; i < mNumThreads; i++) {
+		if(mWallTime[i] > 0)
+			utilization[i] = mBusyTime[i] / mWallTime[i];
+	}
+	return utilization;
+}
+bool
+SlaveScheduler::
+Pop(int tid, int& idx)
+{
+	if(mRanges[tid].next.load(std::memory_order_relaxed) >= mRanges[tid].end)
+		return false;
+	idx = mRanges[tid].next.fetch_add(1);
+	return idx < mRanges[tid].end;
+}
+bool
+SlaveScheduler::
+Steal(int tid, int& idx)
+{
+	for(int i = 1; i < mNumThreads; i++) {
+		int victim = (tid + i) % mNumThreads;
+		if(this->Pop(victim, idx)) {
+			mNumStolen[tid] += 1;
+			return true;
+		}
+	}
+	return false;
+}
+void
+SlaveScheduler::
+Run(const std::vector<int>& jobs, const std::function<void(int)>& fn)
+{
+	int n = jobs.size();
+	if(n == 0)
+		return;
+
+	int num_threads = std::min(mNumThreads, n);
+	for(int i = 0; i < mNumThreads; i++) {
+		int begin = (i < num_threads) ? (long)n * i / num_threads : n;
+		int end = (i < num_threads) ? (long)n * (i + 1) / num_threads : n;
+		mRanges[i].next.store(begin);
+		mRanges[i].end = end;
+	}
+
+	if(num_threads == 1) {
+		double t0 = omp_get_wtime();
+		for(int i = 0; i < n; i++)
+			fn(jobs[i]);
+		double elapsed = omp_get_wtime() - t0;
+		mBusyTime[0] += elapsed;
+		for(int i = 0; i < mNumThreads; i++)
+			mWallTime[i] += elapsed;
+		return;
+	}
+
+	double t_start = omp_get_wtime();
+#pragma omp parallel num_threads(num_threads)
+	{
+		int tid = omp_get_thread_num();
+		double busy = 0;
+		int idx;
+		while(this->Pop(tid, idx) || this->Steal(tid, idx)) {
+			double t0 = omp_get_wtime();
+			fn(jobs[idx]);
+			busy += omp_get_wtime() - t0;
+		}
+		mBusyTime[tid] += busy;
+	}
+	double wall = omp_get_wtime() - t_start;
+	for(int i = 0; i < mNumThreads; i++)
+		mWallTime[i] += wall;
+}
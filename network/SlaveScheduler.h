@@ -0,0 +1,42 @@
+#ifndef __DEEP_PHYSICS_SLAVE_SCHEDULER_H__
+#define __DEEP_PHYSICS_SLAVE_SCHEDULER_H__
+#include <vector>
+#include <atomic>
+#include <functional>
+/**
+*
+* @brief Work-stealing dispatcher for slave steps.
+* @details Jobs are split into one contiguous range per thread. A thread consumes its own range first and then steals
+* from the ranges of other threads, so a few long episodes do not leave the remaining threads idle.
+* Busy time and wall time are accumulated per thread to report utilization.
+*
+*/
+class SlaveScheduler
+{
+public:
+	SlaveScheduler(int num_threads);
+
+	void Run(const std::vector<int>& jobs, const std::function<void(int)>& fn);
+
+	int GetNumThreads() { return mNumThreads; }
+	std::vector<double> GetUtilization();
+	std::vector<int> GetNumStolen() { return mNumStolen; }
+	void ClearStats();
+private:
+	struct Range
+	{
+		std::atomic<int> next;
+		int end;
+		char pad[56];
+	};
+	bool Pop(int tid, int& idx);
+	bool Steal(int tid, int& idx);
+
+	int mNumThreads;
+	std::vector<Range> mRanges;
+
+	std::vector<double> mBusyTime;
+	std::vector<double> mWallTime;
+	std::vector<int> mNumStolen;
+};
+#endif
@@ -0,0 +1,75 @@
+#include "StateNormalizer.h"
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+StateNormalizer::
+StateNormalizer(int num_state)
+	:mNumState(num_state), mCount(1e-4), mEpsilon(1e-8), mClip(10)
+{
+	mMean = Eigen::VectorXd::Zero(num_state);
+	mVar = Eigen::VectorXd::Ones(num_state);
+	mInvStd = (mVar.array() + mEpsilon).rsqrt();
+}
+void
+StateNormalizer::
+Update(const double* x, int rows, const std::vector<bool>& mask)
+{
+	std::vector<int> selected;
+	for(int i = 0; i < rows; i++) {
+		if(mask[i])
+			selected.push_back(i);
+	}
+	int n = selected.size();
+	if(n == 0)
+		return;
+
+	Eigen::VectorXd mean(mNumState), var(mNumState);
+	double total = mCount + n;
+#pragma omp parallel for
+	for(int d = 0; d < mNumState; d++) {
+		double batch_mean = 0;
+		for(int k = 0; k < n; k++)
+			batch_mean += x[selected[k]*mNumState + d];
+		batch_mean /= n;
+		double batch_var = 0;
+		for(int k = 0; k < n; k++) {
+			double e = x[selected[k]*mNumState + d] - batch_mean;
+			batch_var += e*e;
+		}
+		batch_var /= n;
+
+		double delta = batch_mean - mMean[d];
+		mean[d] = mMean[d] + delta * n / total;
+		var[d] = (mVar[d] * mCount + batch_var * n + delta * delta * mCount * n / total) / total;
+	}
+	if(mean.hasNaN() || var.hasNaN()) {
+		std::cout << "state normalizer : nan in states, update skipped" << std::endl;
+		return;
+	}
+	mMean = mean;
+	mVar = var;
+	mCount = total;
+	mInvStd = (mVar.array() + mEpsilon).rsqrt();
+}
+void
+StateNormalizer::
+Apply(const double* x, float* out)
+{
+	for(int d = 0; d < mNumState; d++) {
+		double v = (x[d] - mMean[d]) * mInvStd[d];
+		out[d] = std::max(-mClip, std::min(mClip, v));
+	}
+}
+void
+StateNormalizer::
+Set(const Eigen::VectorXd& mean, const Eigen::VectorXd& var, double count)
+{
+	if(mean.rows() != mNumState || var.rows() != mNumState) {
+		std::cout << "state normalizer : expected " << mNumState << " dimensions, got " << mean.rows() << std::endl;
+		return;
+	}
+	mMean = mean;
+	mVar = var;
+	mCount = count;
+	mInvStd = (mVar.array() + mEpsilon).rsqrt();
+}
@@ -0,0 +1,37 @@
+#ifndef __DEEP_PHYSICS_STATE_NORMALIZER_H__
+#define __DEEP_PHYSICS_STATE_NORMALIZER_H__
+#include <Eigen/Core>
+#include <vector>
+/**
+*
+* @brief Running mean and variance of the observations, and the clipped normalization of RunningMeanStd in utils.py.
+* @details Every update adds one batch of rows (one per slave). The batch moments are computed per dimension in
+* parallel and merged into the running moments with the pairwise update of Chan et al., the same arithmetic as
+* update_mean_var_count_from_moments, so moments saved by either side can be loaded by the other.
+*
+*/
+class StateNormalizer
+{
+public:
+	StateNormalizer(int num_state);
+
+	// adds the rows of x (rows x num_state, row major) whose mask is set
+	void Update(const double* x, int rows, const std::vector<bool>& mask);
+	// clip((x - mean) / sqrt(var + epsilon), -clip, clip)
+	void Apply(const double* x, float* out);
+
+	const Eigen::VectorXd& GetMean() { return mMean; }
+	const Eigen::VectorXd& GetVar() { return mVar; }
+	double GetCount() { return mCount; }
+	void Set(const Eigen::VectorXd& mean, const Eigen::VectorXd& var, double count);
+private:
+	int mNumState;
+	Eigen::VectorXd mMean;
+	Eigen::VectorXd mVar;
+	// 1 / sqrt(var + epsilon), refreshed on every update
+	Eigen::VectorXd mInvStd;
+	double mCount;
+	double mEpsilon;
+	double mClip;
+};
+#endif
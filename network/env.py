@@ -4,9 +4,13 @@ import simEnv
 import time
 from IPython import embed
 class Env(object):
-	def __init__(self, ref, directory, adaptive, parametric, num_slaves):
+	def __init__(self, ref, directory, adaptive, parametric, num_slaves, num_shards=1):
 		self.num_slaves = num_slaves
-		self.sim_env = simEnv.Env(num_slaves, "/motion/"+ref, directory, adaptive, parametric)
+		if num_shards > 1:
+			# slaves run in shard_worker processes that share their states and actions through shared memory
+			self.sim_env = simEnv.ShardEnv(num_slaves, "/motion/"+ref, directory, adaptive, parametric, num_shards)
+		else:
+			self.sim_env = simEnv.Env(num_slaves, "/motion/"+ref, directory, adaptive, parametric)
 
 		self.num_state = self.sim_env.GetNumState()
 		self.num_action = self.sim_env.GetNumAction()
@@ -6,7 +6,7 @@ import matplotlib
 import matplotlib.pyplot as plt
 import numpy as np
 import copy
-from utils import RunningMeanStd
+from utils import RunningMeanStd, NativeRunningMeanStd
 from IPython import embed
 import os
 def vector_to_str(vec):
@@ -19,15 +19,27 @@ def matrix_to_str(mat):
 	for m in mat:
 		s += '(' + vector_to_str(m) + ')'
 	return s
+def histogram_percentile(hist, q):
+	# upper edge in ms of the power of two microsecond bin holding the q-th quantile
+	total = hist.sum()
+	if total == 0:
+		return 0
+	idx = np.searchsorted(np.cumsum(hist), q * total)
+	return 2.0 ** idx / 1000
 class Monitor(object):
-	def __init__(self, ref, num_slaves, directory, adaptive, parametric, plot=True, verbose=True):
-		self.env = Env(ref, directory, adaptive, parametric, num_slaves)
+	def __init__(self, ref, num_slaves, directory, adaptive, parametric, plot=True, verbose=True, num_shards=1):
+		self.env = Env(ref, directory, adaptive, parametric, num_slaves, num_shards)
 		self.num_slaves = self.env.num_slaves
 		self.sim_env = self.env.sim_env
 		
 		self.num_state = self.env.num_state
 		self.num_action = self.env.num_action
-		self.RMS = RunningMeanStd(shape=(self.num_state))	
+		# simEnv.Env normalizes the states itself, the sharded env returns raw states
+		self.native_rms = hasattr(self.sim_env, 'SetStateNormalization')
+		if self.native_rms:
+			self.RMS = NativeRunningMeanStd(self.sim_env, self.num_state)
+		else:
+			self.RMS = RunningMeanStd(shape=(self.num_state))	
 		self.verbose = verbose
 		self.plot = plot
 		self.directory = directory
@@ -87,23 +99,30 @@ class Monitor(object):
 	
 	def reset(self, i, b=True):
 		self.env.reset(i, b)
-		state = np.array([self.sim_env.GetState(i)])
-		self.states[i] = self.RMS.apply(state)[0]
+		if self.native_rms:
+			self.states[i] = self.sim_env.GetNormalizedState(i)
+		else:
+			state = np.array([self.sim_env.GetState(i)])
+			self.states[i] = self.RMS.apply(state)[0]
 		self.terminated[i] = False
 		self.prevframes[i] = 0
 
 	def step(self, actions, record=True):
+		if self.native_rms:
+			self.sim_env.SetNormalizerUpdate(np.array([not t for t in self.terminated], dtype=np.float32))
 		self.states, rewards, dones, times, frames, terminal_reason, nan_count =  self.env.step(actions)
+		raw_states = self.sim_env.GetRawStates() if self.native_rms else self.states
 
 		if self.adaptive and self.parametric:
-			params = np.array(self.states)[:,-(self.dim_param+4):-4]
-			curframes = np.array(self.states)[:,-(self.dim_param+1+4)]
+			params = np.array(raw_states)[:,-(self.dim_param+4):-4]
+			curframes = np.array(raw_states)[:,-(self.dim_param+1+4)]
 		else:
 			params = np.zeros(self.num_slaves)
-			curframes = np.array(self.states)[:,-1]
+			curframes = np.array(raw_states)[:,-1]
 
-		states_updated = self.RMS.apply(self.states[~np.array(self.terminated)])
-		self.states[~np.array(self.terminated)] = states_updated
+		if not self.native_rms:
+			states_updated = self.RMS.apply(self.states[~np.array(self.terminated)])
+			self.states[~np.array(self.terminated)] = states_updated
 		if record:
 			self.num_nan_per_iteration += nan_count
 			for i in range(self.num_slaves):
@@ -360,6 +379,18 @@ class Monitor(object):
 			if self.num_transitions_per_iteration is not 0:
 				te_per_t = self.total_frames_elapsed / self.num_transitions_per_iteration;
 			print_list.append('frame elapsed per transition : {:.2f}'.format(te_per_t))
+			if hasattr(self.sim_env, 'GetProfile'):
+				labels, totals, counts, hist = self.sim_env.GetProfile(True)
+				hist = np.asarray(hist).reshape(len(totals), len(labels), -1).sum(axis=0)
+				totals = np.asarray(totals).sum(axis=0)
+				counts = np.asarray(counts).sum(axis=0)
+				print_list.append('step profile : total / mean / p50 / p99')
+				for i in range(len(labels)):
+					mean = 0
+					if counts[i] != 0:
+						mean = totals[i] / counts[i] * 1000
+					print_list.append('  {:<10} : {:.2f}s / {:.3f}ms / <{:.3f}ms / <{:.3f}ms'.format(labels[i], totals[i], mean,
+						histogram_percentile(hist[i], 0.5), histogram_percentile(hist[i], 0.99)))
 			if self.adaptive:
 				print_list.append('param goal: ' + ' '.join(['%f' % p for p in self.sim_env.GetParamGoal()]))			
 			if self.num_nan_per_iteration != 0:
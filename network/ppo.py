@@ -88,6 +88,11 @@ class PPO(object):
 		self.num_action = self.env.num_action
 		self.num_state = self.env.num_state
 
+		# rollouts are kept in the native buffer of simEnv.Env, TD, GAE and the adaptive value targets are computed there
+		self.native_rollout = hasattr(self.env.sim_env, 'EnableRollout')
+		if self.native_rollout:
+			self.env.sim_env.EnableRollout(True)
+
 		self.target_x_batch = []
 		self.target_y_batch = []
 
@@ -209,7 +214,11 @@ class PPO(object):
 
 
 	def update(self, tuples):
-		state_batch, action_batch, TD_batch, neglogp_batch, GAE_batch = self.computeTDandGAE(tuples)
+		if self.native_rollout:
+			state_batch, action_batch, TD_batch, neglogp_batch, GAE_batch = self.env.sim_env.GetRolloutBatch(self.gamma, self.lambd)
+			self.env.sim_env.ClearRollout()
+		else:
+			state_batch, action_batch, TD_batch, neglogp_batch, GAE_batch = self.computeTDandGAE(tuples)
 		if len(state_batch) < self.batch_size:
 			return
 		GAE_batch = (GAE_batch - GAE_batch.mean())/(GAE_batch.std() + 1e-5)
@@ -274,9 +283,16 @@ class PPO(object):
 		return np.array(state_batch), np.array(action_batch), np.array(TD_batch), np.array(neglogp_batch), np.array(GAE_batch)
 
 	def updateAdaptive(self, tuples):
-		state_batch, state_target_batch, action_batch, \
-		TD_batch, TD_target_batch, \
-		neglogp_batch, GAE_batch = self.computeTDandGAEAdaptive(tuples)
+		if self.native_rollout:
+			state_batch, state_target_batch, action_batch, \
+			TD_batch, TD_target_batch, \
+			neglogp_batch, GAE_batch, self.info_target = self.env.sim_env.GetRolloutBatchAdaptive(self.gamma, self.lambd)
+			self.v_target = list(TD_target_batch)
+			self.env.sim_env.ClearRollout()
+		else:
+			state_batch, state_target_batch, action_batch, \
+			TD_batch, TD_target_batch, \
+			neglogp_batch, GAE_batch = self.computeTDandGAEAdaptive(tuples)
 
 
 		if len(state_batch) < self.batch_size:
@@ -542,6 +558,8 @@ class PPO(object):
 				param_info = self.env.updateGoal(self.critic_target)
 			else:
 				param_info = -1
+			if self.native_rollout:
+				self.env.sim_env.SetRolloutParamInfo(int(param_info))
 
 			while True:
 				# set action
@@ -549,14 +567,20 @@ class PPO(object):
 
 				values = self.critic.getValue(states)
 
+				if self.native_rollout:
+					recording = np.array([not self.env.getTerminated(j) for j in range(self.num_slaves)], dtype=np.float32)
+					self.env.sim_env.SetPolicyOutputs(np.asarray(states, dtype=np.float32), np.asarray(values, dtype=np.float32), 
+						np.asarray(neglogprobs, dtype=np.float32), recording)
 				rewards, dones, times, params = self.env.step(actions)
 				for j in range(self.num_slaves):
 					if not self.env.getTerminated(j):
 						if not self.adaptive and rewards[j] is not None:
-							epi_info[j].append([states[j], actions[j], rewards[j], values[j], neglogprobs[j], times[j]])
+							if not self.native_rollout:
+								epi_info[j].append([states[j], actions[j], rewards[j], values[j], neglogprobs[j], times[j]])
 							local_step += 1
 						if self.adaptive and rewards[j][0] is not None:
-							epi_info[j].append([states[j], actions[j], rewards[j], values[j], neglogprobs[j], times[j], params[j], param_info])
+							if not self.native_rollout:
+								epi_info[j].append([states[j], actions[j], rewards[j], values[j], neglogprobs[j], times[j], params[j], param_info])
 							local_step += 1
 						if dones[j]:
 							if len(epi_info[j]) != 0:
@@ -670,6 +694,7 @@ if __name__=="__main__":
 	parser.add_argument("--test_name", type=str, default="")
 	parser.add_argument("--pretrain", type=str, default="")
 	parser.add_argument("--nslaves", type=int, default=4)
+	parser.add_argument("--nshards", type=int, default=1)
 	parser.add_argument("--adaptive", dest='adaptive', action='store_true')
 	parser.add_argument("--parametric", dest='parametric', action='store_true')
 	parser.add_argument("--save", type=bool, default=True)
@@ -679,6 +704,8 @@ if __name__=="__main__":
 	parser.set_defaults(parametric=False)
 
 	args = parser.parse_args()
+	if args.adaptive and args.nshards > 1:
+		parser.error("--adaptive is not supported with --nshards > 1, the shards do not share the regression memory")
 
 	directory = None
 	if args.save:
@@ -690,9 +717,9 @@ if __name__=="__main__":
 			os.mkdir(directory)
 
 	if args.pretrain != "":
-		env = Monitor(ref=args.ref, num_slaves=args.nslaves, directory=directory, plot=args.plot, adaptive=args.adaptive, parametric=args.parametric)
+		env = Monitor(ref=args.ref, num_slaves=args.nslaves, directory=directory, plot=args.plot, adaptive=args.adaptive, parametric=args.parametric, num_shards=args.nshards)
 	else:
-		env = Monitor(ref=args.ref, num_slaves=args.nslaves, directory=directory, plot=args.plot, adaptive=args.adaptive, parametric=args.parametric)
+		env = Monitor(ref=args.ref, num_slaves=args.nslaves, directory=directory, plot=args.plot, adaptive=args.adaptive, parametric=args.parametric, num_shards=args.nshards)
 
 	ppo = PPO()
 
@@ -0,0 +1,67 @@
+import numpy as np
+import simEnv
+import argparse
+import time
+import sys
+
+# steps simEnv.Env with fixed random (or recorded) actions for every combination of slave and thread counts and
+# writes one csv row per combination, same columns as bench/scaling_bench
+COLUMNS = ["num_slaves", "num_threads", "steps", "samples_per_sec", "p50_ms", "p99_ms", "efficiency"]
+
+def run(env, actions, num_slaves, num_steps):
+	env.Resets(True)
+	latency = []
+	t0 = time.time()
+	for k in range(num_steps):
+		t_step = time.time()
+		env.SetActions(actions[k % len(actions)][:num_slaves])
+		env.Steps()
+		latency.append((time.time() - t_step) * 1000)
+	rate = num_slaves * num_steps / (time.time() - t0)
+	return rate, np.percentile(latency, 50), np.percentile(latency, 99)
+
+def scaling(ref, slave_counts, thread_counts, num_steps, action_path, out):
+	out.write(",".join(COLUMNS) + "\n")
+	for num_slaves in slave_counts:
+		env = simEnv.Env(num_slaves, "/motion/"+ref, "", False, False)
+		# terminal slaves are reset inside Steps so every step costs the same for all slaves
+		env.SetSchedulerOptions(1, True)
+		num_action = env.GetNumAction()
+		if action_path != "":
+			# recorded actions of shape (steps, num_action) or (steps, slaves, num_action)
+			recorded = np.load(action_path)
+			if recorded.ndim == 2:
+				recorded = np.repeat(recorded[:, np.newaxis, :], num_slaves, axis=1)
+			actions = [np.array(a[np.arange(num_slaves) % a.shape[0]], dtype=np.float32) for a in recorded]
+		else:
+			rng = np.random.RandomState(0)
+			actions = [rng.normal(size=(num_slaves, num_action)).astype(np.float32)]
+
+		base_rate = None
+		for num_threads in thread_counts:
+			env.SetNumThreads(num_threads)
+			rate, p50, p99 = run(env, actions, num_slaves, num_steps)
+			if base_rate is None:
+				base_rate = rate / num_threads
+			out.write("{},{},{},{:.2f},{:.4f},{:.4f},{:.4f}\n".format(num_slaves, num_threads, num_steps, rate, p50, p99, rate / (num_threads * base_rate)))
+			out.flush()
+			print("{} slaves, {} threads : {:.2f} samples/sec".format(num_slaves, num_threads, rate), file=sys.stderr)
+
+if __name__=="__main__":
+	parser = argparse.ArgumentParser()
+	parser.add_argument("--ref", type=str, default="walk_phase.bvh")
+	parser.add_argument("--slaves", type=str, default="1,2,4,8,16")
+	parser.add_argument("--threads", type=str, default="1,2,4,8,16")
+	parser.add_argument("--steps", type=int, default=200)
+	parser.add_argument("--actions", type=str, default="")
+	parser.add_argument("--csv", type=str, default="")
+
+	args = parser.parse_args()
+	slave_counts = [int(n) for n in args.slaves.split(",")]
+	thread_counts = [int(n) for n in args.threads.split(",")]
+
+	if args.csv != "":
+		with open(args.csv, "w") as out:
+			scaling(args.ref, slave_counts, thread_counts, args.steps, args.actions, out)
+	else:
+		scaling(args.ref, slave_counts, thread_counts, args.steps, args.actions, sys.stdout)
@@ -80,6 +80,41 @@ class RunningMeanStd(object):
             print("new RMS state size: ", self.mean.shape)
 
 
+class NativeRunningMeanStd(object):
+    # moments kept by simEnv.Env, which returns normalized states from GetStates. same rms files as RunningMeanStd
+    def __init__(self, sim_env, shape):
+        self.sim_env = sim_env
+        self.shape = shape
+        self.sim_env.SetStateNormalization(True)
+
+    def get(self):
+        mean, var, count = self.sim_env.GetStateNormalizer()
+        return np.array(mean, 'float64'), np.array(var, 'float64'), count
+
+    def set(self, mean, var, count):
+        if mean.shape[0] < self.shape:
+            l = self.shape - mean.shape[0]
+            mean = np.concatenate((mean, np.zeros(l, 'float64')), axis=0)
+            var = np.concatenate((var, np.ones(l, 'float64')), axis=0)
+            print("new RMS state size: ", mean.shape)
+        self.sim_env.SetStateNormalizer(np.ascontiguousarray(mean, 'float64'), np.ascontiguousarray(var, 'float64'), float(count))
+
+    def save(self, path):
+        mean, var, count = self.get()
+        data = {'mean':mean, 'var':var, 'count':count}
+        with open(path, 'wb') as f:
+            pickle.dump(data, f)
+
+    def load(self, path):
+        with open(path, 'rb') as f:
+                data = pickle.load(f)
+                self.set(np.asarray(data['mean'], 'float64'), np.asarray(data['var'], 'float64'), data['count'])
+
+    def setNumStates(self, size):
+        # load pads the moments to the state size already
+        self.shape = size
+
+
 def update_mean_var_count_from_moments(mean, var, count, batch_mean, batch_var, batch_count):
     delta = batch_mean - mean
     tot_count = count + batch_count
@@ -2,6 +2,7 @@
 #include "RecordWindow.h"
 #include "dart/external/lodepng/lodepng.h"
 #include "Functions.h"
+#include "RolloutRecorder.h"
 #include <algorithm>
 #include <fstream>
 #include <boost/filesystem.hpp>
@@ -30,51 +31,71 @@ RecordWindow(std::vector<std::string> motion)
 
 		int dof = this->mRef[i]->GetSkeleton()->getPositions().rows();
 		std::string record_path = motion[i];
-		std::ifstream is(record_path);
-		
-		char buffer[256];
-		// is >> buffer;
-		// int length = atoi(buffer);
-		// if(this->mTotalFrame == 0 || length < mTotalFrame) {
-		// 	mTotalFrame = length;
-		// }
-
-	//	for(int k = 0; k < length; k++) {
-		int length = 0;
-		while(!is.eof()) {
-			Eigen::VectorXd p(dof);
-			for(int j = 0; j < dof; j++) 
-			{
-				is >> buffer;
-				p[j] = atof(buffer);
+		if(DPhy::RolloutReader::IsRecordFile(record_path)) {
+			DPhy::RolloutReader reader;
+			reader.Load(record_path);
+			int length = reader.GetNumFrames();
+			for(int k = 0; k < length; k++) {
+				Eigen::VectorXd p = reader.GetPositions(k);
+				Eigen::Vector3d o;
+				if(k == 0) {
+					o = p.segment<3>(3);
+					o[1] = 0;
+				} else
+					o = mMemoryObj.back();
+				record_pos.push_back(p);
+				mMemoryObj.push_back(o);
+			}
+			if(this->mTotalFrame == 0 || length < mTotalFrame) {
+				mTotalFrame = length;
 			}
+		} else {
+			std::ifstream is(record_path);
+		
+			char buffer[256];
 			// is >> buffer;
+			// int length = atoi(buffer);
+			// if(this->mTotalFrame == 0 || length < mTotalFrame) {
+			// 	mTotalFrame = length;
+			// }
 
-			Eigen::Vector3d o;
-			if(length == 0) {
-				o = p.segment<3>(3);
-				o[1] = 0;
-			} else 
-				o = mMemoryObj.back();
+		//	for(int k = 0; k < length; k++) {
+			int length = 0;
+			while(!is.eof()) {
+				Eigen::VectorXd p(dof);
+				for(int j = 0; j < dof; j++) 
+				{
+					is >> buffer;
+					p[j] = atof(buffer);
+				}
+				// is >> buffer;
+
+				Eigen::Vector3d o;
+				if(length == 0) {
+					o = p.segment<3>(3);
+					o[1] = 0;
+				} else 
+					o = mMemoryObj.back();
 			
-			// for(int j = 0; j < 3; j++) 
-			// {
-			// 	is >> buffer;
-			// 	o(j) = atof(buffer);
-			// }
-			record_pos.push_back(p);
-			mMemoryObj.push_back(o);
-			length++;
-		}
-		record_pos.pop_back();
-		mMemoryObj.pop_back();
+				// for(int j = 0; j < 3; j++) 
+				// {
+				// 	is >> buffer;
+				// 	o(j) = atof(buffer);
+				// }
+				record_pos.push_back(p);
+				mMemoryObj.push_back(o);
+				length++;
+			}
+			record_pos.pop_back();
+			mMemoryObj.pop_back();
 
-		length -= 1;
-	//	}
+			length -= 1;
+		//	}
 
-		is.close();
-		if(this->mTotalFrame == 0 || length < mTotalFrame) {
-			mTotalFrame = length;
+			is.close();
+			if(this->mTotalFrame == 0 || length < mTotalFrame) {
+				mTotalFrame = length;
+			}
 		}
 		mMemoryRef.push_back(record_pos);
 		if(i == motion.size()-1)
@@ -2,6 +2,7 @@
 #include "SeqRecordWindow.h"
 #include "dart/external/lodepng/lodepng.h"
 #include "Functions.h"
+#include "RolloutRecorder.h"
 #include <algorithm>
 #include <fstream>
 #include <boost/filesystem.hpp>
@@ -22,18 +23,28 @@ SeqRecordWindow(std::vector<std::string> motion)
 	auto skel = this->mRef->GetSkeleton();
 	int length = 0;
 
+	int dof = skel->getPositions().rows();
+	std::vector<std::vector<Eigen::VectorXd>> records;
 	for(int i = 0; i < motion.size(); i++) {
-
+		std::string record_path = motion[i];
+		if(DPhy::RolloutReader::IsRecordFile(record_path)) {
+			// every episode of a binary record is shown as one record
+			DPhy::RolloutReader reader;
+			reader.Load(record_path);
+			std::vector<std::pair<int, int>> episodes = reader.GetEpisodes();
+			for(int j = 0; j < episodes.size(); j++) {
+				std::vector<Eigen::VectorXd> record_pos;
+				for(int k = episodes[j].first; k < episodes[j].second; k++)
+					record_pos.push_back(reader.GetPositions(k));
+				records.push_back(record_pos);
+			}
+			continue;
+		}
 
 		std::vector<Eigen::VectorXd> record_pos;
-		record_pos.clear();
-
-		int dof = skel->getPositions().rows();
-		std::string record_path = motion[i];
 		std::ifstream is(record_path);
 		
 		char buffer[256];
-		int target_count = 1;
 		while(!is.eof()) {
 			Eigen::VectorXd p(dof);
 			for(int j = 0; j < dof; j++) 
@@ -43,6 +54,18 @@ SeqRecordWindow(std::vector<std::string> motion)
 			}
 				// is >> buffer;
 				// is >> buffer;
+			record_pos.push_back(p);
+		}
+		record_pos.pop_back();
+		records.push_back(record_pos);
+
+		is.close();
+	}
+
+	for(int i = 0; i < records.size(); i++) {
+		int target_count = 1;
+		for(int k = 0; k < records[i].size(); k++) {
+			Eigen::VectorXd p = records[i][k];
 
 			mMemoryRef.push_back(p);
 			length++;
@@ -59,12 +82,8 @@ SeqRecordWindow(std::vector<std::string> motion)
 			}
 			target_count += 1;
 		}
-		mMemoryRef.pop_back();
-		length -= 1;
 	
 		mEndKeyFrame.push_back(mMemoryRef.size() - 1);
-
-		is.close();
 	}
 	if(this->mTotalFrame == 0 || length < mTotalFrame) {
 		mTotalFrame = length;
@@ -250,7 +250,7 @@ UpdateParam(const bool& pressed) {
 }
 void MotionWidget::UpdateIthParam(int i)
 {
-    mReferenceManager->LoadAdaptiveMotion(mRegressionMemory->mloadAllSamples[i]->cps);
+    mReferenceManager->LoadAdaptiveMotion(mRegressionMemory->mloadAllSamples[i]->cps.Decode());
 
 
     std::vector<Eigen::VectorXd> pos;
@@ -0,0 +1,89 @@
+#ifndef __DEEP_PHYSICS_ASYNC_QUEUE_H__
+#define __DEEP_PHYSICS_ASYNC_QUEUE_H__
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+namespace DPhy
+{
+/**
+*
+* @brief Multi-producer single-consumer queue with its own consumer thread.
+* @details Producers only append to a vector under a short lock. The consumer swaps the whole vector out and runs
+* the consume function on each item without holding the lock. The thread starts with the first push, and the
+* destructor drains what is left before joining.
+*
+*/
+template<class T>
+class AsyncQueue
+{
+public:
+	AsyncQueue(std::function<void(T&)> consume)
+	:mConsume(consume), mPending(0), mStop(false) {}
+	~AsyncQueue()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mLock);
+			mStop = true;
+		}
+		mCond.notify_one();
+		if(mThread.joinable())
+			mThread.join();
+	}
+	void Push(T&& item)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mLock);
+			if(!mThread.joinable())
+				mThread = std::thread(&AsyncQueue::Run, this);
+			mItems.push_back(std::move(item));
+			mPending += 1;
+		}
+		mCond.notify_one();
+	}
+	// blocks until every pushed item is consumed
+	void Wait()
+	{
+		std::unique_lock<std::mutex> lock(mLock);
+		mDone.wait(lock, [this]() { return mPending == 0; });
+	}
+	int GetNumPending()
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		return mPending;
+	}
+private:
+	void Run()
+	{
+		std::vector<T> batch;
+		while(true) {
+			{
+				std::unique_lock<std::mutex> lock(mLock);
+				mCond.wait(lock, [this]() { return mStop || !mItems.empty(); });
+				if(mItems.empty())
+					return;
+				batch.swap(mItems);
+			}
+			for(int i = 0; i < batch.size(); i++)
+				mConsume(batch[i]);
+			{
+				std::lock_guard<std::mutex> lock(mLock);
+				mPending -= batch.size();
+			}
+			batch.clear();
+			mDone.notify_all();
+		}
+	}
+
+	std::function<void(T&)> mConsume;
+	std::vector<T> mItems;
+	int mPending;
+	bool mStop;
+	std::mutex mLock;
+	std::condition_variable mCond;
+	std::condition_variable mDone;
+	std::thread mThread;
+};
+}
+#endif
@@ -61,6 +61,7 @@ public:
 	double GetTimeStep(){return mTimeStep;}
 	void Parse(const std::string& file);
 	std::vector<std::string> GetHierarchyStr() {return mHierarchyStr; }
+	std::string GetRootName() {return mRoot->GetName(); }
 private:
 	std::vector<Eigen::VectorXd> mMotions;
 	std::map<std::string,BVHNode*> mMap;
@@ -0,0 +1,201 @@
+#include "BVHWriter.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+namespace DPhy
+{
+typedef Eigen::ArrayXd Arr;
+
+// fixed point with 4 decimals, without going through a stream
+static void
+AppendNumber(std::string& out, double v)
+{
+	if(!std::isfinite(v) || std::abs(v) > 1e12) {
+		char buf[32];
+		int n = std::snprintf(buf, sizeof(buf), "%g", v);
+		out.append(buf, n);
+		return;
+	}
+	long long scaled = std::llround(v * 1e4);
+	if(scaled < 0) {
+		out.push_back('-');
+		scaled = -scaled;
+	}
+	long long ip = scaled / 10000;
+	int fp = scaled % 10000;
+	char buf[24];
+	int n = 0;
+	do {
+		buf[n++] = '0' + ip % 10;
+		ip /= 10;
+	} while(ip > 0);
+	while(n > 0)
+		out.push_back(buf[--n]);
+	out.push_back('.');
+	out.push_back('0' + fp / 1000);
+	out.push_back('0' + fp / 100 % 10);
+	out.push_back('0' + fp / 10 % 10);
+	out.push_back('0' + fp % 10);
+}
+BVHWriter::
+BVHWriter(const dart::dynamics::SkeletonPtr& skel, const std::map<std::string, std::string>& bvhMap,
+		  const std::string& root, const std::vector<std::string>& hierarchy, double frameTime)
+	:mRoot(root), mHierarchy(hierarchy), mNumChannels(0), mFrameTime(frameTime)
+{
+	std::map<std::string, int> dofs;
+	for(auto ss : bvhMap) {
+		dart::dynamics::BodyNode* bn = skel->getBodyNode(ss.first);
+		if(bn != nullptr && bn->getParentJoint()->getNumDofs() > 0)
+			dofs[ss.second] = bn->getParentJoint()->getIndexInSkeleton(0);
+	}
+
+	std::string joint = root;
+	Eigen::Vector3d offset = Eigen::Vector3d::Zero();
+	for(int i = 0; i < mHierarchy.size(); i++) {
+		std::stringstream ss(mHierarchy[i]);
+		std::string key;
+		ss >> key;
+		if(key == "JOINT") {
+			ss >> joint;
+		} else if(key == "End") {
+			joint = "";
+		} else if(key == "OFFSET") {
+			ss >> offset[0] >> offset[1] >> offset[2];
+		} else if(key == "CHANNELS") {
+			int n;
+			ss >> n;
+			std::string order;
+			for(int j = 0; j < n; j++) {
+				std::string c;
+				ss >> c;
+				if(c.find("rotation") != std::string::npos)
+					order += c.substr(0, 1);
+			}
+			if(order != "ZXY")
+				std::cout << "bvh writer : " << joint << " has rotation order " << order << ", written as ZXY" << std::endl;
+
+			Channel c;
+			c.dof = dofs.count(joint) ? dofs[joint] : -1;
+			c.translation = (n == 6);
+			c.offset = offset;
+			mChannels.push_back(c);
+			mNumChannels += n;
+		}
+	}
+}
+void
+BVHWriter::
+Convert(const std::vector<Eigen::VectorXd>& pos, Eigen::MatrixXd& motion) const
+{
+	int n = pos.size();
+	int dof = n > 0 ? pos[0].rows() : 0;
+	Eigen::MatrixXd p(n, dof);
+	for(int i = 0; i < n; i++)
+		p.row(i) = pos[i].transpose();
+
+	motion.resize(n, mNumChannels);
+	int col = 0;
+	for(int i = 0; i < mChannels.size(); i++) {
+		const Channel& c = mChannels[i];
+		if(c.translation) {
+			for(int j = 0; j < 3; j++) {
+				if(c.dof != -1 && i == 0)
+					motion.col(col + j) = p.col(c.dof + 3 + j) * 100;
+				else
+					motion.col(col + j).setConstant(c.offset[j]);
+			}
+			col += 3;
+		}
+		if(c.dof == -1) {
+			motion.middleCols(col, 3).setZero();
+			col += 3;
+			continue;
+		}
+
+		// rotation matrix entries of the exponential map, R = I + sin(t)/t [v] + (1-cos(t))/t^2 [v]^2
+		Arr x = p.col(c.dof).array();
+		Arr y = p.col(c.dof + 1).array();
+		Arr z = p.col(c.dof + 2).array();
+		Arr t2 = x*x + y*y + z*z;
+		Arr t = t2.sqrt();
+		Arr a = (t < 1e-6).select(1.0 - t2 / 6.0, t.sin() / t);
+		Arr b = (t < 1e-6).select(0.5 - t2 / 24.0, (1.0 - t.cos()) / t2);
+
+		Arr r00 = 1.0 - b*(y*y + z*z);
+		Arr r11 = 1.0 - b*(x*x + z*z);
+		Arr r22 = 1.0 - b*(x*x + y*y);
+		Arr r01 = b*x*y - a*z;
+		Arr r02 = b*x*z + a*y;
+		Arr r20 = b*x*z - a*y;
+		Arr r21 = b*y*z + a*x;
+
+		// same branches as dart::math::matrixToEulerZXY
+		Arr ex = r21.max(-1.0).min(1.0).asin();
+		Arr ez(n), ey(n);
+		for(int k = 0; k < n; k++) {
+			if(ex[k] < M_PI / 2 && ex[k] > -M_PI / 2) {
+				ez[k] = std::atan2(-r01[k], r11[k]);
+				ey[k] = std::atan2(-r20[k], r22[k]);
+			} else {
+				ez[k] = (ex[k] > 0 ? 1 : -1) * std::atan2(r02[k], r00[k]);
+				ey[k] = 0;
+			}
+		}
+		motion.col(col) = ez * 180 / M_PI;
+		motion.col(col + 1) = ex * 180 / M_PI;
+		motion.col(col + 2) = ey * 180 / M_PI;
+		col += 3;
+	}
+}
+bool
+BVHWriter::
+Write(const std::string& path, const std::vector<Eigen::VectorXd>& pos) const
+{
+	Eigen::MatrixXd motion;
+	this->Convert(pos, motion);
+
+	std::string out;
+	out.reserve(4096 + motion.size() * 10);
+	out += "HIERARCHY\nROOT " + mRoot + "\n";
+	for(int i = 0; i < mHierarchy.size(); i++)
+		out += mHierarchy[i] + "\n";
+	out += "MOTION\nFrames: " + std::to_string(motion.rows()) + "\n";
+	out += "Frame Time:\t" + std::to_string(mFrameTime) + "\n";
+	for(int i = 0; i < motion.rows(); i++) {
+		for(int j = 0; j < motion.cols(); j++) {
+			if(j != 0)
+				out.push_back(' ');
+			AppendNumber(out, motion(i, j));
+		}
+		out.push_back('\n');
+	}
+
+	std::ofstream ofs(path, std::ios::binary);
+	if(!ofs.is_open()) {
+		std::cout << "bvh writer : cannot open " << path << std::endl;
+		return false;
+	}
+	ofs.write(out.data(), out.size());
+	return true;
+}
+void
+BVHWriter::
+WriteBatch(const std::vector<std::string>& paths, const std::vector<std::vector<Eigen::VectorXd>>& pos) const
+{
+	int n = paths.size();
+	int num_threads = std::max(1, std::min(n, (int)std::thread::hardware_concurrency()));
+	std::atomic<int> next(0);
+	std::vector<std::thread> threads;
+	for(int i = 0; i < num_threads; i++) {
+		threads.push_back(std::thread([&]() {
+			for(int j = next++; j < n; j = next++)
+				this->Write(paths[j], pos[j]);
+		}));
+	}
+	for(int i = 0; i < threads.size(); i++)
+		threads[i].join();
+}
+}
@@ -0,0 +1,44 @@
+#ifndef __DEEP_PHYSICS_BVH_WRITER_H__
+#define __DEEP_PHYSICS_BVH_WRITER_H__
+#include "dart/dart.hpp"
+#include <vector>
+#include <string>
+#include <map>
+namespace DPhy
+{
+/**
+*
+* @brief Writes skeleton position trajectories as BVH files.
+* @details The channel layout comes from the hierarchy of the loaded BVH and the body to BVH joint map of the
+* character, so no joint order is hard coded. A whole trajectory is converted joint by joint over all frames
+* (exponential map to ZXY euler angles) and formatted into one text buffer that is written at once. WriteBatch
+* exports several trajectories on parallel threads.
+*
+*/
+class BVHWriter
+{
+public:
+	BVHWriter(const dart::dynamics::SkeletonPtr& skel, const std::map<std::string, std::string>& bvhMap,
+			  const std::string& root, const std::vector<std::string>& hierarchy, double frameTime=1.0/30.0);
+
+	bool Write(const std::string& path, const std::vector<Eigen::VectorXd>& pos) const;
+	void WriteBatch(const std::vector<std::string>& paths, const std::vector<std::vector<Eigen::VectorXd>>& pos) const;
+private:
+	struct Channel
+	{
+		// position dof of the joint, -1 if the BVH joint has no body in the skeleton
+		int dof;
+		bool translation;
+		Eigen::Vector3d offset;
+	};
+	// frames x channels, in degrees and centimeters
+	void Convert(const std::vector<Eigen::VectorXd>& pos, Eigen::MatrixXd& motion) const;
+
+	std::string mRoot;
+	std::vector<std::string> mHierarchy;
+	std::vector<Channel> mChannels;
+	int mNumChannels;
+	double mFrameTime;
+};
+}
+#endif
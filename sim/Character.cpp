@@ -17,7 +17,12 @@ Character::Character(const std::string& path)
 	std::pair<SkeletonPtr, std::map<std::string, double>*> p = SkeletonBuilder::BuildFromFile(path);
 	this->mSkeleton = p.first;
 	this->mTorqueMap = p.second;
-
+	this->mHandles = new SkeletonHandles(this->mSkeleton);
+	this->mPositionDifference = new PositionDifference(this->mSkeleton);
+	this->mPoseLayout = new PoseLayout(this->mSkeleton);
+	this->mSPDSolver = new TreeLDLT(this->mSkeleton);
+	this->mSPDRefactorInterval = 1;
+	this->mSPDFactorAge = 1;
 
 	mPath = path;
 }
@@ -28,6 +33,15 @@ const dart::dynamics::SkeletonPtr& Character::GetSkeleton()
 void Character::SetSkeleton(dart::dynamics::SkeletonPtr skel)
 {
 	this->mSkeleton = skel;
+	delete this->mHandles;
+	delete this->mPositionDifference;
+	delete this->mPoseLayout;
+	delete this->mSPDSolver;
+	this->mHandles = new SkeletonHandles(this->mSkeleton);
+	this->mPositionDifference = new PositionDifference(this->mSkeleton);
+	this->mPoseLayout = new PoseLayout(this->mSkeleton);
+	this->mSPDSolver = new TreeLDLT(this->mSkeleton);
+	this->InvalidateSPDFactor();
 }
 void Character::SetPDParameters(double kp, double kv)
 {
@@ -44,6 +58,7 @@ void Character::SetPDParameters(const Eigen::VectorXd& kp, const Eigen::VectorXd
 
 	this->mKp_default = this->mKp;
 	this->mKv_default = this->mKv;
+	this->InvalidateSPDFactor();
 }
 
 void Character::SetPDParameters(const Eigen::VectorXd& k)
@@ -53,6 +68,7 @@ void Character::SetPDParameters(const Eigen::VectorXd& k)
 	this->mKv.setZero();
 	this->mKp.segment(6, dof-6) = k.segment(0, dof-6).array()*this->mKp_default.segment(6, dof-6).array();
 	this->mKv.segment(6, dof-6) = k.segment(dof-6, dof-6).array()*this->mKv_default.segment(6, dof-6).array();
+	this->InvalidateSPDFactor();
 }
 
 double Character::GetTorqueLimit(const std::string name)
@@ -93,13 +109,12 @@ Eigen::VectorXd Character::GetPDForces(const Eigen::VectorXd& p_desired, const E
 	tau.segment<6>(0) = Eigen::VectorXd::Zero(6);
 	return tau;
 }
-Eigen::VectorXd Character::GetSPDForces(const Eigen::VectorXd& p_desired, const Eigen::VectorXd& v_desired)
+Eigen::VectorXd Character::GetSPDErrorForces(const Eigen::VectorXd& p_desired, const Eigen::VectorXd& v_desired)
 {
 	auto& skel = mSkeleton;
 	Eigen::VectorXd q = skel->getPositions();
 	Eigen::VectorXd dq = skel->getVelocities();
 	double dt = skel->getTimeStep();
-	Eigen::MatrixXd M_inv = (skel->getMassMatrix() + Eigen::MatrixXd(dt*mKv.asDiagonal())).inverse();
 
 	// Eigen::VectorXd p_d = q + dq*dt - p_desired;
 	Eigen::VectorXd p_d(q.rows());
@@ -126,10 +141,42 @@ Eigen::VectorXd Character::GetSPDForces(const Eigen::VectorXd& p_desired, const
 	}
 	Eigen::VectorXd p_diff = -mKp.cwiseProduct(p_d);
 	Eigen::VectorXd v_diff = -mKv.cwiseProduct(dq-v_desired);
+	return p_diff + v_diff;
+}
+Eigen::VectorXd Character::GetSPDForces(const Eigen::VectorXd& p_desired, const Eigen::VectorXd& v_desired)
+{
+	auto& skel = mSkeleton;
+	double dt = skel->getTimeStep();
+	Eigen::MatrixXd M_inv = (skel->getMassMatrix() + Eigen::MatrixXd(dt*mKv.asDiagonal())).inverse();
+
+	Eigen::VectorXd pv_diff = this->GetSPDErrorForces(p_desired, v_desired);
 	Eigen::VectorXd qddot = M_inv*(-skel->getCoriolisAndGravityForces()+
-							p_diff+v_diff+skel->getConstraintForces());
+							pv_diff+skel->getConstraintForces());
+
+	Eigen::VectorXd tau = pv_diff - dt*mKv.cwiseProduct(qddot);
+	tau.segment<6>(0) = Eigen::VectorXd::Zero(6);
+	return tau;
+}
+Eigen::VectorXd Character::GetFactorizedSPDForces(const Eigen::VectorXd& p_desired, const Eigen::VectorXd& v_desired)
+{
+	auto& skel = mSkeleton;
+	double dt = skel->getTimeStep();
+	Eigen::VectorXd q = skel->getPositions();
+	bool same_positions = mSPDFactorPositions.rows() == q.rows() && q == mSPDFactorPositions;
+	if(!same_positions && mSPDFactorAge >= mSPDRefactorInterval) {
+		Eigen::MatrixXd A = skel->getMassMatrix();
+		A.diagonal() += dt*mKv;
+		mSPDSolver->Compute(A);
+		mSPDFactorPositions = q;
+		mSPDFactorAge = 0;
+	}
+	mSPDFactorAge += 1;
+
+	Eigen::VectorXd pv_diff = this->GetSPDErrorForces(p_desired, v_desired);
+	Eigen::VectorXd qddot = mSPDSolver->Solve(-skel->getCoriolisAndGravityForces()+
+							pv_diff+skel->getConstraintForces());
 
-	Eigen::VectorXd tau = p_diff + v_diff - dt*mKv.cwiseProduct(qddot);
+	Eigen::VectorXd tau = pv_diff - dt*mKv.cwiseProduct(qddot);
 	tau.segment<6>(0) = Eigen::VectorXd::Zero(6);
 	return tau;
 }
@@ -2,6 +2,10 @@
 #define __DEEP_PHYSICS_CHARACTER_H__
 #include "dart/dart.hpp"
 #include "BVH.h"
+#include "SkeletonHandles.h"
+#include "PositionDifference.h"
+#include "Pose.h"
+#include "TreeLDLT.h"
 namespace DPhy
 {
 /**
@@ -13,12 +17,15 @@ namespace DPhy
 class Character
 {
 public:
-	Character(){}
+	Character():mHandles(nullptr), mPositionDifference(nullptr), mPoseLayout(nullptr), mSPDSolver(nullptr){}
 	Character(const std::string& path);
 //	Character(const dart::dynamics::SkeletonPtr& skeleton);
 
 	const dart::dynamics::SkeletonPtr& GetSkeleton();
 	void SetSkeleton(dart::dynamics::SkeletonPtr skel);
+	SkeletonHandles* GetHandles() { return mHandles; }
+	PositionDifference* GetPositionDifference() { return mPositionDifference; }
+	PoseLayout* GetPoseLayout() { return mPoseLayout; }
 	void SetPDParameters(double kp, double kv);
 	void SetPDParameters(const Eigen::VectorXd& kp, const Eigen::VectorXd& kv);
 	void SetPDParameters(const Eigen::VectorXd& k);
@@ -26,17 +33,33 @@ public:
 	double GetTorqueLimit(const std::string name);
 	Eigen::VectorXd GetPDForces(const Eigen::VectorXd& p_desired, const Eigen::VectorXd& v_desired);
 	Eigen::VectorXd GetSPDForces(const Eigen::VectorXd& p_desired, const Eigen::VectorXd& v_desired);
+	// same as GetSPDForces, solving with a tree factorization of (M + dt*Kv) that is kept between calls
+	Eigen::VectorXd GetFactorizedSPDForces(const Eigen::VectorXd& p_desired, const Eigen::VectorXd& v_desired);
+	// the factorization is reused while the positions are unchanged, or for up to interval calls since it was computed
+	void SetSPDRefactorInterval(int interval) { mSPDRefactorInterval = std::max(interval, 1); }
+	void InvalidateSPDFactor() { mSPDFactorAge = mSPDRefactorInterval; mSPDFactorPositions.resize(0); }
 	std::map<std::string,std::string> GetBVHMap() {return mBVHMap;} //body_node name and bvh_node name
 
 	void LoadBVHMap();
 
 protected:
+	// position error forces -Kp*(q + dq*dt - p_desired) - Kv*(dq - v_desired) of the stable PD controller
+	Eigen::VectorXd GetSPDErrorForces(const Eigen::VectorXd& p_desired, const Eigen::VectorXd& v_desired);
+
 	std::string mPath;
 	dart::dynamics::SkeletonPtr mSkeleton;
+	SkeletonHandles* mHandles;
+	PositionDifference* mPositionDifference;
+	PoseLayout* mPoseLayout;
 	std::map<std::string, double>* mTorqueMap; //body_node name and bvh_node name
 	std::map<std::string,std::string> mBVHMap; //body_node name and bvh_node name
 	Eigen::VectorXd mKp, mKv;
 	Eigen::VectorXd mKp_default, mKv_default;
+
+	TreeLDLT* mSPDSolver;
+	Eigen::VectorXd mSPDFactorPositions;
+	int mSPDRefactorInterval;
+	int mSPDFactorAge;
 };
 };
 
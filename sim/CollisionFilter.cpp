@@ -0,0 +1,123 @@
+#include "CollisionFilter.h"
+#include "Functions.h"
+#include <tinyxml.h>
+#include <limits>
+namespace DPhy
+{
+// bodies of a space separated list of names
+static std::vector<int>
+ParseBodies(const dart::dynamics::SkeletonPtr& skel, const char* names)
+{
+	std::vector<int> idx;
+	if(names == nullptr)
+		return idx;
+	std::vector<std::string> list = split(std::string(names), ' ');
+	for(int i = 0; i < list.size(); i++) {
+		if(list[i] == "")
+			continue;
+		dart::dynamics::BodyNode* bn = skel->getBodyNode(list[i]);
+		if(bn == nullptr)
+			std::cout << "collision filter : no body named " << list[i] << std::endl;
+		else
+			idx.push_back(bn->getIndexInSkeleton());
+	}
+	return idx;
+}
+CharacterCollisionFilter::
+CharacterCollisionFilter(const dart::dynamics::SkeletonPtr& skel, const std::string& path)
+	:mHasSelfGroups(false), mGround(nullptr), mGroundHeight(0)
+{
+	int n_bnodes = skel->getNumBodyNodes();
+	for(int i = 0; i < n_bnodes; i++)
+		mBodies.push_back(skel->getBodyNode(i));
+	mGroundMask.assign(n_bnodes, true);
+	mSelfGroups.assign(n_bnodes, 0);
+
+	TiXmlDocument doc;
+	if(!doc.LoadFile(path)){
+		std::cout << "Can't open file : " << path << std::endl;
+		return;
+	}
+	TiXmlElement* collision = doc.FirstChildElement("Skeleton")->FirstChildElement("Collision");
+	if(collision == nullptr)
+		return;
+
+	TiXmlElement* ground = collision->FirstChildElement("Ground");
+	if(ground != nullptr) {
+		mGroundMask.assign(n_bnodes, false);
+		std::vector<int> idx = ParseBodies(skel, ground->Attribute("bodies"));
+		for(int i = 0; i < idx.size(); i++)
+			mGroundMask[idx[i]] = true;
+	}
+
+	int group = 0;
+	for(TiXmlElement* self = collision->FirstChildElement("SelfGroup"); self != nullptr; self = self->NextSiblingElement("SelfGroup")) {
+		if(group == 32) {
+			std::cout << "collision filter : more than 32 self collision groups" << std::endl;
+			break;
+		}
+		std::vector<int> idx = ParseBodies(skel, self->Attribute("bodies"));
+		for(int i = 0; i < idx.size(); i++)
+			mSelfGroups[idx[i]] |= 1u << group;
+		group += 1;
+	}
+	mHasSelfGroups = group > 0;
+	if(mHasSelfGroups) {
+		skel->setSelfCollisionCheck(true);
+		skel->setAdjacentBodyCheck(collision->Attribute("adjacent") != nullptr && std::string(collision->Attribute("adjacent")) == "true");
+	}
+}
+void
+CharacterCollisionFilter::
+SetGround(dart::dynamics::BodyNode* ground)
+{
+	mGround = ground;
+	std::vector<dart::dynamics::ShapeNode*> shapes = ground->getShapeNodesWith<dart::dynamics::CollisionAspect>();
+	mGroundHeight = -std::numeric_limits<double>::max();
+	for(int i = 0; i < shapes.size(); i++)
+		mGroundHeight = std::max(mGroundHeight, GetHeight(shapes[i], false));
+}
+int
+CharacterCollisionFilter::
+GetCharacterIndex(const dart::dynamics::BodyNode* bn) const
+{
+	int idx = bn->getIndexInSkeleton();
+	if(idx < mBodies.size() && mBodies[idx] == bn)
+		return idx;
+	return -1;
+}
+double
+CharacterCollisionFilter::
+GetHeight(const dart::dynamics::ShapeFrame* frame, bool lowest)
+{
+	const dart::math::BoundingBox& box = frame->getShape()->getBoundingBox();
+	const Eigen::Isometry3d& T = frame->getWorldTransform();
+	Eigen::Vector3d center = T * (0.5 * (box.getMin() + box.getMax()));
+	Eigen::Vector3d half = 0.5 * (box.getMax() - box.getMin());
+	double extent = T.linear().row(1).cwiseAbs().dot(half);
+	return lowest ? center[1] - extent : center[1] + extent;
+}
+bool
+CharacterCollisionFilter::
+ignoresCollision(const dart::collision::CollisionObject* object1,
+				 const dart::collision::CollisionObject* object2) const
+{
+	const dart::dynamics::ShapeNode* shape1 = object1->getShapeFrame()->asShapeNode();
+	const dart::dynamics::ShapeNode* shape2 = object2->getShapeFrame()->asShapeNode();
+	if(shape1 == nullptr || shape2 == nullptr)
+		return false;
+	const dart::dynamics::BodyNode* bn1 = shape1->getBodyNodePtr();
+	const dart::dynamics::BodyNode* bn2 = shape2->getBodyNodePtr();
+	int idx1 = this->GetCharacterIndex(bn1);
+	int idx2 = this->GetCharacterIndex(bn2);
+
+	if(idx1 != -1 && idx2 != -1)
+		return mHasSelfGroups && (mSelfGroups[idx1] & mSelfGroups[idx2]) == 0;
+
+	if(idx1 != -1 && bn2 == mGround)
+		return !mGroundMask[idx1] || GetHeight(shape1, true) > mGroundHeight;
+	if(idx2 != -1 && bn1 == mGround)
+		return !mGroundMask[idx2] || GetHeight(shape2, true) > mGroundHeight;
+	return false;
+}
+}
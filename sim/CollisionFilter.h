@@ -0,0 +1,51 @@
+#ifndef __DEEP_PHYSICS_COLLISION_FILTER_H__
+#define __DEEP_PHYSICS_COLLISION_FILTER_H__
+#include "dart/dart.hpp"
+#include <vector>
+#include <string>
+namespace DPhy
+{
+/**
+*
+* @brief Collision pairs of the character that are worth a narrow phase test.
+* @details Configured by the optional Collision element of the character xml,
+*
+*	<Collision adjacent="false">
+*		<Ground bodies="RightFoot RightToe LeftFoot LeftToe RightHand LeftHand"/>
+*		<SelfGroup bodies="LeftHand RightHand Head"/>
+*	</Collision>
+*
+* Only the Ground bodies collide with the ground (all bodies without a Ground element); the others pass through it,
+* which changes falls and the root height termination, so the bundled characters do not restrict it. Any SelfGroup turns on self
+* collision, and a pair of bodies collides only if both are in one group; adjacent bodies are skipped unless
+* adjacent is true. Collisions with other objects are not filtered. Pairs with the ground are also culled by a plane
+* broad-phase: a body whose lowest point is above the top of the ground box cannot touch it, which holds for
+* ground.xml since it is a box far wider than any motion. Meant to be combined with the default filter of the
+* constraint solver.
+*
+*/
+class CharacterCollisionFilter : public dart::collision::CollisionFilter
+{
+public:
+	CharacterCollisionFilter(const dart::dynamics::SkeletonPtr& skel, const std::string& path);
+
+	// the ground is taken as the plane through the top face of the bounding boxes of its shapes
+	void SetGround(dart::dynamics::BodyNode* ground);
+
+	bool ignoresCollision(const dart::collision::CollisionObject* object1,
+						  const dart::collision::CollisionObject* object2) const override;
+private:
+	int GetCharacterIndex(const dart::dynamics::BodyNode* bn) const;
+	// lowest or highest world y of the bounding box of a shape
+	static double GetHeight(const dart::dynamics::ShapeFrame* frame, bool lowest);
+
+	std::vector<const dart::dynamics::BodyNode*> mBodies;
+	std::vector<bool> mGroundMask;
+	std::vector<unsigned int> mSelfGroups;
+	bool mHasSelfGroups;
+
+	const dart::dynamics::BodyNode* mGround;
+	double mGroundHeight;
+};
+}
+#endif
@@ -18,6 +18,11 @@ Controller::Controller(ReferenceManager* ref, bool adaptive, bool parametric, bo
 	this->isAdaptive = adaptive;
 	this->isParametric = parametric;
 	this->mRecord = record;
+	this->mRecorder = nullptr;
+	this->mFactorizedSPD = false;
+	this->mResetState = nullptr;
+	this->mStepCollision = false;
+	this->mInitialStateVersion = -1;
 	this->mReferenceManager = ref;
 	this->id = id;
 	this->mParamGoal = mReferenceManager->GetParamGoal();
@@ -31,6 +36,8 @@ Controller::Controller(ReferenceManager* ref, bool adaptive, bool parametric, bo
 
 	this->mWorld->setTimeStep(1.0/(double)mSimulationHz);
 	this->mWorld->getConstraintSolver()->setCollisionDetector(dart::collision::DARTCollisionDetector::create());
+	// the warm started solver is opt in through SetWarmStartContacts, dart's cold PGS stays the default
+	this->mContactSolver = std::make_shared<WarmStartPgsSolver>(mWorld->getConstraintSolver());
 	dynamic_cast<dart::constraint::BoxedLcpConstraintSolver*>(mWorld->getConstraintSolver())->setBoxedLcpSolver(std::make_shared<dart::constraint::PgsBoxedLcpSolver>());
 	
 	this->mGround = DPhy::SkeletonBuilder::BuildFromFile(std::string(CAR_DIR)+std::string("/character/ground.xml")).first;
@@ -41,6 +48,28 @@ Controller::Controller(ReferenceManager* ref, bool adaptive, bool parametric, bo
 	this->mCharacter = new DPhy::Character(path);
 	this->mWorld->addSkeleton(this->mCharacter->GetSkeleton());
 
+	this->mCollisionFilter = std::make_shared<CharacterCollisionFilter>(mCharacter->GetSkeleton(), path);
+	this->mCollisionFilter->SetGround(mGround->getBodyNode(0));
+	dart::collision::CollisionOption& collisionOption = mWorld->getConstraintSolver()->getCollisionOption();
+	this->mDefaultCollisionFilter = collisionOption.collisionFilter;
+	this->mCompositeCollisionFilter = std::make_shared<dart::collision::CompositeCollisionFilter>();
+	if(mDefaultCollisionFilter != nullptr)
+		this->mCompositeCollisionFilter->addCollisionFilter(mDefaultCollisionFilter.get());
+	this->mCompositeCollisionFilter->addCollisionFilter(mCollisionFilter.get());
+	// opt in through SetCollisionFiltering until car_bench has measured the step time and the equivalence of rollouts
+
+	// collision shapes in world order, the index is what snapshots of the contact cache refer to
+	std::vector<const dart::dynamics::ShapeFrame*> shapeFrames;
+	for(int i = 0; i < mWorld->getNumSkeletons(); i++) {
+		dart::dynamics::SkeletonPtr s = mWorld->getSkeleton(i);
+		for(int j = 0; j < s->getNumBodyNodes(); j++) {
+			std::vector<dart::dynamics::ShapeNode*> shapes = s->getBodyNode(j)->getShapeNodesWith<dart::dynamics::CollisionAspect>();
+			for(int k = 0; k < shapes.size(); k++)
+				shapeFrames.push_back(shapes[k]);
+		}
+	}
+	this->mContactSolver->SetShapeFrames(shapeFrames);
+
 	this->mBaseMass = mCharacter->GetSkeleton()->getMass();
 	this->mMass = mBaseMass;
 
@@ -66,6 +95,15 @@ Controller::Controller(ReferenceManager* ref, bool adaptive, bool parametric, bo
 	this->mCGHL = collisionEngine->createCollisionGroup(this->mCharacter->GetSkeleton()->getBodyNode("LeftHand"));
 	this->mCGHR = collisionEngine->createCollisionGroup(this->mCharacter->GetSkeleton()->getBodyNode("RightHand"));
 	this->mCGG = collisionEngine->createCollisionGroup(this->mGround.get());
+	this->mHandles = mCharacter->GetHandles();
+	for(int i = 0; i < NUM_BODY_HANDLES; i++)
+		this->mCGBody[i] = nullptr;
+	this->mCGBody[BODY_LEFT_FOOT] = mCGL.get();
+	this->mCGBody[BODY_RIGHT_FOOT] = mCGR.get();
+	this->mCGBody[BODY_LEFT_TOE] = mCGEL.get();
+	this->mCGBody[BODY_RIGHT_TOE] = mCGER.get();
+	this->mCGBody[BODY_LEFT_HAND] = mCGHL.get();
+	this->mCGBody[BODY_RIGHT_HAND] = mCGHR.get();
 
 	int num_body_nodes = mInterestedDof / 3;
 	int dof = this->mCharacter->GetSkeleton()->getNumDofs(); 
@@ -79,7 +117,15 @@ Controller::Controller(ReferenceManager* ref, bool adaptive, bool parametric, bo
 	mEndEffectors.push_back("LeftHand");
 	mEndEffectors.push_back("RightHand");
 	mEndEffectors.push_back("Head");
+	for(int i = 0; i < mEndEffectors.size(); i++)
+		mEndEffectorBodies.push_back(mCharacter->GetSkeleton()->getBodyNode(mEndEffectors[i]));
 
+	std::vector<std::string> contact;
+	contact.push_back("RightFoot");
+	contact.push_back("RightToe");
+	contact.push_back("LeftFoot");
+	contact.push_back("LeftToe");
+	this->mStateLayout = new StateLayout(mCharacter->GetSkeleton(), mEndEffectors, contact, isParametric, mParamGoal.rows());
 
 	this->mTargetPositions = Eigen::VectorXd::Zero(dof);
 	this->mTargetVelocities = Eigen::VectorXd::Zero(dof);
@@ -123,8 +169,7 @@ Step()
 {			
 	if(IsTerminalState())
 		return;
-
-	Eigen::VectorXd s = this->GetState();
+	mResetState = nullptr;
 
 	Eigen::VectorXd a = mActions;
 
@@ -155,21 +200,24 @@ Step()
 	// if(mRecord)
 	// 	std::cout << mCurrentFrameOnPhase << " "<< mAdaptiveStep << " "<< mReferenceManager->GetTimeStep(mPrevFrameOnPhase, true) << std::endl;
 	
-	Motion* p_v_target = mReferenceManager->GetMotion(mCurrentFrame, isAdaptive);
-	this->mTargetPositions = p_v_target->GetPosition();
-	this->mTargetVelocities = mCharacter->GetSkeleton()->getPositionDifferences(mTargetPositions, mPrevTargetPositions) / 0.033 * (mCurrentFrame - mPrevFrame);
-	delete p_v_target;
-
-	p_v_target = mReferenceManager->GetMotion(mCurrentFrame, false);
-	this->mPDTargetPositions = p_v_target->GetPosition();
-	this->mPDTargetVelocities = p_v_target->GetVelocity();
-	delete p_v_target;
+	{
+		ProfileScope scope(mProfile, PROFILE_MOTION);
+		Motion* p_v_target = mReferenceManager->GetMotion(mCurrentFrame, isAdaptive);
+		this->mTargetPositions = p_v_target->GetPosition();
+		this->mTargetVelocities = mCharacter->GetSkeleton()->getPositionDifferences(mTargetPositions, mPrevTargetPositions) / 0.033 * (mCurrentFrame - mPrevFrame);
+		delete p_v_target;
+
+		p_v_target = mReferenceManager->GetMotion(mCurrentFrame, false);
+		this->mPDTargetPositions = p_v_target->GetPosition();
+		this->mPDTargetVelocities = p_v_target->GetVelocity();
+		delete p_v_target;
+	}
 
 	int count_dof = 0;
 
 	for(int i = 1; i <= num_body_nodes; i++){
-		int idx = mCharacter->GetSkeleton()->getBodyNode(i)->getParentJoint()->getIndexInSkeleton(0);
-		int dof = mCharacter->GetSkeleton()->getBodyNode(i)->getParentJoint()->getNumDofs();
+		int idx = mHandles->GetDofIndex(i);
+		int dof = mHandles->GetNumDofs(i);
 		mPDTargetPositions.block(idx, 0, dof, 1) += mActions.block(count_dof, 0, dof, 1);
 		count_dof += dof;
 
@@ -181,36 +229,44 @@ Step()
 	Eigen::Vector3d d = Eigen::Vector3d(0, 0, 1);
 	double end_f_sum = 0;	
 	
-	for(int i = 0; i < this->mSimPerCon; i += 2){
-
-		for(int j = 0; j < 2; j++) {
-			mCharacter->GetSkeleton()->setSPDTarget(mPDTargetPositions, 600, 49);
-			//Eigen::VectorXd torque = mCharacter->GetSkeleton()->getSPDForces(mPDTargetPositions, 600, 49, mWorld->getConstraintSolver());
-			// for(int j = 0; j < num_body_nodes; j++) {
-			// 	int idx = mCharacter->GetSkeleton()->getBodyNode(j)->getParentJoint()->getIndexInSkeleton(0);
-			// 	int dof = mCharacter->GetSkeleton()->getBodyNode(j)->getParentJoint()->getNumDofs();
-			// 	std::string name = mCharacter->GetSkeleton()->getBodyNode(j)->getName();
-			// 	double torquelim = mCharacter->GetTorqueLimit(name) * 1.5;
-			// 	double torque_norm = torque.block(idx, 0, dof, 1).norm();
+	{
+		ProfileScope scope(mProfile, PROFILE_SIMULATION);
+		// the factor is never carried over from the previous control step
+		if(mFactorizedSPD)
+			mCharacter->InvalidateSPDFactor();
+		for(int i = 0; i < this->mSimPerCon; i += 2){
+
+			for(int j = 0; j < 2; j++) {
+				if(mFactorizedSPD)
+					mCharacter->GetSkeleton()->setForces(mCharacter->GetFactorizedSPDForces(mPDTargetPositions, Eigen::VectorXd::Zero(dof)));
+				else
+					mCharacter->GetSkeleton()->setSPDTarget(mPDTargetPositions, 600, 49);
+				//Eigen::VectorXd torque = mCharacter->GetSkeleton()->getSPDForces(mPDTargetPositions, 600, 49, mWorld->getConstraintSolver());
+				// for(int j = 0; j < num_body_nodes; j++) {
+				// 	int idx = mCharacter->GetSkeleton()->getBodyNode(j)->getParentJoint()->getIndexInSkeleton(0);
+				// 	int dof = mCharacter->GetSkeleton()->getBodyNode(j)->getParentJoint()->getNumDofs();
+				// 	std::string name = mCharacter->GetSkeleton()->getBodyNode(j)->getName();
+				// 	double torquelim = mCharacter->GetTorqueLimit(name) * 1.5;
+				// 	double torque_norm = torque.block(idx, 0, dof, 1).norm();
 			
-			// 	torque.block(idx, 0, dof, 1) = std::max(-torquelim, std::min(torquelim, torque_norm)) * torque.block(idx, 0, dof, 1).normalized();
-			// }
+				// 	torque.block(idx, 0, dof, 1) = std::max(-torquelim, std::min(torquelim, torque_norm)) * torque.block(idx, 0, dof, 1).normalized();
+				// }
 
-			//mCharacter->GetSkeleton()->setForces(torque);
-			mWorld->step(false);
-			//mSumTorque += torque.cwiseAbs();
+				//mCharacter->GetSkeleton()->setForces(torque);
+				mWorld->step(false);
+				mStepCollision = true;
+				//mSumTorque += torque.cwiseAbs();
 
-		}
-		if(mCurrentFrameOnPhase >= 18 && mControlFlag[0] == 0) {
-			Eigen::Vector3d c_vel = mCharacter->GetSkeleton()->getCOMLinearVelocity();
-			double rf = mCharacter->GetSkeleton()->getBodyNode("LeftFoot")->getWorldTransform().translation()(1);
-			double lf = mCharacter->GetSkeleton()->getBodyNode("RightFoot")->getWorldTransform().translation()(1);
-			if(mVelocity < c_vel(1)) {
-				mVelocity = c_vel(1);
-				mMomentum = mCharacter->GetSkeleton()->getMass() * c_vel;
 			}
+			if(mCurrentFrameOnPhase >= 18 && mControlFlag[0] == 0) {
+				Eigen::Vector3d c_vel = mCharacter->GetSkeleton()->getCOMLinearVelocity();
+				if(mVelocity < c_vel(1)) {
+					mVelocity = c_vel(1);
+					mMomentum = mCharacter->GetSkeleton()->getMass() * c_vel;
+				}
+			}
+			mTimeElapsed += 2 * mAdaptiveStep;
 		}
-		mTimeElapsed += 2 * mAdaptiveStep;
 	}
 	if(this->mCurrentFrameOnPhase > mReferenceManager->GetPhaseLength()){
 		this->mCurrentFrameOnPhase -= mReferenceManager->GetPhaseLength();
@@ -224,7 +280,10 @@ Step()
 			mFitness.sum_vel_threshold /= mCountTracking;
 			mFitness.sum_slide /= mCountSlide;
 
-			mReferenceManager->SaveTrajectories(data_raw, std::tuple<double, double, Fitness>(mTrackingRewardTrajectory, mParamRewardTrajectory, mFitness), mParamCur);
+			{
+				ProfileScope scope(mProfile, PROFILE_TRAJECTORY);
+				mReferenceManager->SaveTrajectories(data_raw, std::tuple<double, double, Fitness>(mTrackingRewardTrajectory, mParamRewardTrajectory, mFitness), mParamCur);
+			}
 			data_raw.clear();
 
 			mFitness.sum_contact = 0;
@@ -254,15 +313,20 @@ Step()
 			mParamRewardMax = 0;
 		}
 	}
-	if(isAdaptive) {
-		this->UpdateAdaptiveReward();
+	{
+		ProfileScope scope(mProfile, PROFILE_REWARD);
+		if(isAdaptive) {
+			this->UpdateAdaptiveReward();
+		}
+		else
+			this->UpdateReward();
+	}
+	{
+		ProfileScope scope(mProfile, PROFILE_TERMINAL);
+		this->UpdateTerminalInfo();
 	}
-	else
-		this->UpdateReward();
-
-	this->UpdateTerminalInfo();
 
-	if(mRecord) {
+	if(mRecord || mRecorder != nullptr) {
 		SaveStepInfo();
 	}
 
@@ -290,6 +354,27 @@ void
 Controller::
 SaveStepInfo() 
 {
+	if(mRecorder != nullptr) {
+		auto& skel = mCharacter->GetSkeleton();
+		int contact = 0;
+		if(mStepCollision) {
+			// contacts of the last world step, no extra collision queries
+			const dart::collision::CollisionResult& result = mWorld->getLastCollisionResult();
+			if(result.inCollision(mHandles->GetBody(BODY_RIGHT_FOOT)) || result.inCollision(mHandles->GetBody(BODY_RIGHT_TOE)))
+				contact |= RECORD_CONTACT_RIGHT;
+			if(result.inCollision(mHandles->GetBody(BODY_LEFT_FOOT)) || result.inCollision(mHandles->GetBody(BODY_LEFT_TOE)))
+				contact |= RECORD_CONTACT_LEFT;
+		} else {
+			// no step since the pose was set, the last result belongs to another pose
+			if(CheckCollisionWithGround(BODY_RIGHT_FOOT) || CheckCollisionWithGround(BODY_RIGHT_TOE))
+				contact |= RECORD_CONTACT_RIGHT;
+			if(CheckCollisionWithGround(BODY_LEFT_FOOT) || CheckCollisionWithGround(BODY_LEFT_TOE))
+				contact |= RECORD_CONTACT_LEFT;
+		}
+		mRecorder->Record(mCurrentFrame, contact, skel->getCOM(), skel->getPositions(), skel->getVelocities(),
+						  mTargetPositions, mReferenceManager->GetPosition(mCurrentFrame, false));
+		return;
+	}
 	mRecordBVHPosition.push_back(mReferenceManager->GetPosition(mCurrentFrame, false));
 	mRecordTargetPosition.push_back(mTargetPositions);
 	mRecordPosition.push_back(mCharacter->GetSkeleton()->getPositions());
@@ -297,11 +382,34 @@ SaveStepInfo()
 	mRecordCOM.push_back(mCharacter->GetSkeleton()->getCOM());
 	mRecordPhase.push_back(mCurrentFrame);
 
-	bool rightContact = CheckCollisionWithGround("RightFoot") || CheckCollisionWithGround("RightToe");
-	bool leftContact = CheckCollisionWithGround("LeftFoot") || CheckCollisionWithGround("LeftToe");
+	bool rightContact = CheckCollisionWithGround(BODY_RIGHT_FOOT) || CheckCollisionWithGround(BODY_RIGHT_TOE);
+	bool leftContact = CheckCollisionWithGround(BODY_LEFT_FOOT) || CheckCollisionWithGround(BODY_LEFT_TOE);
 
 	mRecordFootContact.push_back(std::make_pair(rightContact, leftContact));
 }
+bool
+Controller::
+OpenRecordFile(std::string path)
+{
+	if(mRecorder == nullptr)
+		mRecorder = new RolloutRecorder(mCharacter->GetSkeleton()->getNumDofs());
+	if(!mRecorder->Open(path)) {
+		delete mRecorder;
+		mRecorder = nullptr;
+		return false;
+	}
+	return true;
+}
+void
+Controller::
+CloseRecordFile()
+{
+	if(mRecorder == nullptr)
+		return;
+	mRecorder->Close();
+	delete mRecorder;
+	mRecorder = nullptr;
+}
 void 
 Controller::
 ClearRecord() 
@@ -373,7 +481,7 @@ GetTrackingReward(Eigen::VectorXd position, Eigen::VectorXd position2,
 	Eigen::VectorXd ee_diff(mEndEffectors.size()*3);
 	ee_diff.setZero();	
 	for(int i=0;i<mEndEffectors.size(); i++){
-		ee_transforms.push_back(skel->getBodyNode(mEndEffectors[i])->getWorldTransform());
+		ee_transforms.push_back(mEndEffectorBodies[i]->getWorldTransform());
 	}
 	
 	Eigen::Vector3d com_diff = skel->getCOM();
@@ -382,7 +490,7 @@ GetTrackingReward(Eigen::VectorXd position, Eigen::VectorXd position2,
 	skel->computeForwardKinematics(true,false,false);
 
 	for(int i=0;i<mEndEffectors.size();i++){
-		Eigen::Isometry3d diff = ee_transforms[i].inverse() * skel->getBodyNode(mEndEffectors[i])->getWorldTransform();
+		Eigen::Isometry3d diff = ee_transforms[i].inverse() * mEndEffectorBodies[i]->getWorldTransform();
 		ee_diff.segment<3>(3*i) = diff.translation();
 	}
 	com_diff -= skel->getCOM();
@@ -433,16 +541,12 @@ GetContactInfo(Eigen::VectorXd pos)
 	skel->setPositions(pos);
 	skel->computeForwardKinematics(true,false,false);
 
-	std::vector<std::string> contact;
-	contact.push_back("RightFoot");
-	contact.push_back("RightToe");
-	contact.push_back("LeftFoot");
-	contact.push_back("LeftToe");
+	const BodyHandle contact[4] = {BODY_RIGHT_FOOT, BODY_RIGHT_TOE, BODY_LEFT_FOOT, BODY_LEFT_TOE};
 
 	std::vector<std::pair<bool, Eigen::Vector3d>> result;
-	result.clear();
-	for(int i = 0; i < contact.size(); i++) {
-		Eigen::Vector3d p = skel->getBodyNode(contact[i])->getWorldTransform().translation();
+	result.reserve(4);
+	for(int i = 0; i < 4; i++) {
+		Eigen::Vector3d p = mHandles->GetBody(contact[i])->getWorldTransform().translation();
 		if(p[1] < 0.07) {
 			result.push_back(std::pair<bool, Eigen::Vector3d>(true, p));
 		} else {
@@ -491,56 +595,37 @@ GetSimilarityReward()
 	p_with_zero = Align(p_with_zero, mReferenceManager->GetPosition(0, false));
 	p_aligned.segment<6>(0) = p_with_zero[1];
 
-	Eigen::VectorXd v = skel->getPositionDifferences(skel->getPositions(), mPosQueue.front()) / (mCurrentFrame - mTimeQueue.front() + 1e-10) / 0.033;
+	PositionDifference* pd = mCharacter->GetPositionDifference();
+	Eigen::VectorXd v = pd->Compute(skel->getPositions(), mPosQueue.front()) / (mCurrentFrame - mTimeQueue.front() + 1e-10) / 0.033;
 
-	for(auto& jn : skel->getJoints()){
-		if(dynamic_cast<dart::dynamics::RevoluteJoint*>(jn)!=nullptr){
-			double v_ = v[jn->getIndexInSkeleton(0)];
-			if(v_ > M_PI){
-				v_ -= 2*M_PI;
-			}
-			else if(v_ < -M_PI){
-				v_ += 2*M_PI;
-			}
-			v[jn->getIndexInSkeleton(0)] = v_;
-		}
-	}
-
-	Eigen::VectorXd p_diff = skel->getPositionDifferences(pos, p_aligned);
+	Eigen::VectorXd p_diff = pd->Compute(pos, p_aligned);
 	Eigen::VectorXd p_diff_th = p_diff;
 
 	Eigen::VectorXd v_diff = skel->getVelocityDifferences(vel, v);
 
-	int num_body_nodes = skel->getNumBodyNodes();
 	for(int i =0 ; i < vel.rows(); i++) {
 		v_diff(i) = v_diff(i) / std::max(0.5, vel(i));
 	}
 	Eigen::VectorXd v_diff_th = v_diff;
 
-	for(int i = 0; i < num_body_nodes; i++) {
-		std::string name = mCharacter->GetSkeleton()->getBodyNode(i)->getName();
-		int idx = mCharacter->GetSkeleton()->getBodyNode(i)->getParentJoint()->getIndexInSkeleton(0);
+	int idx = mHandles->GetDofIndex(BODY_HIPS);
+	p_diff.segment<3>(idx) *= 3;
+	p_diff.segment<3>(idx + 3) *= 5;
 
-		if(name.compare("Hips") == 0 ) {
-			p_diff.segment<3>(idx) *= 3;
-			p_diff.segment<3>(idx + 3) *= 5;
+	p_diff_th.segment<3>(idx) *= 3;
+	p_diff_th.segment<3>(idx + 3) *= 5;
 
-			p_diff_th.segment<3>(idx) *= 3;
-			p_diff_th.segment<3>(idx + 3) *= 5;
-
-			v_diff.segment<3>(idx + 3) *= 5;
-			v_diff_th.segment<3>(idx + 3) *= 5;
-		}
-	}
+	v_diff.segment<3>(idx + 3) *= 5;
+	v_diff_th.segment<3>(idx + 3) *= 5;
 
 	double footSlide = 0;
 	if(mCurrentFrameOnPhase >= 41){
-		Eigen::Vector3d lf = skel->getBodyNode("LeftFoot")->getWorldTransform().translation();
-		lf += skel->getBodyNode("LeftToe")->getWorldTransform().translation();
+		Eigen::Vector3d lf = mHandles->GetBody(BODY_LEFT_FOOT)->getWorldTransform().translation();
+		lf += mHandles->GetBody(BODY_LEFT_TOE)->getWorldTransform().translation();
 		lf /= 2.0;
 
-		Eigen::Vector3d rf = skel->getBodyNode("RightFoot")->getWorldTransform().translation();
-		rf += skel->getBodyNode("RightToe")->getWorldTransform().translation();
+		Eigen::Vector3d rf = mHandles->GetBody(BODY_RIGHT_FOOT)->getWorldTransform().translation();
+		rf += mHandles->GetBody(BODY_RIGHT_TOE)->getWorldTransform().translation();
 		rf /= 2.0;
 		
 		Eigen::VectorXd foot_diff (6);
@@ -552,12 +637,12 @@ GetSimilarityReward()
 		mCountSlide += 1;
 	
 	} else if(mCurrentFrameOnPhase >= 35) {
-		Eigen::Vector3d lf = skel->getBodyNode("LeftFoot")->getWorldTransform().translation();
-		lf += skel->getBodyNode("LeftToe")->getWorldTransform().translation();
+		Eigen::Vector3d lf = mHandles->GetBody(BODY_LEFT_FOOT)->getWorldTransform().translation();
+		lf += mHandles->GetBody(BODY_LEFT_TOE)->getWorldTransform().translation();
 		lf /= 2.0;
 
-		Eigen::Vector3d rf = skel->getBodyNode("RightFoot")->getWorldTransform().translation();
-		rf += skel->getBodyNode("RightToe")->getWorldTransform().translation();
+		Eigen::Vector3d rf = mHandles->GetBody(BODY_RIGHT_FOOT)->getWorldTransform().translation();
+		rf += mHandles->GetBody(BODY_RIGHT_TOE)->getWorldTransform().translation();
 		rf /= 2.0;
 
 		stickRightFoot = rf;
@@ -797,6 +882,8 @@ FollowBvh()
 {	
 	if(IsTerminalState())
 		return false;
+	mResetState = nullptr;
+	mStepCollision = false;
 	auto& skel = mCharacter->GetSkeleton();
 
 	Motion* p_v_target = mReferenceManager->GetMotion(mCurrentFrame);
@@ -821,8 +908,44 @@ SetGoalParameters(Eigen::VectorXd tp)
 	mParamGoal = tp;
 	this->mWorld->setGravity(exp(mParamGoal(0))*mBaseGravity);
 	// this->SetSkeletonWeight(mParamGoal(1)*mBaseMass);
+	if(isParametric)
+		this->ClearInitialStates();
 }
 
+void
+Controller::
+SetCollisionFiltering(bool on)
+{
+	dart::collision::CollisionOption& option = mWorld->getConstraintSolver()->getCollisionOption();
+	if(on)
+		option.collisionFilter = mCompositeCollisionFilter;
+	else
+		option.collisionFilter = mDefaultCollisionFilter;
+}
+void
+Controller::
+SetWarmStartContacts(bool on)
+{
+	auto solver = dynamic_cast<dart::constraint::BoxedLcpConstraintSolver*>(mWorld->getConstraintSolver());
+	if(on)
+		solver->setBoxedLcpSolver(mContactSolver);
+	else
+		solver->setBoxedLcpSolver(std::make_shared<dart::constraint::PgsBoxedLcpSolver>());
+	mContactSolver->Clear();
+}
+void
+Controller::
+SetFactorizedSPD(bool on, int refactor_interval)
+{
+	// same gains as the skeleton's SPD target
+	int dof = mCharacter->GetSkeleton()->getNumDofs();
+	if(on)
+		mCharacter->SetPDParameters(600, 49);
+	else
+		mCharacter->SetPDParameters(Eigen::VectorXd::Zero(dof), Eigen::VectorXd::Zero(dof));
+	mCharacter->SetSPDRefactorInterval(refactor_interval);
+	mFactorizedSPD = on;
+}
 void
 Controller::
 SetSkeletonWeight(double mass)
@@ -839,12 +962,15 @@ SetSkeletonWeight(double mass)
 	}
 	DPhy::SkeletonBuilder::DeformSkeleton(mCharacter->GetSkeleton(), deform);
 	mMass = mCharacter->GetSkeleton()->getMass();
+	this->ClearInitialStates();
 }
 void 
 Controller::
 Reset(bool RSI)
 {
 	this->mWorld->reset();
+	this->mStepCollision = false;
+	this->mContactSolver->Clear();
 	auto& skel = mCharacter->GetSkeleton();
 	skel->clearConstraintImpulses();
 	skel->clearInternalForces();
@@ -872,26 +998,37 @@ Reset(bool RSI)
 	this->mStartFrame = this->mCurrentFrame;
 	this->nTotalSteps = 0;
 	this->mTimeElapsed = 0;
+	this->mAdaptiveStep = 1;
 
-	Motion* p_v_target;
-	p_v_target = mReferenceManager->GetMotion(mCurrentFrame, isAdaptive);
-	this->mTargetPositions = p_v_target->GetPosition();
-	this->mTargetVelocities = p_v_target->GetVelocity();
-	delete p_v_target;
+	this->mIsNanAtTerminal = false;
+	this->mIsTerminal = false;
+
+	InitialState* init = this->GetInitialState(mCurrentFrame);
+	this->mTargetPositions = init->positions;
+	this->mTargetVelocities = init->velocities;
 
 	this->mPDTargetPositions = mTargetPositions;
 	this->mPDTargetVelocities = mTargetVelocities;
-	int num_body_nodes = skel->getNumBodyNodes();
 
 	skel->setPositions(mTargetPositions);
 	skel->setVelocities(mTargetVelocities);
 	skel->computeForwardKinematics(true,true,false);
-
-	this->mIsNanAtTerminal = false;
-	this->mIsTerminal = false;
 	
 	ClearRecord();
-	SaveStepInfo();
+	if(mRecorder != nullptr) {
+		mRecorder->BeginEpisode();
+		SaveStepInfo();
+	} else {
+		// same entries as SaveStepInfo
+		mRecordBVHPosition.push_back(init->bvh_position);
+		mRecordTargetPosition.push_back(mTargetPositions);
+		mRecordPosition.push_back(init->positions);
+		mRecordVelocity.push_back(init->velocities);
+		mRecordCOM.push_back(init->com);
+		mRecordPhase.push_back(mCurrentFrame);
+		mRecordFootContact.push_back(init->foot_contact);
+	}
+	mResetState = &init->state;
 
 	mRootZero = mCharacter->GetSkeleton()->getPositions().segment<6>(0);
 	
@@ -903,13 +1040,210 @@ Reset(bool RSI)
 	
 	mPosQueue.push(mCharacter->GetSkeleton()->getPositions());
 	mTimeQueue.push(0);
-	mAdaptiveStep = 1;
 	if(isAdaptive)
 	{
 		data_raw.push_back(std::pair<Eigen::VectorXd,double>(mCharacter->GetSkeleton()->getPositions(), mCurrentFrame));
 	}
 
 }
+InitialState*
+Controller::
+GetInitialState(double frame)
+{
+	int version = mReferenceManager->GetMotionVersion();
+	if(version != mInitialStateVersion) {
+		mInitialStates.clear();
+		mInitialStates.resize(mReferenceManager->GetPhaseLength());
+		for(int i = 0; i < mInitialStates.size(); i++)
+			mInitialStates[i].valid = false;
+		mInitialStateVersion = version;
+	}
+	// RSI frames are integers on the first phase, anything else is built without being kept
+	InitialState* init = &mScratchInitialState;
+	int k = (int) frame;
+	if(k == frame && k >= 0 && k < mInitialStates.size()) {
+		init = &mInitialStates[k];
+		if(init->valid)
+			return init;
+	}
+
+	Motion* p_v_target = mReferenceManager->GetMotion(frame, isAdaptive);
+	init->positions = p_v_target->GetPosition();
+	init->velocities = p_v_target->GetVelocity();
+	delete p_v_target;
+	init->bvh_position = mReferenceManager->GetPosition(frame, false);
+
+	// the caller sets the frame counters, the adaptive step and the terminal flags of a reset before this
+	auto& skel = mCharacter->GetSkeleton();
+	skel->setPositions(init->positions);
+	skel->setVelocities(init->velocities);
+	skel->computeForwardKinematics(true,true,false);
+	init->com = skel->getCOM();
+
+	bool rightContact = CheckCollisionWithGround(BODY_RIGHT_FOOT) || CheckCollisionWithGround(BODY_RIGHT_TOE);
+	bool leftContact = CheckCollisionWithGround(BODY_LEFT_FOOT) || CheckCollisionWithGround(BODY_LEFT_TOE);
+	init->foot_contact = std::make_pair(rightContact, leftContact);
+
+	mResetState = nullptr;
+	init->state.resize(mStateLayout->GetSize());
+	this->WriteState(init->state.data());
+	init->valid = (init != &mScratchInitialState);
+	return init;
+}
+void
+Controller::
+ClearInitialStates()
+{
+	mInitialStates.clear();
+	mInitialStateVersion = -1;
+	mResetState = nullptr;
+}
+void
+Controller::
+SaveState(ControllerState& state)
+{
+	auto& skel = mCharacter->GetSkeleton();
+	state.positions = skel->getPositions();
+	state.velocities = skel->getVelocities();
+	state.time = mWorld->getTime();
+	std::vector<double> others;
+	mContactSolver->GetCache(state.contacts, others);
+	state.constraint_others = others;
+
+	state.start_frame = mStartFrame;
+	state.current_frame = mCurrentFrame;
+	state.current_frame_on_phase = mCurrentFrameOnPhase;
+	state.prev_frame_on_phase = mPrevFrameOnPhase;
+	state.prev_frame = mPrevFrame;
+	state.prev_frame2 = mPrevFrame2;
+	state.time_elapsed = mTimeElapsed;
+	state.adaptive_step = mAdaptiveStep;
+	state.total_steps = nTotalSteps;
+
+	state.target_positions = mTargetPositions;
+	state.target_velocities = mTargetVelocities;
+	state.pd_target_positions = mPDTargetPositions;
+	state.pd_target_velocities = mPDTargetVelocities;
+	state.actions = mActions;
+	state.prev_positions = mPrevPositions;
+	state.prev_target_positions = mPrevTargetPositions;
+	state.root_zero = mRootZero;
+	state.pos_queue = mPosQueue;
+	state.time_queue = mTimeQueue;
+
+	state.reward_parts = mRewardParts;
+	state.param_reward_trajectory = mParamRewardTrajectory;
+	state.tracking_reward_trajectory = mTrackingRewardTrajectory;
+	state.fitness = mFitness;
+	state.count_param = mCountParam;
+	state.count_tracking = mCountTracking;
+	state.count_slide = mCountSlide;
+	state.control_flag = mControlFlag;
+	state.param_cur = mParamCur;
+	state.param_goal = mParamGoal;
+	state.data_raw = data_raw;
+	state.sum_torque = mSumTorque;
+	state.stick_left_foot = stickLeftFoot;
+	state.stick_right_foot = stickRightFoot;
+	state.velocity = mVelocity;
+	state.momentum = mMomentum;
+	state.condiff = mCondiff;
+	state.count_contact = mCountContact;
+	state.max_com = mMaxCOM;
+	state.prev_lf = mPrevLF;
+	state.prev_rf = mPrevRF;
+	state.prev_lf_bvh = mPrevLF_bvh;
+	state.prev_rf_bvh = mPrevRF_bvh;
+	state.prev_height = mPrevHeight;
+	state.param_reward_max = mParamRewardMax;
+
+	state.is_terminal = mIsTerminal;
+	state.is_nan_at_terminal = mIsNanAtTerminal;
+	state.termination_reason = terminationReason;
+}
+void
+Controller::
+RestoreState(const ControllerState& state)
+{
+	// the branch is a new episode for the record, cleared first since this also resets accumulators
+	ClearRecord();
+	if(mRecorder != nullptr)
+		mRecorder->BeginEpisode();
+	mResetState = nullptr;
+	mStepCollision = false;
+
+	auto& skel = mCharacter->GetSkeleton();
+	skel->clearConstraintImpulses();
+	skel->clearInternalForces();
+	skel->clearExternalForces();
+	skel->setPositions(state.positions);
+	skel->setVelocities(state.velocities);
+	skel->computeForwardKinematics(true,true,false);
+	mWorld->setTime(state.time);
+	mContactSolver->SetCache(state.contacts, state.constraint_others);
+	mCharacter->InvalidateSPDFactor();
+
+	mStartFrame = state.start_frame;
+	mCurrentFrame = state.current_frame;
+	mCurrentFrameOnPhase = state.current_frame_on_phase;
+	mPrevFrameOnPhase = state.prev_frame_on_phase;
+	mPrevFrame = state.prev_frame;
+	mPrevFrame2 = state.prev_frame2;
+	mTimeElapsed = state.time_elapsed;
+	mAdaptiveStep = state.adaptive_step;
+	nTotalSteps = state.total_steps;
+
+	mTargetPositions = state.target_positions;
+	mTargetVelocities = state.target_velocities;
+	mPDTargetPositions = state.pd_target_positions;
+	mPDTargetVelocities = state.pd_target_velocities;
+	mActions = state.actions;
+	mPrevPositions = state.prev_positions;
+	mPrevTargetPositions = state.prev_target_positions;
+	mRootZero = state.root_zero;
+	mPosQueue = state.pos_queue;
+	mTimeQueue = state.time_queue;
+
+	mRewardParts = state.reward_parts;
+	mParamRewardTrajectory = state.param_reward_trajectory;
+	mTrackingRewardTrajectory = state.tracking_reward_trajectory;
+	mFitness = state.fitness;
+	mCountParam = state.count_param;
+	mCountTracking = state.count_tracking;
+	mCountSlide = state.count_slide;
+	mControlFlag = state.control_flag;
+	mParamCur = state.param_cur;
+	bool goal_changed = mParamGoal.rows() != state.param_goal.rows() || mParamGoal != state.param_goal;
+	mParamGoal = state.param_goal;
+	// the gravity follows the goal as in SetGoalParameters, also when the goal is unchanged since this controller
+	// may never have applied it; the initial states only depend on the goal
+	if(mParamGoal.rows() != 0)
+		this->mWorld->setGravity(exp(mParamGoal(0))*mBaseGravity);
+	if(isParametric && goal_changed)
+		this->ClearInitialStates();
+	data_raw = state.data_raw;
+	mSumTorque = state.sum_torque;
+	stickLeftFoot = state.stick_left_foot;
+	stickRightFoot = state.stick_right_foot;
+	mVelocity = state.velocity;
+	mMomentum = state.momentum;
+	mCondiff = state.condiff;
+	mCountContact = state.count_contact;
+	mMaxCOM = state.max_com;
+	mPrevLF = state.prev_lf;
+	mPrevRF = state.prev_rf;
+	mPrevLF_bvh = state.prev_lf_bvh;
+	mPrevRF_bvh = state.prev_rf_bvh;
+	mPrevHeight = state.prev_height;
+	mParamRewardMax = state.param_reward_max;
+
+	mIsTerminal = state.is_terminal;
+	mIsNanAtTerminal = state.is_nan_at_terminal;
+	terminationReason = state.termination_reason;
+
+	if(mRecord || mRecorder != nullptr)
+		SaveStepInfo();
+}
 int
 Controller::
 GetNumState()
@@ -931,12 +1265,10 @@ SetAction(const Eigen::VectorXd& action)
 Eigen::VectorXd 
 Controller::
 GetEndEffectorStatePosAndVel(const Eigen::VectorXd pos, const Eigen::VectorXd vel) {
-	Eigen::VectorXd ret;
+	Eigen::VectorXd ret(mStateLayout->GetEndEffectorStateSize());
 	auto& skel = mCharacter->GetSkeleton();
-	dart::dynamics::BodyNode* root = skel->getRootBodyNode();
-	Eigen::Isometry3d cur_root_inv = root->getWorldTransform().inverse();
+	Eigen::Isometry3d cur_root_inv = skel->getRootBodyNode()->getWorldTransform().inverse();
 
-	int num_ee = mEndEffectors.size();
 	Eigen::VectorXd p_save = skel->getPositions();
 	Eigen::VectorXd v_save = skel->getVelocities();
 
@@ -944,41 +1276,7 @@ GetEndEffectorStatePosAndVel(const Eigen::VectorXd pos, const Eigen::VectorXd ve
 	skel->setVelocities(vel);
 	skel->computeForwardKinematics(true, true, false);
 
-	ret.resize((num_ee)*12+15);
-//	ret.resize((num_ee)*9+12);
-
-	for(int i=0;i<num_ee;i++)
-	{		
-		Eigen::Isometry3d transform = cur_root_inv * skel->getBodyNode(mEndEffectors[i])->getWorldTransform();
-		//Eigen::Quaterniond q(transform.linear());
-		// Eigen::Vector3d rot = QuaternionToDARTPosition(Eigen::Quaterniond(transform.linear()));
-		ret.segment<9>(9*i) << transform.linear()(0,0), transform.linear()(0,1), transform.linear()(0,2),
-							   transform.linear()(1,0), transform.linear()(1,1), transform.linear()(1,2), 
-							   transform.translation();
-//		ret.segment<6>(6*i) << rot, transform.translation();
-	}
-
-
-	for(int i=0;i<num_ee;i++)
-	{
-	    int idx = skel->getBodyNode(mEndEffectors[i])->getParentJoint()->getIndexInSkeleton(0);
-		ret.segment<3>(9*num_ee + 3*i) << vel.segment<3>(idx);
-//	    ret.segment<3>(6*num_ee + 3*i) << vel.segment<3>(idx);
-
-	}
-
-	// root diff with target com
-	Eigen::Isometry3d transform = cur_root_inv * skel->getRootBodyNode()->getWorldTransform();
-	//Eigen::Quaterniond q(transform.linear());
-
-	Eigen::Vector3d rot = QuaternionToDARTPosition(Eigen::Quaterniond(transform.linear()));
-	Eigen::Vector3d root_angular_vel_relative = cur_root_inv.linear() * skel->getRootBodyNode()->getAngularVelocity();
-	Eigen::Vector3d root_linear_vel_relative = cur_root_inv.linear() * skel->getRootBodyNode()->getCOMLinearVelocity();
-
-	ret.tail<15>() << transform.linear()(0,0), transform.linear()(0,1), transform.linear()(0,2),
-					  transform.linear()(1,0), transform.linear()(1,1), transform.linear()(1,2),
-					  transform.translation(), root_angular_vel_relative, root_linear_vel_relative;
-//	ret.tail<12>() << rot, transform.translation(), root_angular_vel_relative, root_linear_vel_relative;
+	mStateLayout->WriteEndEffectorState(cur_root_inv, vel, ret.data());
 
 	// restore
 	skel->setPositions(p_save);
@@ -990,113 +1288,78 @@ GetEndEffectorStatePosAndVel(const Eigen::VectorXd pos, const Eigen::VectorXd ve
 bool
 Controller::
 CheckCollisionWithGround(std::string bodyName){
-	auto collisionEngine = mWorld->getConstraintSolver()->getCollisionDetector();
-	dart::collision::CollisionOption option;
-	dart::collision::CollisionResult result;
-	if(bodyName == "RightFoot"){
-		bool isCollide = collisionEngine->collide(this->mCGR.get(), this->mCGG.get(), option, &result);
-		return isCollide;
-	}
-	else if(bodyName == "LeftFoot"){
-		bool isCollide = collisionEngine->collide(this->mCGL.get(), this->mCGG.get(), option, &result);
-		return isCollide;
-	}
-	else if(bodyName == "RightToe"){
-		bool isCollide = collisionEngine->collide(this->mCGER.get(), this->mCGG.get(), option, &result);
-		return isCollide;
-	}
-	else if(bodyName == "LeftToe"){
-		bool isCollide = collisionEngine->collide(this->mCGEL.get(), this->mCGG.get(), option, &result);
-		return isCollide;
-	}
-	else if(bodyName == "RightHand"){
-		bool isCollide = collisionEngine->collide(this->mCGHR.get(), this->mCGG.get(), option, &result);
-		return isCollide;
-	}
-	else if(bodyName == "LeftHand"){
-		bool isCollide = collisionEngine->collide(this->mCGHL.get(), this->mCGG.get(), option, &result);
-		return isCollide;
-	}
-	else{ // error case
+	BodyHandle h = SkeletonHandles::FromName(bodyName);
+	if(h == NUM_BODY_HANDLES || mCGBody[h] == nullptr) { // error case
 		std::cout << "check collision : bad body name" << std::endl;
 		return false;
 	}
+	return CheckCollisionWithGround(h);
+}
+bool
+Controller::
+CheckCollisionWithGround(BodyHandle body){
+	auto collisionEngine = mWorld->getConstraintSolver()->getCollisionDetector();
+	dart::collision::CollisionOption option;
+	dart::collision::CollisionResult result;
+	return collisionEngine->collide(this->mCGBody[body], this->mCGG.get(), option, &result);
 }
 Eigen::VectorXd 
 Controller::
 GetState()
 {
+	Eigen::VectorXd state(mStateLayout->GetSize());
+	this->WriteState(state.data());
+	return state;
+}
+void
+Controller::
+WriteState(double* out)
+{
+	ProfileScope scope(mProfile, PROFILE_STATE);
+	StateLayout* layout = mStateLayout;
+	if(mResetState != nullptr) {
+		Eigen::Map<Eigen::VectorXd>(out, layout->GetSize()) = *mResetState;
+		return;
+	}
 	if(mIsTerminal && terminationReason != 8){
-		return Eigen::VectorXd::Zero(mNumState);
+		Eigen::Map<Eigen::VectorXd>(out, layout->GetSize()).setZero();
+		return;
 	}
 	auto& skel = mCharacter->GetSkeleton();
-	
-	double root_height = skel->getRootBodyNode()->getCOM()[1];
-
-	Eigen::VectorXd p_save = skel->getPositions();
-	Eigen::VectorXd v_save = skel->getVelocities();
-	Eigen::VectorXd p,v;
-	// p.resize(p_save.rows()-6);
-	// p = p_save.tail(p_save.rows()-6);
-
-	int n_bnodes = mCharacter->GetSkeleton()->getNumBodyNodes();
-	int num_p = (n_bnodes - 1) * 6;
-	p.resize(num_p);
-
-	for(int i = 1; i < n_bnodes; i++){
-		Eigen::Isometry3d transform = skel->getBodyNode(i)->getRelativeTransform();
-		// Eigen::Quaterniond q(transform.linear());
-		p.segment<6>(6*(i-1)) << transform.linear()(0,0), transform.linear()(0,1), transform.linear()(0,2),
-								 transform.linear()(1,0), transform.linear()(1,1), transform.linear()(1,2);
-	}
-
-	v = v_save;
-
 	dart::dynamics::BodyNode* root = skel->getRootBodyNode();
 	Eigen::Isometry3d cur_root_inv = root->getWorldTransform().inverse();
-	Eigen::VectorXd ee;
-	ee.resize(mEndEffectors.size()*3);
-	for(int i=0;i<mEndEffectors.size();i++)
-	{
-		Eigen::Isometry3d transform = cur_root_inv * skel->getBodyNode(mEndEffectors[i])->getWorldTransform();
-		ee.segment<3>(3*i) << transform.translation();
-	}
-	double t = mReferenceManager->GetTimeStep(mCurrentFrameOnPhase, isAdaptive);
 
-	Motion* p_v_target = mReferenceManager->GetMotion(mCurrentFrame+t, isAdaptive);
-	Eigen::VectorXd p_next = GetEndEffectorStatePosAndVel(p_v_target->GetPosition(), p_v_target->GetVelocity()*t);
-
-	delete p_v_target;
+	layout->WriteBodyRotations(out + layout->mOffsetRotation);
+	Eigen::Map<Eigen::VectorXd>(out + layout->mOffsetVelocity, skel->getNumDofs()) = skel->getVelocities();
 
 	Eigen::Vector3d up_vec = root->getTransform().linear()*Eigen::Vector3d::UnitY();
-	double up_vec_angle = atan2(std::sqrt(up_vec[0]*up_vec[0]+up_vec[2]*up_vec[2]),up_vec[1]);
-	double phase = ((int) mCurrentFrame % mReferenceManager->GetPhaseLength()) / (double) mReferenceManager->GetPhaseLength();
-	Eigen::VectorXd state;
-
-	double com_diff = 0;
-
-	std::vector<std::string> contact;
-	contact.push_back("RightFoot");
-	contact.push_back("RightToe");
-	contact.push_back("LeftFoot");
-	contact.push_back("LeftToe");
-
-	Eigen::Vector4d foot_height;
-	for(int i = 0; i < contact.size(); i++) {
-		Eigen::Vector3d p = skel->getBodyNode(contact[i])->getWorldTransform().translation();
-		foot_height[i] = p[1];
-	}
+	out[layout->mOffsetUpAngle] = atan2(std::sqrt(up_vec[0]*up_vec[0]+up_vec[2]*up_vec[2]),up_vec[1]);
+	out[layout->mOffsetRootHeight] = root->getCOM()[1];
 
+	layout->WriteEndEffectorPositions(cur_root_inv, out + layout->mOffsetEndEffector);
 	if(isParametric) {
-		state.resize(p.rows()+v.rows()+1+1+p_next.rows()+ee.rows()+2+mParamGoal.rows()+4);
-		state<< p, v, up_vec_angle, root_height, p_next, mAdaptiveStep, ee, mCurrentFrameOnPhase, mParamGoal, foot_height;
-	}
-	else {
-		state.resize(p.rows()+v.rows()+1+1+p_next.rows()+ee.rows()+2);
-		state<< p, v, up_vec_angle, root_height, p_next, mAdaptiveStep, ee, mCurrentFrameOnPhase;
+		Eigen::Map<Eigen::VectorXd>(out + layout->mOffsetParam, mParamGoal.rows()) = mParamGoal;
+		layout->WriteContactHeights(out + layout->mOffsetContact);
 	}
+	out[layout->mOffsetAdaptiveStep] = mAdaptiveStep;
+	out[layout->mOffsetPhase] = mCurrentFrameOnPhase;
 
-	return state;
+	// end effector state of the next reference pose, evaluated on the skeleton and then restored
+	double t = mReferenceManager->GetTimeStep(mCurrentFrameOnPhase, isAdaptive);
+	Motion* p_v_target = mReferenceManager->GetMotion(mCurrentFrame+t, isAdaptive);
+
+	Eigen::VectorXd p_save = skel->getPositions();
+	Eigen::VectorXd v_save = skel->getVelocities();
+	Eigen::VectorXd v_next = p_v_target->GetVelocity()*t;
+	skel->setPositions(p_v_target->GetPosition());
+	skel->setVelocities(v_next);
+	skel->computeForwardKinematics(true, true, false);
+	layout->WriteEndEffectorState(cur_root_inv, v_next, out + layout->mOffsetEndEffectorState);
+	skel->setPositions(p_save);
+	skel->setVelocities(v_save);
+	skel->computeForwardKinematics(true, true, false);
+
+	delete p_v_target;
 }
 void
 Controller::SaveTimeData(std::string directory) {
@@ -1116,33 +1379,6 @@ void
 Controller::SaveDisplayedData(std::string directory, bool normalized) {
 	std::string path = directory;
 	std::cout << "save results to" << path << std::endl;
-	std::vector<std::string> HIERARCHY = mReferenceManager->GetHierarchyStr();
-
-	std::ofstream ofs(path);
-	std::vector<std::string> bvh_order;
-	bvh_order.push_back("Hips");
-	bvh_order.push_back("Spine");
-	bvh_order.push_back("Spine1");
-	bvh_order.push_back("Spine2");
-	bvh_order.push_back("Neck");
-	bvh_order.push_back("Head");
-	bvh_order.push_back("LeftShoulder");
-	bvh_order.push_back("LeftArm");
-	bvh_order.push_back("LeftForeArm");
-	bvh_order.push_back("LeftHand");
-	bvh_order.push_back("RightShoulder");
-	bvh_order.push_back("RightArm");
-	bvh_order.push_back("RightForeArm");
-	bvh_order.push_back("RightHand");
-	bvh_order.push_back("LeftUpLeg");
-	bvh_order.push_back("LeftLeg");
-	bvh_order.push_back("LeftFoot");
-	bvh_order.push_back("LeftToe");
-	bvh_order.push_back("RightUpLeg");
-	bvh_order.push_back("RightLeg");
-	bvh_order.push_back("RightFoot");
-	bvh_order.push_back("RightToe");
-
 	std::vector<Eigen::VectorXd> normalizedPosition;
 	std::vector<double> normalizedDPhase;
 
@@ -1174,53 +1410,13 @@ Controller::SaveDisplayedData(std::string directory, bool normalized) {
 		}
 	}
 
-	ofs << "HIERARCHY" << std::endl;
-	ofs << "ROOT Hips" << std::endl;
-	for(int i = 0; i < HIERARCHY.size(); i++) {
-		ofs << HIERARCHY[i] << std::endl;
-	}
-	ofs << "MOTION" << std::endl;
-	if(normalized) {
-		ofs << "Frames: " << std::to_string(normalizedPosition.size()) << std::endl;
-	} else {
-		ofs << "Frames: " << std::to_string(mRecordPosition.size()) << std::endl;
-	}
-	ofs << "Frame Time:	0.0333333" << std::endl;
-	if(normalized) {
-		for(auto t: normalizedPosition) {
-
-			ofs << t.segment<3>(3).transpose() * 100 << " ";
-
-			for(int i = 0; i < bvh_order.size(); i++) {
-				int idx = mCharacter->GetSkeleton()->getBodyNode(bvh_order[i])->getParentJoint()->getIndexInSkeleton(0);
-				Eigen::AngleAxisd aa(t.segment<3>(idx).norm(), t.segment<3>(idx).normalized());
-				Eigen::Matrix3d m;
-				m = aa;
-				Eigen::Vector3d v = dart::math::matrixToEulerZXY(m);
-				ofs << v.transpose() * 180 / M_PI << " ";			
-			}
-			ofs << std::endl;
-		}
-	} else {
-		for(auto t: mRecordPosition) {
-			ofs << t.segment<3>(3).transpose() * 100 << " ";
-
-			for(int i = 0; i < bvh_order.size(); i++) {
-				int idx = mCharacter->GetSkeleton()->getBodyNode(bvh_order[i])->getParentJoint()->getIndexInSkeleton(0);
-				Eigen::AngleAxisd aa(t.segment<3>(idx).norm(), t.segment<3>(idx).normalized());
-				Eigen::Matrix3d m;
-				m = aa;
-				Eigen::Vector3d v = dart::math::matrixToEulerZXY(m);
-				ofs << v.transpose() * 180 / M_PI << " ";			
-			}
-			ofs << std::endl;		
-		}
-		
-	}
+	if(normalized)
+		mReferenceManager->GetBVHWriter()->Write(path, normalizedPosition);
+	else
+		mReferenceManager->GetBVHWriter()->Write(path, mRecordPosition);
 	std::cout << "saved position: " << mRecordPosition.size() << ", "<< mReferenceManager->GetPhaseLength() << ", " << mRecordPosition[0].rows() << std::endl;
-	ofs.close();
 
-	ofs.open(path+"time");
+	std::ofstream ofs(path+"time");
 	for(auto t: normalizedDPhase) {
 		ofs << t << std::endl;	
 	}
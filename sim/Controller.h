@@ -6,12 +6,82 @@
 #include "SkeletonBuilder.h"
 #include "Functions.h"
 #include "ReferenceManager.h"
+#include "StateLayout.h"
+#include "RolloutRecorder.h"
+#include "Profiler.h"
+#include "WarmStartPgsSolver.h"
+#include "CollisionFilter.h"
 #include <tuple>
 #include <queue>
 namespace DPhy
 {
 /**
 *
+* @brief Reference state initialization at one frame of the reference motion.
+* @details What Reset derives from the reference pose: the pose, the joint velocities, the observation written
+* right after the reset and the record entries with their foot contacts. Cached per frame so resets after short
+* episodes only copy vectors instead of running kinematics and collision queries.
+*
+*/
+struct InitialState
+{
+	bool valid;
+	Eigen::VectorXd positions;
+	Eigen::VectorXd velocities;
+	Eigen::VectorXd bvh_position;
+	Eigen::VectorXd state;
+	Eigen::Vector3d com;
+	std::pair<bool, bool> foot_contact;
+};
+/**
+*
+* @brief Simulation state of a controller between two control steps.
+* @details Everything Step reads besides the reference motion and the settings of the controller: skeleton
+* positions and velocities, the contact impulse cache, phase counters, targets and the reward and fitness
+* accumulators. Restoring it into a controller of the same character continues the episode from that point.
+*
+*/
+struct ControllerState
+{
+	Eigen::VectorXd positions;
+	Eigen::VectorXd velocities;
+	double time;
+	std::vector<WarmStartPgsSolver::CachedImpulse> contacts;
+	std::vector<double> constraint_others;
+
+	double start_frame, current_frame, current_frame_on_phase, prev_frame_on_phase, prev_frame, prev_frame2;
+	double time_elapsed, adaptive_step;
+	int total_steps;
+
+	Eigen::VectorXd target_positions, target_velocities;
+	Eigen::VectorXd pd_target_positions, pd_target_velocities;
+	Eigen::VectorXd actions;
+	Eigen::VectorXd prev_positions, prev_target_positions;
+	Eigen::VectorXd root_zero;
+	std::queue<Eigen::VectorXd> pos_queue;
+	std::queue<double> time_queue;
+
+	std::vector<double> reward_parts;
+	double param_reward_trajectory, tracking_reward_trajectory;
+	Fitness fitness;
+	int count_param, count_tracking, count_slide;
+	Eigen::VectorXd control_flag;
+	Eigen::VectorXd param_cur, param_goal;
+	std::vector<std::pair<Eigen::VectorXd,double>> data_raw;
+	Eigen::VectorXd sum_torque;
+	Eigen::Vector3d stick_left_foot, stick_right_foot;
+	double velocity;
+	Eigen::Vector3d momentum;
+	double condiff, count_contact;
+	Eigen::Vector3d max_com;
+	Eigen::Vector3d prev_lf, prev_rf, prev_lf_bvh, prev_rf_bvh;
+	double prev_height, param_reward_max;
+
+	bool is_terminal, is_nan_at_terminal;
+	int termination_reason;
+};
+/**
+*
 * @brief World class expresses individual virtual world which contains character and ground.
 * @details Character and ground are agent and ground information respectively. Each world contains both of them and also able to interactive environment status with super level.
 * 
@@ -25,11 +95,17 @@ Controller(ReferenceManager* ref, bool adaptive=true, bool parametric=true, bool
 	void UpdateReward();
 	void UpdateTerminalInfo();
 	void Reset(bool RSI=true);
+	// snapshot of the episode, restoring it replaces Reset for branching rollouts from a mid episode state
+	void SaveState(ControllerState& state);
+	void RestoreState(const ControllerState& state);
+	// forgets the cached initial states, after changes of the character or the goal parameters
+	void ClearInitialStates();
 	int GetTerminationReason() {return terminationReason; }
 	int GetNumState();
 	int GetNumAction();
 	Eigen::VectorXd GetEndEffectorStatePosAndVel(const Eigen::VectorXd pos, const Eigen::VectorXd vel);
 	Eigen::VectorXd GetState();
+	void WriteState(double* out);
 
 	
 	bool FollowBvh();
@@ -44,6 +120,7 @@ Controller(ReferenceManager* ref, bool adaptive=true, bool parametric=true, bool
 	}
 
 	bool CheckCollisionWithGround(std::string bodyName);
+	bool CheckCollisionWithGround(BodyHandle body);
 	void SetAction(const Eigen::VectorXd& action);
 	double GetReward() {return mRewardParts[0]; }
 	std::vector<double> GetRewardByParts() {return mRewardParts; }
@@ -52,6 +129,7 @@ Controller(ReferenceManager* ref, bool adaptive=true, bool parametric=true, bool
 
 	double GetTimeElapsed(){return this->mTimeElapsed;}
 	double GetCurrentFrame(){return this->mCurrentFrame;}
+	double GetCurrentFrameOnPhase(){return this->mCurrentFrameOnPhase;}
 	double GetCurrentLength() {return this->mCurrentFrame - this->mStartFrame; }
 	double GetStartFrame(){ return this->mStartFrame; }
 
@@ -61,6 +139,9 @@ Controller(ReferenceManager* ref, bool adaptive=true, bool parametric=true, bool
 	void SaveTimeData(std::string directory);
 	void SaveStepInfo();
 	void ClearRecord();
+	// stream every step to a binary record file instead of keeping the record in memory
+	bool OpenRecordFile(std::string path);
+	void CloseRecordFile();
 
 	// get record (for visualization)
 
@@ -85,10 +166,25 @@ Controller(ReferenceManager* ref, bool adaptive=true, bool parametric=true, bool
 	std::vector<std::pair<bool, Eigen::Vector3d>> GetContactInfo(Eigen::VectorXd pos);
 
 	void SetGoalParameters(Eigen::VectorXd tp);
+	Eigen::VectorXd GetGoalParameters() { return mParamGoal; }
+
+	StageProfile& GetProfile() { return mProfile; }
+	// drive the character with Character::GetFactorizedSPDForces instead of the skeleton's SPD target.
+	// refactor_interval > 1 keeps the factor of (M + dt*Kv) for that many substeps of a control step
+	void SetFactorizedSPD(bool on, int refactor_interval=1);
+	// contacts are solved by dart's cold PGS by default, on switches to the warm started solver
+	void SetWarmStartContacts(bool on);
+	// filtering by the Collision element of the character xml and the ground plane, off by default
+	void SetCollisionFiltering(bool on);
+	WarmStartPgsSolver* GetContactSolver() { return mContactSolver.get(); }
 	void SetSkeletonWeight(double mass);
 
 protected:
 	dart::simulation::WorldPtr mWorld;
+	std::shared_ptr<WarmStartPgsSolver> mContactSolver;
+	std::shared_ptr<CharacterCollisionFilter> mCollisionFilter;
+	std::shared_ptr<dart::collision::CollisionFilter> mDefaultCollisionFilter;
+	std::shared_ptr<dart::collision::CompositeCollisionFilter> mCompositeCollisionFilter;
 	double w_p,w_v,w_com,w_ee;
 	double mStartFrame;
 	double mCurrentFrame; // for discrete ref motion
@@ -119,6 +215,15 @@ protected:
 
 	Eigen::VectorXd mActions;
 	double mAdaptiveStep;
+	bool mFactorizedSPD;
+
+	// initial state per frame of the phase, valid for the motion version of the reference manager it was built on
+	InitialState* GetInitialState(double frame);
+	std::vector<InitialState> mInitialStates;
+	InitialState mScratchInitialState;
+	int mInitialStateVersion;
+	// observation of the last reset, returned by WriteState until the next step
+	const Eigen::VectorXd* mResetState;
 
 	std::vector<std::string> mInterestedBodies;
 	std::vector<std::string> mRewardBodies;
@@ -126,11 +231,15 @@ protected:
 	int mRewardDof;
 
 	std::vector<std::string> mEndEffectors;
+	std::vector<dart::dynamics::BodyNode*> mEndEffectorBodies;
+	StateLayout* mStateLayout;
+	SkeletonHandles* mHandles;
 	std::vector<std::string> mRewardLabels;
 	std::vector<double> mRewardParts;
 	Fitness mFitness;
 	// for foot collision, left, right foot, ground
 	std::unique_ptr<dart::collision::CollisionGroup> mCGEL, mCGER, mCGL, mCGR, mCGG, mCGHR, mCGHL, mCGOBJ; 
+	dart::collision::CollisionGroup* mCGBody[NUM_BODY_HANDLES];
 
 	std::vector<Eigen::VectorXd> mRecordPosition;
 	std::vector<Eigen::VectorXd> mRecordVelocity;
@@ -144,6 +253,10 @@ protected:
 	bool mIsTerminal;
 	bool mIsNanAtTerminal;
 	bool mRecord;
+	RolloutRecorder* mRecorder;
+	// the last collision result of the world belongs to the current pose, false until the first step of an episode
+	bool mStepCollision;
+	StageProfile mProfile;
 	std::tuple<double, double, double> mRescaleParameter;
 	std::vector<Eigen::Vector6d> mRecordCOMVelocity;
 	std::vector<Eigen::Vector3d> mRecordCOMPositionRef;
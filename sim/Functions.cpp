@@ -419,6 +419,32 @@ Eigen::Vector3d QuaternionToDARTPosition(const Eigen::Quaterniond& in){
 	return angle*aa.axis();
 }
 
+void ExpToQuaternion(const Eigen::ArrayXXd& x, const Eigen::ArrayXXd& y, const Eigen::ArrayXXd& z,
+					 Eigen::ArrayXXd& qw, Eigen::ArrayXXd& qx, Eigen::ArrayXXd& qy, Eigen::ArrayXXd& qz)
+{
+	Eigen::ArrayXXd angle = (x*x + y*y + z*z).sqrt();
+	Eigen::ArrayXXd s = (angle < 1e-8).select(0.5 - angle*angle / 48.0, (0.5*angle).sin() / angle);
+	qw = (0.5*angle).cos();
+	qx = s*x;
+	qy = s*y;
+	qz = s*z;
+}
+
+void QuaternionToExp(const Eigen::ArrayXXd& qw, const Eigen::ArrayXXd& qx, const Eigen::ArrayXXd& qy, const Eigen::ArrayXXd& qz,
+					 Eigen::ArrayXXd& x, Eigen::ArrayXXd& y, Eigen::ArrayXXd& z)
+{
+	// q and -q are the same rotation, take the one with the angle in [0, pi]
+	Eigen::ArrayXXd sign = (qw < 0).select(Eigen::ArrayXXd::Constant(qw.rows(), qw.cols(), -1.0),
+										   Eigen::ArrayXXd::Constant(qw.rows(), qw.cols(), 1.0));
+	Eigen::ArrayXXd w = qw * sign;
+	Eigen::ArrayXXd nv = (qx*qx + qy*qy + qz*qz).sqrt();
+	Eigen::ArrayXXd angle = 2.0 * (nv / w).atan();
+	Eigen::ArrayXXd f = (nv < 1e-8).select(2.0 / w, angle / nv) * sign;
+	x = f*qx;
+	y = f*qy;
+	z = f*qz;
+}
+
 Eigen::VectorXd BlendPosition(Eigen::VectorXd target_a, Eigen::VectorXd target_b, double weight, bool blend_rootpos) {
 
 	Eigen::VectorXd result(target_a.rows());
@@ -47,6 +47,12 @@ std::vector<dart::dynamics::BodyNode*> GetChildren(const dart::dynamics::Skeleto
 Eigen::Quaterniond DARTPositionToQuaternion(Eigen::Vector3d in);
 Eigen::Vector3d QuaternionToDARTPosition(const Eigen::Quaterniond& in);
 void QuaternionNormalize(Eigen::Quaterniond& in);
+// exponential coordinates to unit quaternions and back, element-wise over arrays of frames; the log map takes the
+// angle in [0, pi]
+void ExpToQuaternion(const Eigen::ArrayXXd& x, const Eigen::ArrayXXd& y, const Eigen::ArrayXXd& z,
+					 Eigen::ArrayXXd& qw, Eigen::ArrayXXd& qx, Eigen::ArrayXXd& qy, Eigen::ArrayXXd& qz);
+void QuaternionToExp(const Eigen::ArrayXXd& qw, const Eigen::ArrayXXd& qx, const Eigen::ArrayXXd& qy, const Eigen::ArrayXXd& qz,
+					 Eigen::ArrayXXd& x, Eigen::ArrayXXd& y, Eigen::ArrayXXd& z);
 Eigen::VectorXd BlendPosition(Eigen::VectorXd v_target, Eigen::VectorXd v_source, double weight, bool blend_rootpos=true);
 Eigen::VectorXd BlendVelocity(Eigen::VectorXd target_a, Eigen::VectorXd target_b, double weight);
 Eigen::Vector3d NearestOnGeodesicCurve3d(Eigen::Vector3d targetAxis, Eigen::Vector3d targetPosition, Eigen::Vector3d position);
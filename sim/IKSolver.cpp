@@ -0,0 +1,217 @@
+#include "IKSolver.h"
+#include <algorithm>
+namespace DPhy
+{
+IKSolver::
+IKSolver(const dart::dynamics::SkeletonPtr& skel)
+	:mSkeleton(skel), mColumnsDirty(true), mMaxIteration(20), mTolerance(1e-3), mDamping(0.05), mMaxStep(0.2)
+{
+	mDof = skel->getNumDofs();
+	mFixed.assign(mDof, false);
+	this->SetFixedDofs(0, std::min(6, mDof));
+	this->ClearStats();
+}
+int
+IKSolver::
+AddConstraint(const std::string& bodyname, const Eigen::Vector3d& offset)
+{
+	dart::dynamics::BodyNode* bn = mSkeleton->getBodyNode(bodyname);
+	if(bn == nullptr) {
+		std::cout << "IKSolver : no body node " << bodyname << std::endl;
+		return -1;
+	}
+	Constraint c;
+	c.body = bn;
+	c.offset = offset;
+	c.target = bn->getWorldTransform()*offset;
+	c.active = true;
+	mConstraints.push_back(c);
+	mColumnsDirty = true;
+	return mConstraints.size() - 1;
+}
+void
+IKSolver::
+ClearConstraints()
+{
+	mConstraints.clear();
+	mColumnsDirty = true;
+}
+void
+IKSolver::
+SetTarget(int idx, const Eigen::Vector3d& target)
+{
+	mConstraints[idx].target = target;
+}
+void
+IKSolver::
+SetActive(int idx, bool active)
+{
+	mConstraints[idx].active = active;
+}
+void
+IKSolver::
+SetFixedDofs(int begin, int count, bool fixed)
+{
+	for(int i = begin; i < begin + count && i < mDof; i++)
+		mFixed[i] = fixed;
+	mColumnsDirty = true;
+}
+void
+IKSolver::
+SetOption(int max_iteration, double tolerance, double damping, double max_step)
+{
+	mMaxIteration = max_iteration;
+	mTolerance = tolerance;
+	mDamping = damping;
+	mMaxStep = max_step;
+}
+const std::vector<int>&
+IKSolver::
+GetChainDofs(int idx)
+{
+	if(mColumnsDirty)
+		this->UpdateColumns();
+	return mConstraints[idx].dofs;
+}
+void
+IKSolver::
+UpdateColumns()
+{
+	std::vector<bool> used(mDof, false);
+	for(int i = 0; i < mConstraints.size(); i++) {
+		dart::dynamics::BodyNode* bn = mConstraints[i].body;
+		for(int j = 0; j < bn->getNumDependentGenCoords(); j++) {
+			int dof = bn->getDependentGenCoordIndex(j);
+			if(!mFixed[dof])
+				used[dof] = true;
+		}
+	}
+	std::vector<int> column(mDof, -1);
+	mColumnDofs.clear();
+	for(int i = 0; i < mDof; i++) {
+		if(used[i]) {
+			column[i] = mColumnDofs.size();
+			mColumnDofs.push_back(i);
+		}
+	}
+	for(int i = 0; i < mConstraints.size(); i++) {
+		dart::dynamics::BodyNode* bn = mConstraints[i].body;
+		mConstraints[i].columns.resize(bn->getNumDependentGenCoords());
+		mConstraints[i].dofs.clear();
+		for(int j = 0; j < bn->getNumDependentGenCoords(); j++) {
+			int dof = bn->getDependentGenCoordIndex(j);
+			mConstraints[i].columns[j] = column[dof];
+			if(column[dof] != -1)
+				mConstraints[i].dofs.push_back(dof);
+		}
+	}
+	mColumnsDirty = false;
+}
+void
+IKSolver::
+Integrate(const Eigen::VectorXd& q, const Eigen::VectorXd& dq)
+{
+	// ball and free joints are integrated on the rotation group, adding dq to the positions is only first order
+	mSkeleton->setPositions(q);
+	mSkeleton->setVelocities(dq);
+	mSkeleton->integratePositions(1.0);
+	mSkeleton->computeForwardKinematics(true, false, false);
+}
+Eigen::VectorXd
+IKSolver::
+Solve(const Eigen::VectorXd& pose)
+{
+	if(mColumnsDirty)
+		this->UpdateColumns();
+
+	Eigen::VectorXd v_save = mSkeleton->getVelocities();
+	Eigen::VectorXd q = pose;
+	mSkeleton->setPositions(q);
+	mSkeleton->computeForwardKinematics(true, false, false);
+
+	int num_rows = 0;
+	for(int i = 0; i < mConstraints.size(); i++) {
+		if(mConstraints[i].active)
+			num_rows += 3;
+	}
+	int num_cols = mColumnDofs.size();
+	if(num_rows == 0 || num_cols == 0)
+		return q;
+
+	Eigen::MatrixXd J(num_rows, num_cols);
+	Eigen::VectorXd e(num_rows);
+	Eigen::VectorXd dq = Eigen::VectorXd::Zero(mDof);
+	for(int iter = 0; iter < mMaxIteration; iter++) {
+		J.setZero();
+		double max_error = 0;
+		int r = 0;
+		for(int i = 0; i < mConstraints.size(); i++) {
+			const Constraint& c = mConstraints[i];
+			if(!c.active)
+				continue;
+			e.segment<3>(r) = c.target - c.body->getWorldTransform()*c.offset;
+			max_error = std::max(max_error, e.segment<3>(r).norm());
+
+			dart::math::LinearJacobian jacobian = c.body->getLinearJacobian(c.offset);
+			for(int j = 0; j < c.columns.size(); j++) {
+				if(c.columns[j] != -1)
+					J.block<3,1>(r, c.columns[j]) = jacobian.col(j);
+			}
+			r += 3;
+		}
+		if(max_error < mTolerance)
+			break;
+		mNumIterations += 1;
+
+		Eigen::MatrixXd A = J*J.transpose();
+		A.diagonal().array() += mDamping*mDamping;
+		Eigen::VectorXd dx = J.transpose()*A.ldlt().solve(e);
+		double step = dx.norm();
+		if(step > mMaxStep)
+			dx *= mMaxStep / step;
+
+		for(int k = 0; k < num_cols; k++)
+			dq[mColumnDofs[k]] = dx[k];
+		this->Integrate(q, dq);
+		q = mSkeleton->getPositions();
+	}
+	mSkeleton->setVelocities(v_save);
+	return q;
+}
+void
+IKSolver::
+SolveSequence(std::vector<Eigen::VectorXd>& poses, const std::vector<std::vector<Eigen::Vector3d>>& targets,
+			  const std::vector<std::vector<bool>>& active)
+{
+	if(mColumnsDirty)
+		this->UpdateColumns();
+
+	Eigen::VectorXd v_save = mSkeleton->getVelocities();
+	Eigen::VectorXd correction = Eigen::VectorXd::Zero(mDof);
+	Eigen::VectorXd warm = Eigen::VectorXd::Zero(mDof);
+	for(int k = 0; k < poses.size(); k++) {
+		// warm start with the correction of the previous frame on the chains constrained in this frame only,
+		// so a foot that is released goes back to its reference motion
+		warm.setZero();
+		bool any = false;
+		for(int i = 0; i < mConstraints.size(); i++) {
+			mConstraints[i].active = active[k][i];
+			mConstraints[i].target = targets[k][i];
+			if(!active[k][i])
+				continue;
+			any = true;
+			for(int j = 0; j < mConstraints[i].dofs.size(); j++)
+				warm[mConstraints[i].dofs[j]] = correction[mConstraints[i].dofs[j]];
+		}
+		if(!any) {
+			correction.setZero();
+			continue;
+		}
+		this->Integrate(poses[k], warm);
+		Eigen::VectorXd q = this->Solve(mSkeleton->getPositions());
+		correction = mSkeleton->getPositionDifferences(q, poses[k]);
+		poses[k] = q;
+	}
+	mSkeleton->setVelocities(v_save);
+}
+}
@@ -0,0 +1,74 @@
+#ifndef __DEEP_PHYSICS_IK_SOLVER_H__
+#define __DEEP_PHYSICS_IK_SOLVER_H__
+#include "dart/dart.hpp"
+#include <vector>
+#include <string>
+namespace DPhy
+{
+/**
+*
+* @brief Damped least squares inverse kinematics for point constraints on body nodes.
+* @details Each constraint only depends on the dofs of the chain from its body to the root, so the Jacobian is built
+* from the analytic chain Jacobians of dart (3 x chain dofs) into the columns of the dofs that are moved at all,
+* and the step dq = J^T (J J^T + damping^2 I)^-1 e only factorizes a matrix of three rows per active constraint.
+* The damping keeps steps bounded near singular (straight knee) poses where the pseudo-inverse of solveMCIK blows
+* up. SolveSequence starts every frame from the correction of the previous one, so consecutive frames of a motion
+* usually converge in one or two iterations.
+*
+*/
+class IKSolver
+{
+public:
+	IKSolver(const dart::dynamics::SkeletonPtr& skel);
+
+	// point at offset in the body frame, returns the index of the constraint
+	int AddConstraint(const std::string& bodyname, const Eigen::Vector3d& offset);
+	void ClearConstraints();
+	void SetTarget(int idx, const Eigen::Vector3d& target);
+	void SetActive(int idx, bool active);
+	// fixed dofs are not moved, the root joint is fixed by default
+	void SetFixedDofs(int begin, int count, bool fixed=true);
+	void SetOption(int max_iteration, double tolerance, double damping, double max_step);
+	// dofs moved for constraint idx, the chain from its body to the root without fixed dofs
+	const std::vector<int>& GetChainDofs(int idx);
+
+	// pose that reaches the targets of the active constraints, the skeleton is left at that pose
+	Eigen::VectorXd Solve(const Eigen::VectorXd& pose);
+	// solves every pose in place, constraint i of frame k is active where active[k][i] with target targets[k][i]
+	void SolveSequence(std::vector<Eigen::VectorXd>& poses, const std::vector<std::vector<Eigen::Vector3d>>& targets,
+					   const std::vector<std::vector<bool>>& active);
+
+	// iterations since the last ClearStats
+	long GetNumIterations() { return mNumIterations; }
+	void ClearStats() { mNumIterations = 0; }
+private:
+	struct Constraint
+	{
+		dart::dynamics::BodyNode* body;
+		Eigen::Vector3d offset;
+		Eigen::Vector3d target;
+		bool active;
+		// column of every chain dof in the reduced Jacobian, -1 for fixed dofs
+		std::vector<int> columns;
+		std::vector<int> dofs;
+	};
+	void UpdateColumns();
+	// integrates the reduced dofs by dq from q and sets the result on the skeleton
+	void Integrate(const Eigen::VectorXd& q, const Eigen::VectorXd& dq);
+
+	dart::dynamics::SkeletonPtr mSkeleton;
+	int mDof;
+	std::vector<Constraint> mConstraints;
+	std::vector<bool> mFixed;
+	// dof of every column of the reduced Jacobian
+	std::vector<int> mColumnDofs;
+	bool mColumnsDirty;
+
+	int mMaxIteration;
+	double mTolerance;
+	double mDamping;
+	double mMaxStep;
+	long mNumIterations;
+};
+}
+#endif
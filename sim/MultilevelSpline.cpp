@@ -1,7 +1,31 @@
 #include "MultilevelSpline.h"
 #include <Eigen/Dense>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#define SPLINE_FIT_CACHE_SIZE 64
 namespace DPhy
 {
+struct SplineFitKey
+{
+	bool circular;
+	double end;
+	std::vector<double> knots;
+	std::vector<double> times;
+
+	bool operator<(const SplineFitKey& other) const {
+		if(circular != other.circular)
+			return circular < other.circular;
+		if(end != other.end)
+			return end < other.end;
+		if(knots != other.knots)
+			return knots < other.knots;
+		return times < other.times;
+	}
+};
+static std::map<SplineFitKey, std::shared_ptr<const SplineFit>> gFitCache;
+static std::mutex gFitCacheLock;
+
 Spline::
 Spline(std::vector<double> knots, double end) {
 	mEnd = end;
@@ -38,93 +62,169 @@ SetKnots(double knot_interval) {
 double 
 Spline::
 B(int idx, double t) {
+	double t2 = t * t;
+	double t3 = t2 * t;
 	if(idx == 0) {
-		return 1.0 / 6 * pow(1 - t, 3);
+		double s = 1 - t;
+		return 1.0 / 6 * s * s * s;
 	} else if (idx == 1) {
-		return 1.0 / 6 * (3 * pow(t, 3) - 6 * pow(t, 2) + 4);
+		return 1.0 / 6 * (3 * t3 - 6 * t2 + 4);
 	} else if (idx == 2) {
-		return 1.0 / 6 * (-3 * pow(t, 3) + 3 * pow(t, 2) + 3 * t + 1);
+		return 1.0 / 6 * (-3 * t3 + 3 * t2 + 3 * t + 1);
 	} else {
-		return 1.0 / 6 * pow(t, 3);
+		return 1.0 / 6 * t3;
 	}
 }
 void
 Spline::
-Approximate(std::vector<std::pair<Eigen::VectorXd,double>> motion, std::vector<int> idxs, bool circular) {
-	int length = mKnots.size();
-	Eigen::MatrixXd P(motion.size(), idxs.size());
-	Eigen::MatrixXd C(length+3, idxs.size());
-
-	if(circular) {
-		Eigen::MatrixXd M(length, motion.size());
+Bases(double t, double* b) {
+	double t2 = t * t;
+	double t3 = t2 * t;
+	double s = 1 - t;
+	b[0] = 1.0 / 6 * s * s * s;
+	b[1] = 1.0 / 6 * (3 * t3 - 6 * t2 + 4);
+	b[2] = 1.0 / 6 * (-3 * t3 + 3 * t2 + 3 * t + 1);
+	b[3] = 1.0 / 6 * t3;
+}
+int
+Spline::
+FindKnot(double t) {
+	// last knot strictly before t, 0 if there is none
+	auto it = std::lower_bound(mKnots.begin(), mKnots.end(), t);
+	if(it == mKnots.begin())
+		return 0;
+	return (it - mKnots.begin()) - 1;
+}
+void
+Spline::
+ClearFitCache() {
+	std::lock_guard<std::mutex> lock(gFitCacheLock);
+	gFitCache.clear();
+}
+std::shared_ptr<const SplineFit>
+Spline::
+GetFit(const std::vector<std::pair<Eigen::VectorXd,double>>& motion, bool circular) {
+	SplineFitKey key;
+	key.circular = circular;
+	key.end = mEnd;
+	key.knots = mKnots;
+	key.times.resize(motion.size());
+	for(int i = 0; i < motion.size(); i++)
+		key.times[i] = motion[i].second;
+
+	{
+		std::lock_guard<std::mutex> lock(gFitCacheLock);
+		auto it = gFitCache.find(key);
+		if(it != gFitCache.end())
+			return it->second;
+	}
 
-		M.setZero();
+	// built outside of the lock, a concurrent miss on the same key only costs a second factorization
+	int length = mKnots.size();
+	std::shared_ptr<SplineFit> fit(new SplineFit);
+	fit->circular = circular;
+	fit->numControlPoints = circular ? length : length + 3;
+	fit->idx.resize(motion.size());
+	fit->weight.resize(motion.size());
 
-		int count = 0;
-		for(int i = 0; i < motion.size(); i++) {
-			for(int j = 0; j < idxs.size(); j++) {
-				P(i, j) = (motion[i].first)[idxs[j]];
-			}
-			if(count + 1 < mKnots.size() && motion[i].second >= mKnots[count + 1]) {
-				count += 1;
-			}
-			double interval = mKnots[ (count + 1) % length ] - mKnots[count];
+	int count = 0;
+	for(int i = 0; i < motion.size(); i++) {
+		if(count + 1 < mKnots.size() && motion[i].second >= mKnots[count + 1]) {
+			count += 1;
+		}
+		double interval;
+		if(circular) {
+			interval = mKnots[ (count + 1) % length ] - mKnots[count];
 			if(interval < 0)
 				interval += mEnd;
-			double f = (motion[i].second - mKnots[count]) / interval;
-			M((count - 1 + length) % length, i) = B(0, f);
-			M(count, i) = B(1, f);
-			M((count + 1) % length, i) = B(2, f);
-			M((count + 2) % length, i) = B(3, f);
-		}	
-		
-		Eigen::MatrixXd Mt = M.transpose();
-		auto solver = Mt.bdcSvd(Eigen::ComputeThinU | Eigen::ComputeThinV);
-
-		for(int i = 0; i < P.cols(); i++) {
-			Eigen::VectorXd cp = solver.solve(P.col(i));
-			C.block(1, i, length, 1) = cp;
-			C(0, i) = cp(cp.rows()-1);
-			C(length+1, i) = cp(0);
-			C(length+2, i) = cp(1);
+		} else if(count + 1 >= mKnots.size()) {
+			interval = mEnd - mKnots[count];
+		} else {
+			interval = mKnots[count + 1] - mKnots[count];
 		}
-	} else {
-		Eigen::MatrixXd M(length+3, motion.size());
+		double f = (motion[i].second - mKnots[count]) / interval;
+
+		for(int k = 0; k < 4; k++) {
+			int row = circular ? (count - 1 + k + length) % length : count + k;
+			double w = B(k, f);
+			if(row >= fit->numControlPoints) {
+				row = 0;
+				w = 0;
+			}
+			// same entry written twice (very few knots): the later basis wins, as in the dense fill
+			for(int l = 0; l < k; l++) {
+				if(fit->idx[i][l] == row)
+					fit->weight[i][l] = 0;
+			}
+			fit->idx[i][k] = row;
+			fit->weight[i][k] = w;
+		}
+	}
 
-		M.setZero();
+	// normal equations M M^T, every frame adds a 4x4 block
+	std::vector<Eigen::Triplet<double>> triplets;
+	triplets.reserve(motion.size() * 16);
+	double max_diag = 0;
+	Eigen::VectorXd diag = Eigen::VectorXd::Zero(fit->numControlPoints);
+	for(int i = 0; i < motion.size(); i++) {
+		for(int k = 0; k < 4; k++) {
+			diag[fit->idx[i][k]] += fit->weight[i][k] * fit->weight[i][k];
+			for(int l = 0; l < 4; l++)
+				triplets.push_back(Eigen::Triplet<double>(fit->idx[i][k], fit->idx[i][l], fit->weight[i][k] * fit->weight[i][l]));
+		}
+	}
+	for(int i = 0; i < diag.rows(); i++)
+		max_diag = std::max(max_diag, diag[i]);
+	Eigen::SparseMatrix<double> N(fit->numControlPoints, fit->numControlPoints);
+	N.setFromTriplets(triplets.begin(), triplets.end());
+
+	// control points without support get a zero row; the small shift sends them to zero
+	// like the minimum norm solution of the svd did
+	fit->solver.setShift(1e-10 * std::max(max_diag, 1.0));
+	fit->solver.compute(N);
+	if(fit->solver.info() != Eigen::Success)
+		std::cout << "spline fit : factorization failed" << std::endl;
+
+	std::lock_guard<std::mutex> lock(gFitCacheLock);
+	if(gFitCache.size() >= SPLINE_FIT_CACHE_SIZE)
+		gFitCache.clear();
+	gFitCache[key] = fit;
+	return fit;
+}
+void
+Spline::
+Approximate(const std::vector<std::pair<Eigen::VectorXd,double>>& motion, const std::vector<int>& idxs, bool circular) {
+	if(idxs.size() == 0 || motion.size() == 0)
+		return;
+
+	std::shared_ptr<const SplineFit> fit = this->GetFit(motion, circular);
+	int length = mKnots.size();
 
-		int count = 0;
-		for(int i = 0; i < motion.size(); i++) {
+	// right hand side M P, four basis weights per frame
+	Eigen::MatrixXd rhs = Eigen::MatrixXd::Zero(fit->numControlPoints, idxs.size());
+	for(int i = 0; i < motion.size(); i++) {
+		const Eigen::VectorXd& m = motion[i].first;
+		for(int k = 0; k < 4; k++) {
+			double w = fit->weight[i][k];
+			if(w == 0)
+				continue;
+			int row = fit->idx[i][k];
 			for(int j = 0; j < idxs.size(); j++) {
-				P(i, j) = (motion[i].first)[idxs[j]];
-			}			
-			if(count + 1 < mKnots.size() && motion[i].second >= mKnots[count + 1]) {
-				count += 1;
+				rhs(row, j) += w * m[idxs[j]];
 			}
-
-			double interval;
-			if(count + 1 >= mKnots.size())
-				interval = mEnd - mKnots[count];
-			else
-				interval = mKnots[count + 1] - mKnots[count];
-			double f = (motion[i].second - mKnots[count]) / interval;
-
-			M((count - 1) + 1, i) = B(0, f);
-			M(count + 1, i) = B(1, f);
-			M((count + 1) + 1, i) = B(2, f);
-			
-			if((count + 2) + 1 < M.rows())
-				M((count + 2) + 1, i) = B(3, f);
-		}	
-		
-		Eigen::MatrixXd Mt = M.transpose();
-		auto solver = Mt.bdcSvd(Eigen::ComputeThinU | Eigen::ComputeThinV);
-
-		for(int i = 0; i < P.cols(); i++) {
-			Eigen::VectorXd cp = solver.solve(P.col(i));
-			C.block(0, i, length + 3, 1) = cp;
 		}
 	}
+	Eigen::MatrixXd cp = fit->solver.solve(rhs);
+
+	Eigen::MatrixXd C(length+3, idxs.size());
+	if(circular) {
+		C.block(1, 0, length, idxs.size()) = cp;
+		C.row(0) = cp.row(length - 1);
+		C.row(length + 1) = cp.row(0);
+		C.row(length + 2) = cp.row(1 % length);
+	} else {
+		C = cp;
+	}
 
 	for(int i = 0; i < C.rows(); i++) {
 		for(int j = 0; j < idxs.size(); j++) {
@@ -134,7 +234,7 @@ Approximate(std::vector<std::pair<Eigen::VectorXd,double>> motion, std::vector<i
 }
 void
 Spline::
-Approximate(std::vector<std::pair<Eigen::VectorXd,double>> motion) {
+Approximate(const std::vector<std::pair<Eigen::VectorXd,double>>& motion) {
 	mControlPoints.clear();
 
 	int dof = motion[0].first.rows();
@@ -163,49 +263,76 @@ Approximate(std::vector<std::pair<Eigen::VectorXd,double>> motion) {
 Eigen::VectorXd 
 Spline::
 GetPosition(double t) {
-
 	int length = mKnots.size();
 	int dof = mControlPoints[0].rows();
-	Eigen::VectorXd p(dof);
-	p.setZero();
-	int knot = 0;
-
-	for(int i = length - 1; i >= 0; i--) {
-		if(t > mKnots[i]) {
-			knot = i;
-			break;
-		}
-	}
-	int nc_count = 0;
+	int knot = this->FindKnot(t);
+
 	double knot_interval_c;
 	double knot_interval_nc;
-	if(knot + 1 >= mKnots.size()) {
+	if(knot + 1 >= length) {
 		knot_interval_c = mKnots[0] + mEnd - mKnots[knot];
 		knot_interval_nc = mEnd - mKnots[knot];
 	} else {
 		knot_interval_c = mKnots[knot + 1] - mKnots[knot];
 		knot_interval_nc = knot_interval_c;
 	}
-	double t_c = (t - mKnots[knot]) / knot_interval_c;
-	double t_nc = (t - mKnots[knot]) / knot_interval_nc;
-
-	bool circular = true;
-	for(int i = 0; i < dof; i++) {
-		if(mNC_idxs.size() > nc_count && i == mNC_idxs[nc_count]) {
-			circular = false;
-			nc_count += 1;
-		} 
-		for(int j = -1; j < 3; j++) {
-			int cp_idx = knot + j + 1; 
-			if(circular)
-				p(i) += this->B(j+1, t_c) * mControlPoints[cp_idx](i);
-			else
-				p(i) += this->B(j+1, t_nc) * mControlPoints[cp_idx](i);
-		}
+	double b_c[4], b_nc[4];
+	this->Bases((t - mKnots[knot]) / knot_interval_c, b_c);
+	this->Bases((t - mKnots[knot]) / knot_interval_nc, b_nc);
+
+	Eigen::VectorXd p = b_c[0] * mControlPoints[knot] + b_c[1] * mControlPoints[knot + 1]
+					  + b_c[2] * mControlPoints[knot + 2] + b_c[3] * mControlPoints[knot + 3];
+	// dofs from the first non circular index on use the non circular interval
+	int nc_begin = mNC_idxs.size() > 0 ? mNC_idxs[0] : dof;
+	int n_nc = dof - nc_begin;
+	if(n_nc > 0 && knot_interval_nc != knot_interval_c) {
+		p.tail(n_nc) = b_nc[0] * mControlPoints[knot].tail(n_nc) + b_nc[1] * mControlPoints[knot + 1].tail(n_nc)
+					 + b_nc[2] * mControlPoints[knot + 2].tail(n_nc) + b_nc[3] * mControlPoints[knot + 3].tail(n_nc);
 	}
-
 	return p;
-
+}
+void
+Spline::
+Evaluate(const std::vector<double>& times, Eigen::Ref<Eigen::MatrixXd> out) {
+	int length = mKnots.size();
+	int dof = mControlPoints[0].rows();
+	int n_cps = mControlPoints.size();
+
+	// control points as rows, so each frame is a sum of four contiguous rows
+	Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> cps(n_cps, dof);
+	for(int i = 0; i < n_cps; i++)
+		cps.row(i) = mControlPoints[i].transpose();
+	// dofs from the first non circular index on use the non circular interval, same as GetPosition
+	int nc_begin = mNC_idxs.size() > 0 ? mNC_idxs[0] : dof;
+	int n_nc = dof - nc_begin;
+
+	Eigen::RowVectorXd row(dof);
+	double b_c[4], b_nc[4];
+	for(int f = 0; f < times.size(); f++) {
+		double t = times[f];
+		int knot = this->FindKnot(t);
+
+		double knot_interval_c;
+		double knot_interval_nc;
+		if(knot + 1 >= length) {
+			knot_interval_c = mKnots[0] + mEnd - mKnots[knot];
+			knot_interval_nc = mEnd - mKnots[knot];
+		} else {
+			knot_interval_c = mKnots[knot + 1] - mKnots[knot];
+			knot_interval_nc = knot_interval_c;
+		}
+		this->Bases((t - mKnots[knot]) / knot_interval_c, b_c);
+		this->Bases((t - mKnots[knot]) / knot_interval_nc, b_nc);
+
+		row.noalias() = b_c[0] * cps.row(knot) + b_c[1] * cps.row(knot + 1)
+					  + b_c[2] * cps.row(knot + 2) + b_c[3] * cps.row(knot + 3);
+		// non circular dofs only differ in the last interval
+		if(n_nc > 0 && knot_interval_nc != knot_interval_c) {
+			row.tail(n_nc).noalias() = b_nc[0] * cps.row(knot).tail(n_nc) + b_nc[1] * cps.row(knot + 1).tail(n_nc)
+									 + b_nc[2] * cps.row(knot + 2).tail(n_nc) + b_nc[3] * cps.row(knot + 3).tail(n_nc);
+		}
+		out.row(f) += row;
+	}
 }
 void
 Spline::
@@ -293,20 +420,33 @@ ConvertMotionToSpline(std::vector<std::pair<Eigen::VectorXd,double>> motion) {
 std::vector<Eigen::VectorXd> 
 MultilevelSpline::
 ConvertSplineToMotion() {
+	Eigen::MatrixXd m;
+	this->ConvertSplineToMotion(m);
+
 	std::vector<Eigen::VectorXd> motion;
-	
-	int dof = mSplines[0]->GetPosition(0).rows();
+	for(int i = 0; i < m.rows(); i++) {
+		motion.push_back(m.row(i).transpose());
+	}
 
+	return motion;
+}
+void
+MultilevelSpline::
+ConvertSplineToMotion(Eigen::MatrixXd& motion) {
+	std::vector<double> times;
 	for(int i = 0; i < mEnd; i++) {
-		motion.push_back(Eigen::VectorXd::Zero(dof));
+		times.push_back(i);
 	}
+	this->Evaluate(times, motion);
+}
+void
+MultilevelSpline::
+Evaluate(const std::vector<double>& times, Eigen::MatrixXd& motion) {
+	int dof = mSplines[0]->GetControlPoints()[0].rows();
+	motion.setZero(times.size(), dof);
 
 	for(int i = 0; i < mNumLevels; i++) {
-		for(int j = 0; j < mEnd; j++) {
-			motion[j] += mSplines[i]->GetPosition(j);
-		}
+		mSplines[i]->Evaluate(times, motion);
 	}
-
-	return motion;
 }
 }
\ No newline at end of file
@@ -3,12 +3,32 @@
 
 #include <vector>
 #include <Eigen/Core>
+#include <Eigen/Sparse>
+#include <memory>
+#include <array>
 #include <string>
 #include <fstream>
 #include <iostream>
 
 namespace DPhy
 {
+/**
+*
+* @brief Factorized least squares system of a spline fit.
+* @details Cubic B-spline bases are 4-banded, so the normal matrix M M^T is banded (cyclic for circular dofs) and
+* only depends on the knots and the sample times. It is factorized once with a sparse LDLT and shared by every dof
+* column and every trajectory with the same layout; a fit then costs one back-substitution.
+*
+*/
+struct SplineFit
+{
+	bool circular;
+	int numControlPoints;
+	// control point index and basis weight of the four bases of each frame
+	std::vector<std::array<int, 4>> idx;
+	std::vector<std::array<double, 4>> weight;
+	Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>> solver;
+};
 class Spline
 {
 public:
@@ -17,15 +37,23 @@ public:
 	void SetKnots(std::vector<double> knots);
 	void SetKnots(double knot_interval);
 	std::vector<double> GetKnots() { return mKnots; };
-	void Approximate(std::vector<std::pair<Eigen::VectorXd,double>> motion, std::vector<int> idxs, bool circular);
-	void Approximate(std::vector<std::pair<Eigen::VectorXd,double>> motion);
+	void Approximate(const std::vector<std::pair<Eigen::VectorXd,double>>& motion, const std::vector<int>& idxs, bool circular);
+	void Approximate(const std::vector<std::pair<Eigen::VectorXd,double>>& motion);
 	Eigen::VectorXd GetPosition(double t);
+	// adds the spline value at each time to the rows of out (frames x dof)
+	void Evaluate(const std::vector<double>& times, Eigen::Ref<Eigen::MatrixXd> out);
 	std::vector<Eigen::VectorXd> GetControlPoints() { return mControlPoints; };
 	void SetControlPoints(std::vector<Eigen::VectorXd> cps) { mControlPoints = cps; }; 
 	void Save(std::string path);
 	void SetNonCircular(std::vector<int> nc_idx) { mNC_idxs = nc_idx; };
+	// factorizations are shared between all splines of the process
+	static void ClearFitCache();
 protected:
 	double B(int idx, double t);
+	// the four basis weights at t
+	void Bases(double t, double* b);
+	int FindKnot(double t);
+	std::shared_ptr<const SplineFit> GetFit(const std::vector<std::pair<Eigen::VectorXd,double>>& motion, bool circular);
 
 	double mEnd;
 	std::vector<double> mKnots;
@@ -47,6 +75,9 @@ public:
 	void SetControlPoints(int i, std::vector<Eigen::VectorXd> cps);
 	std::vector<Eigen::VectorXd> GetControlPoints(int i);
 	std::vector<Eigen::VectorXd> ConvertSplineToMotion();
+	// frames x dof, every level summed in one batch evaluation
+	void ConvertSplineToMotion(Eigen::MatrixXd& motion);
+	void Evaluate(const std::vector<double>& times, Eigen::MatrixXd& motion);
 protected:
 	double mEnd;
 	std::vector<Spline*> mSplines;
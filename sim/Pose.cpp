@@ -0,0 +1,165 @@
+#include "Pose.h"
+#include "Functions.h"
+namespace DPhy
+{
+typedef Eigen::ArrayXXd Arr;
+
+PoseLayout::
+PoseLayout(const dart::dynamics::SkeletonPtr& skel)
+{
+	mDof = skel->getNumDofs();
+	for(int i = 0; i < skel->getNumJoints(); i++) {
+		dart::dynamics::Joint* jn = skel->getJoint(i);
+		if(jn->getNumDofs() == 0)
+			continue;
+		int idx = jn->getIndexInSkeleton(0);
+		if(dynamic_cast<dart::dynamics::FreeJoint*>(jn) != nullptr) {
+			mRotationDofs.push_back(idx);
+			for(int j = 3; j < 6; j++)
+				mLinearDofs.push_back(idx + j);
+		} else if(dynamic_cast<dart::dynamics::BallJoint*>(jn) != nullptr) {
+			mRotationDofs.push_back(idx);
+		} else {
+			for(int j = 0; j < jn->getNumDofs(); j++)
+				mLinearDofs.push_back(idx + j);
+		}
+	}
+}
+PoseTrajectory::
+PoseTrajectory(PoseLayout* layout)
+{
+	mLayout = layout;
+	this->Resize(0);
+}
+void
+PoseTrajectory::
+Resize(int frames)
+{
+	int n_rot = mLayout->GetNumRotations();
+	mW.resize(frames, n_rot);
+	mX.resize(frames, n_rot);
+	mY.resize(frames, n_rot);
+	mZ.resize(frames, n_rot);
+	mLinear.resize(frames, mLayout->GetNumLinear());
+}
+void
+PoseTrajectory::
+FromPositions(const std::vector<Eigen::VectorXd>& pos)
+{
+	Eigen::MatrixXd m(pos.size(), mLayout->GetDof());
+	for(int i = 0; i < pos.size(); i++)
+		m.row(i) = pos[i].head(mLayout->GetDof()).transpose();
+	this->FromPositions(m);
+}
+void
+PoseTrajectory::
+FromPositions(const Eigen::MatrixXd& pos)
+{
+	int frames = pos.rows();
+	const std::vector<int>& rot = mLayout->GetRotationDofs();
+	const std::vector<int>& lin = mLayout->GetLinearDofs();
+	this->Resize(frames);
+
+	Arr x(frames, rot.size()), y(frames, rot.size()), z(frames, rot.size());
+	for(int j = 0; j < rot.size(); j++) {
+		x.col(j) = pos.col(rot[j]).array();
+		y.col(j) = pos.col(rot[j] + 1).array();
+		z.col(j) = pos.col(rot[j] + 2).array();
+	}
+	ExpToQuaternion(x, y, z, mW, mX, mY, mZ);
+	for(int j = 0; j < lin.size(); j++)
+		mLinear.col(j) = pos.col(lin[j]).array();
+}
+void
+PoseTrajectory::
+ToExp(Arr& x, Arr& y, Arr& z) const
+{
+	QuaternionToExp(mW, mX, mY, mZ, x, y, z);
+}
+void
+PoseTrajectory::
+ToPositions(Eigen::MatrixXd& pos) const
+{
+	const std::vector<int>& rot = mLayout->GetRotationDofs();
+	const std::vector<int>& lin = mLayout->GetLinearDofs();
+	pos.resize(this->GetNumFrames(), mLayout->GetDof());
+
+	Arr x, y, z;
+	this->ToExp(x, y, z);
+	for(int j = 0; j < rot.size(); j++) {
+		pos.col(rot[j]) = x.col(j).matrix();
+		pos.col(rot[j] + 1) = y.col(j).matrix();
+		pos.col(rot[j] + 2) = z.col(j).matrix();
+	}
+	for(int j = 0; j < lin.size(); j++)
+		pos.col(lin[j]) = mLinear.col(j).matrix();
+}
+void
+PoseTrajectory::
+ToPositions(std::vector<Eigen::VectorXd>& pos) const
+{
+	Eigen::MatrixXd m;
+	this->ToPositions(m);
+	pos.resize(m.rows());
+	for(int i = 0; i < m.rows(); i++)
+		pos[i] = m.row(i).transpose();
+}
+void
+PoseTrajectory::
+Slerp(const PoseTrajectory& a, const PoseTrajectory& b, const Eigen::ArrayXd& weight, PoseTrajectory& out)
+{
+	int frames = a.GetNumFrames();
+	int n_rot = a.mW.cols();
+	out.Resize(frames);
+
+	// same weights as Eigen::Quaterniond::slerp
+	Arr t = weight.replicate(1, n_rot);
+	Arr d = a.mW*b.mW + a.mX*b.mX + a.mY*b.mY + a.mZ*b.mZ;
+	Arr abs_d = d.abs();
+	Arr theta = abs_d.min(1.0).acos();
+	Arr sin_theta = theta.sin();
+	Eigen::Array<bool, Eigen::Dynamic, Eigen::Dynamic> near = abs_d >= 1.0 - std::numeric_limits<double>::epsilon();
+	sin_theta = near.select(1.0, sin_theta);
+	Arr s0 = near.select(1.0 - t, ((1.0 - t) * theta).sin() / sin_theta);
+	Arr s1 = near.select(t, (t * theta).sin() / sin_theta);
+	s1 = (d < 0).select(-s1, s1);
+
+	out.mW = s0*a.mW + s1*b.mW;
+	out.mX = s0*a.mX + s1*b.mX;
+	out.mY = s0*a.mY + s1*b.mY;
+	out.mZ = s0*a.mZ + s1*b.mZ;
+	Arr n = (out.mW*out.mW + out.mX*out.mX + out.mY*out.mY + out.mZ*out.mZ).sqrt();
+	out.mW /= n;
+	out.mX /= n;
+	out.mY /= n;
+	out.mZ /= n;
+
+	Arr t_lin = weight.replicate(1, a.mLinear.cols());
+	out.mLinear = (1.0 - t_lin) * a.mLinear + t_lin * b.mLinear;
+}
+void
+PoseTrajectory::
+Compose(const PoseTrajectory& a, const PoseTrajectory& b, PoseTrajectory& out)
+{
+	out.Resize(a.GetNumFrames());
+	out.mW = a.mW*b.mW - a.mX*b.mX - a.mY*b.mY - a.mZ*b.mZ;
+	out.mX = a.mW*b.mX + a.mX*b.mW + a.mY*b.mZ - a.mZ*b.mY;
+	out.mY = a.mW*b.mY - a.mX*b.mZ + a.mY*b.mW + a.mZ*b.mX;
+	out.mZ = a.mW*b.mZ + a.mX*b.mY - a.mY*b.mX + a.mZ*b.mW;
+	out.mLinear = a.mLinear + b.mLinear;
+}
+void
+PoseTrajectory::
+LogDifference(const PoseTrajectory& a, const PoseTrajectory& b, Eigen::MatrixXd& out)
+{
+	// conj(b) * a
+	PoseTrajectory d(a.mLayout);
+	d.Resize(a.GetNumFrames());
+	d.mW = b.mW*a.mW + b.mX*a.mX + b.mY*a.mY + b.mZ*a.mZ;
+	d.mX = b.mW*a.mX - a.mW*b.mX - (b.mY*a.mZ - b.mZ*a.mY);
+	d.mY = b.mW*a.mY - a.mW*b.mY - (b.mZ*a.mX - b.mX*a.mZ);
+	d.mZ = b.mW*a.mZ - a.mW*b.mZ - (b.mX*a.mY - b.mY*a.mX);
+	d.mLinear = a.mLinear - b.mLinear;
+	d.ToPositions(out);
+}
+}
@@ -0,0 +1,68 @@
+#ifndef __DEEP_PHYSICS_POSE_H__
+#define __DEEP_PHYSICS_POSE_H__
+#include "dart/dart.hpp"
+#include <vector>
+namespace DPhy
+{
+/**
+*
+* @brief Split of the skeleton dofs into rotations and linear dofs.
+* @details Ball joints and the rotation of free joints are stored as quaternions, the translation of free joints and
+* every other dof are blended and composed linearly.
+*
+*/
+class PoseLayout
+{
+public:
+	PoseLayout(const dart::dynamics::SkeletonPtr& skel);
+
+	int GetDof() { return mDof; }
+	int GetNumRotations() { return mRotationDofs.size(); }
+	int GetNumLinear() { return mLinearDofs.size(); }
+	// first dof of the exponential coordinates of each rotation
+	const std::vector<int>& GetRotationDofs() { return mRotationDofs; }
+	const std::vector<int>& GetLinearDofs() { return mLinearDofs; }
+private:
+	int mDof;
+	std::vector<int> mRotationDofs;
+	std::vector<int> mLinearDofs;
+};
+/**
+*
+* @brief Trajectory of poses stored as packed quaternions.
+* @details Each quaternion component is a frames x rotations array, so slerp, composition and log differences run
+* over every joint of every frame at once. DART positions (exponential coordinates) are only converted in
+* FromPositions and ToPositions. The batched operations give the same result as BlendPosition, Rotate3dVector and
+* JointPositionDifferences applied frame by frame.
+*
+*/
+class PoseTrajectory
+{
+public:
+	PoseTrajectory(PoseLayout* layout);
+
+	void FromPositions(const std::vector<Eigen::VectorXd>& pos);
+	// frames x dof
+	void FromPositions(const Eigen::MatrixXd& pos);
+	void ToPositions(std::vector<Eigen::VectorXd>& pos) const;
+	void ToPositions(Eigen::MatrixXd& pos) const;
+	int GetNumFrames() const { return mLinear.rows(); }
+
+	// frame i of out is slerp(a_i, b_i, weight_i) with linear dofs interpolated, as BlendPosition(a_i, b_i, weight_i)
+	static void Slerp(const PoseTrajectory& a, const PoseTrajectory& b, const Eigen::ArrayXd& weight, PoseTrajectory& out);
+	// frame i of out is a_i * b_i with linear dofs added, as Rotate3dVector(a_i, b_i) per joint
+	static void Compose(const PoseTrajectory& a, const PoseTrajectory& b, PoseTrajectory& out);
+	// row i of out is log(conj(b_i) * a_i) with linear dofs subtracted, as JointPositionDifferences(a_i, b_i) per joint
+	static void LogDifference(const PoseTrajectory& a, const PoseTrajectory& b, Eigen::MatrixXd& out);
+
+	Eigen::ArrayXXd mW, mX, mY, mZ;
+	Eigen::ArrayXXd mLinear;
+private:
+	void Resize(int frames);
+	// exponential coordinates of every rotation, frames x rotations each
+	void ToExp(Eigen::ArrayXXd& x, Eigen::ArrayXXd& y, Eigen::ArrayXXd& z) const;
+
+	PoseLayout* mLayout;
+};
+}
+#endif
@@ -0,0 +1,168 @@
+#include "PositionDifference.h"
+#include "Functions.h"
+namespace DPhy
+{
+// n x 1, the layout of the shared element-wise quaternion helpers
+typedef Eigen::ArrayXXd Arr;
+
+// log map of the relative rotation conj(a) * b
+static void
+RelativeLogMap(const Arr& aw, const Arr& ax, const Arr& ay, const Arr& az,
+			   const Arr& bw, const Arr& bx, const Arr& by, const Arr& bz,
+			   Eigen::Ref<Eigen::MatrixXd> out)
+{
+	Arr w = aw*bw + ax*bx + ay*by + az*bz;
+	Arr x = aw*bx - bw*ax - (ay*bz - az*by);
+	Arr y = aw*by - bw*ay - (az*bx - ax*bz);
+	Arr z = aw*bz - bw*az - (ax*by - ay*bx);
+
+	Arr ex, ey, ez;
+	QuaternionToExp(w, x, y, z, ex, ey, ez);
+	out.col(0) = ex.matrix();
+	out.col(1) = ey.matrix();
+	out.col(2) = ez.matrix();
+}
+static Eigen::Quaterniond
+ExpToQuaternion(const Eigen::Vector3d& v)
+{
+	double angle = v.norm();
+	if(angle < 1e-8)
+		return Eigen::Quaterniond(1.0, 0.5*v[0], 0.5*v[1], 0.5*v[2]).normalized();
+	return Eigen::Quaterniond(Eigen::AngleAxisd(angle, v / angle));
+}
+static Eigen::Vector3d
+LogMap(Eigen::Quaterniond q)
+{
+	if(q.w() < 0)
+		q.coeffs() *= -1;
+	double nv = q.vec().norm();
+	if(nv < 1e-8)
+		return 2.0 / q.w() * q.vec();
+	return 2.0 * std::atan2(nv, q.w()) / nv * q.vec();
+}
+static double
+WrapAngle(double v)
+{
+	if(v > M_PI)
+		return v - 2*M_PI;
+	else if(v < -M_PI)
+		return v + 2*M_PI;
+	return v;
+}
+PositionDifference::
+PositionDifference(const dart::dynamics::SkeletonPtr& skel)
+{
+	mDof = skel->getNumDofs();
+	for(int i = 0; i < skel->getNumJoints(); i++) {
+		dart::dynamics::Joint* jn = skel->getJoint(i);
+		if(jn->getNumDofs() == 0)
+			continue;
+		int idx = jn->getIndexInSkeleton(0);
+		if(dynamic_cast<dart::dynamics::FreeJoint*>(jn) != nullptr)
+			mFreeDofs.push_back(idx);
+		else if(dynamic_cast<dart::dynamics::BallJoint*>(jn) != nullptr)
+			mBallDofs.push_back(idx);
+		else if(dynamic_cast<dart::dynamics::RevoluteJoint*>(jn) != nullptr)
+			mRevoluteDofs.push_back(idx);
+		else {
+			for(int j = 0; j < jn->getNumDofs(); j++)
+				mLinearDofs.push_back(idx + j);
+		}
+	}
+}
+Eigen::VectorXd
+PositionDifference::
+Compute(const Eigen::VectorXd& q2, const Eigen::VectorXd& q1)
+{
+	Eigen::VectorXd ret(mDof);
+	for(int i = 0; i < mBallDofs.size(); i++) {
+		int idx = mBallDofs[i];
+		Eigen::Quaterniond a = ExpToQuaternion(q1.segment<3>(idx));
+		Eigen::Quaterniond b = ExpToQuaternion(q2.segment<3>(idx));
+		ret.segment<3>(idx) = LogMap(a.conjugate() * b);
+	}
+	for(int i = 0; i < mFreeDofs.size(); i++) {
+		int idx = mFreeDofs[i];
+		Eigen::Quaterniond a = ExpToQuaternion(q1.segment<3>(idx));
+		Eigen::Quaterniond b = ExpToQuaternion(q2.segment<3>(idx));
+		ret.segment<3>(idx) = LogMap(a.conjugate() * b);
+		ret.segment<3>(idx + 3) = a.conjugate() * Eigen::Vector3d(q2.segment<3>(idx + 3) - q1.segment<3>(idx + 3));
+	}
+	for(int i = 0; i < mRevoluteDofs.size(); i++) {
+		int idx = mRevoluteDofs[i];
+		ret[idx] = WrapAngle(q2[idx] - q1[idx]);
+	}
+	for(int i = 0; i < mLinearDofs.size(); i++) {
+		int idx = mLinearDofs[i];
+		ret[idx] = q2[idx] - q1[idx];
+	}
+	return ret;
+}
+void
+PositionDifference::
+ComputeBatch(const Eigen::MatrixXd& q2, const Eigen::MatrixXd& q1, Eigen::MatrixXd& out)
+{
+	int n = q1.rows();
+	out.resize(n, mDof);
+
+	Arr aw, ax, ay, az, bw, bx, by, bz;
+	for(int i = 0; i < mBallDofs.size(); i++) {
+		int idx = mBallDofs[i];
+		ExpToQuaternion(q1.col(idx).array(), q1.col(idx+1).array(), q1.col(idx+2).array(), aw, ax, ay, az);
+		ExpToQuaternion(q2.col(idx).array(), q2.col(idx+1).array(), q2.col(idx+2).array(), bw, bx, by, bz);
+		RelativeLogMap(aw, ax, ay, az, bw, bx, by, bz, out.middleCols(idx, 3));
+	}
+	for(int i = 0; i < mFreeDofs.size(); i++) {
+		int idx = mFreeDofs[i];
+		ExpToQuaternion(q1.col(idx).array(), q1.col(idx+1).array(), q1.col(idx+2).array(), aw, ax, ay, az);
+		ExpToQuaternion(q2.col(idx).array(), q2.col(idx+1).array(), q2.col(idx+2).array(), bw, bx, by, bz);
+		RelativeLogMap(aw, ax, ay, az, bw, bx, by, bz, out.middleCols(idx, 3));
+
+		// rotate the translation difference by conj(a): d + 2w(u x d) + 2u x (u x d) with u = -a.vec
+		Arr dx = q2.col(idx+3).array() - q1.col(idx+3).array();
+		Arr dy = q2.col(idx+4).array() - q1.col(idx+4).array();
+		Arr dz = q2.col(idx+5).array() - q1.col(idx+5).array();
+		Arr cx = -(ay*dz - az*dy);
+		Arr cy = -(az*dx - ax*dz);
+		Arr cz = -(ax*dy - ay*dx);
+		out.col(idx+3) = dx + 2.0*aw*cx - 2.0*(ay*cz - az*cy);
+		out.col(idx+4) = dy + 2.0*aw*cy - 2.0*(az*cx - ax*cz);
+		out.col(idx+5) = dz + 2.0*aw*cz - 2.0*(ax*cy - ay*cx);
+	}
+	for(int i = 0; i < mRevoluteDofs.size(); i++) {
+		int idx = mRevoluteDofs[i];
+		Arr d = q2.col(idx).array() - q1.col(idx).array();
+		d = (d > M_PI).select(d - 2*M_PI, d);
+		d = (d < -M_PI).select(d + 2*M_PI, d);
+		out.col(idx) = d;
+	}
+	for(int i = 0; i < mLinearDofs.size(); i++) {
+		int idx = mLinearDofs[i];
+		out.col(idx) = q2.col(idx) - q1.col(idx);
+	}
+}
+std::vector<Eigen::VectorXd>
+PositionDifference::
+ComputeVelocities(const std::vector<Eigen::VectorXd>& pos, double scale)
+{
+	int n = pos.size();
+	std::vector<Eigen::VectorXd> vel;
+	if(n < 2) {
+		vel.resize(n, Eigen::VectorXd::Zero(mDof));
+		return vel;
+	}
+	Eigen::MatrixXd q1(n - 1, mDof), q2(n - 1, mDof), out;
+	for(int i = 0; i < n - 1; i++) {
+		q1.row(i) = pos[i].transpose();
+		q2.row(i) = pos[i + 1].transpose();
+	}
+	this->ComputeBatch(q2, q1, out);
+	out *= scale;
+
+	vel.resize(n);
+	for(int i = 0; i < n - 1; i++)
+		vel[i] = out.row(i).transpose();
+	vel[n - 1] = vel.front();
+	return vel;
+}
+}
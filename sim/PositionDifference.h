@@ -0,0 +1,33 @@
+#ifndef __DEEP_PHYSICS_POSITION_DIFFERENCE_H__
+#define __DEEP_PHYSICS_POSITION_DIFFERENCE_H__
+#include "dart/dart.hpp"
+#include <vector>
+namespace DPhy
+{
+/**
+*
+* @brief Position difference kernels of a skeleton.
+* @details Same result as Skeleton::getPositionDifferences (log map of R1^T R2 for ball and free joints, root
+* translation in the frame of q1), with revolute dofs wrapped into [-pi, pi]. Joint types are classified once, and the
+* batched version works column by column on a frames x dof matrix so the whole trajectory is done in one pass.
+*
+*/
+class PositionDifference
+{
+public:
+	PositionDifference(const dart::dynamics::SkeletonPtr& skel);
+
+	Eigen::VectorXd Compute(const Eigen::VectorXd& q2, const Eigen::VectorXd& q1);
+	// row i of out is Compute(q2.row(i), q1.row(i)), inputs are frames x dof
+	void ComputeBatch(const Eigen::MatrixXd& q2, const Eigen::MatrixXd& q1, Eigen::MatrixXd& out);
+	// velocities of a trajectory: row i is Compute(pos[i+1], pos[i]) * scale, the last row repeats the first
+	std::vector<Eigen::VectorXd> ComputeVelocities(const std::vector<Eigen::VectorXd>& pos, double scale);
+private:
+	int mDof;
+	std::vector<int> mFreeDofs;
+	std::vector<int> mBallDofs;
+	std::vector<int> mRevoluteDofs;
+	std::vector<int> mLinearDofs;
+};
+}
+#endif
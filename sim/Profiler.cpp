@@ -0,0 +1,24 @@
+#include "Profiler.h"
+namespace DPhy
+{
+static const char* PROFILE_STAGE_NAMES[NUM_PROFILE_STAGES] = {
+	"simulation", "motion", "reward", "terminal", "state", "trajectory"
+};
+const char*
+StageProfile::
+GetName(ProfileStage stage)
+{
+	return PROFILE_STAGE_NAMES[stage];
+}
+void
+StageProfile::
+Clear()
+{
+	for(int i = 0; i < NUM_PROFILE_STAGES; i++) {
+		mTotal[i] = 0;
+		mCount[i] = 0;
+		for(int j = 0; j < PROFILE_NUM_BINS; j++)
+			mHistogram[i][j] = 0;
+	}
+}
+}
@@ -0,0 +1,69 @@
+#ifndef __DEEP_PHYSICS_PROFILER_H__
+#define __DEEP_PHYSICS_PROFILER_H__
+#include <chrono>
+#define PROFILE_NUM_BINS 20
+namespace DPhy
+{
+// stages of Controller::Step that are timed
+enum ProfileStage
+{
+	PROFILE_SIMULATION,
+	PROFILE_MOTION,
+	PROFILE_REWARD,
+	PROFILE_TERMINAL,
+	PROFILE_STATE,
+	PROFILE_TRAJECTORY,
+	NUM_PROFILE_STAGES
+};
+/**
+*
+* @brief Accumulated time of each stage.
+* @details Keeps the total, the number of calls and a histogram with power of two bins in microseconds (bin 0 is
+* below 1us, bin k is [2^(k-1), 2^k) us, the last bin also takes everything longer). Each controller owns one and
+* is stepped by one thread at a time, so adding needs no synchronization.
+*
+*/
+class StageProfile
+{
+public:
+	StageProfile() { Clear(); }
+
+	static const char* GetName(ProfileStage stage);
+
+	void Add(ProfileStage stage, double seconds)
+	{
+		mTotal[stage] += seconds;
+		mCount[stage] += 1;
+		int bin = 0;
+		for(double us = seconds * 1e6; us >= 1.0 && bin < PROFILE_NUM_BINS - 1; us *= 0.5)
+			bin += 1;
+		mHistogram[stage][bin] += 1;
+	}
+	void Clear();
+
+	double GetTotal(ProfileStage stage) { return mTotal[stage]; }
+	long GetCount(ProfileStage stage) { return mCount[stage]; }
+	long GetHistogram(ProfileStage stage, int bin) { return mHistogram[stage][bin]; }
+private:
+	double mTotal[NUM_PROFILE_STAGES];
+	long mCount[NUM_PROFILE_STAGES];
+	long mHistogram[NUM_PROFILE_STAGES][PROFILE_NUM_BINS];
+};
+// adds the time until the end of the scope to a stage
+class ProfileScope
+{
+public:
+	ProfileScope(StageProfile& profile, ProfileStage stage)
+	:mProfile(profile), mStage(stage), mStart(std::chrono::steady_clock::now()) {}
+	~ProfileScope()
+	{
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - mStart;
+		mProfile.Add(mStage, elapsed.count());
+	}
+private:
+	StageProfile& mProfile;
+	ProfileStage mStage;
+	std::chrono::steady_clock::time_point mStart;
+};
+}
+#endif
@@ -12,6 +12,7 @@ ReferenceManager::ReferenceManager(Character* character)
 {
 	mCharacter = character;
 	mBlendingInterval = 3;
+	mMotionVersion = 0;
 	
 	mMotions_gen.clear();
 	mMotions_raw.clear();
@@ -20,6 +21,27 @@ ReferenceManager::ReferenceManager(Character* character)
 	auto& skel = mCharacter->GetSkeleton();
 	mDOF = skel->getPositions().rows();
 
+	mRegressionMemory = nullptr;
+	mBVHWriter = nullptr;
+	mFootLock = true;
+	mIKSolver = nullptr;
+	mTrajectoryQueue = new AsyncQueue<TrajectoryJob>([this](TrajectoryJob& job) { this->ProcessTrajectory(job); });
+}
+ReferenceManager::
+~ReferenceManager()
+{
+	delete mTrajectoryQueue;
+	delete mBVHWriter;
+	delete mIKSolver;
+}
+void
+ReferenceManager::
+WaitTrajectories()
+{
+	mTrajectoryQueue->Wait();
+	// nothing is inserting now, params replaced since the last wait can be freed
+	if(mRegressionMemory != nullptr)
+		mRegressionMemory->ReleaseRetired();
 }
 void 
 ReferenceManager::
@@ -113,6 +135,8 @@ LoadMotionFromBVH(std::string filename)
 	std::string path = std::string(CAR_DIR) + filename;
 	bvh->Parse(path);
 	mHierarchyStr = bvh->GetHierarchyStr(); 
+	delete mBVHWriter;
+	mBVHWriter = new BVHWriter(mCharacter->GetSkeleton(), mCharacter->GetBVHMap(), bvh->GetRootName(), mHierarchyStr);
 	std::cout << "load trained data from: " << path << std::endl;
 
 	std::vector<std::string> contact;
@@ -121,6 +145,7 @@ LoadMotionFromBVH(std::string filename)
 	contact.push_back("RightFoot");
 	contact.push_back("LeftToe");
 	contact.push_back("LeftFoot");
+	mContactBodies = contact;
 
 	auto& skel = mCharacter->GetSkeleton();
 	int dof = skel->getPositions().rows();
@@ -166,25 +191,6 @@ LoadMotionFromBVH(std::string filename)
 		}
 
 		p.block<3,1>(3,0) = bvh->GetRootCOM(); 
-		Eigen::VectorXd v;
-
-		if(t != 0)
-		{
-			v = skel->getPositionDifferences(p, mMotions_raw.back()->GetPosition()) / 0.033;
-			for(auto& jn : skel->getJoints()){
-				if(dynamic_cast<dart::dynamics::RevoluteJoint*>(jn)!=nullptr){
-					double v_ = v[jn->getIndexInSkeleton(0)];
-					if(v_ > M_PI){
-						v_ -= 2*M_PI;
-					}
-					else if(v_ < -M_PI){
-						v_ += 2*M_PI;
-					}
-					v[jn->getIndexInSkeleton(0)] = v_;
-				}
-			}
-			mMotions_raw.back()->SetVelocity(v);
-		}
 		mMotions_raw.push_back(new Motion(p, Eigen::VectorXd(p.rows())));
 		
 		skel->setPositions(p);
@@ -200,7 +206,12 @@ LoadMotionFromBVH(std::string filename)
 		t += bvh->GetTimeStep();
 	}
 
-	mMotions_raw.back()->SetVelocity(mMotions_raw.front()->GetVelocity());
+	std::vector<Eigen::VectorXd> pos;
+	for(int i = 0; i < mMotions_raw.size(); i++)
+		pos.push_back(mMotions_raw[i]->GetPosition());
+	std::vector<Eigen::VectorXd> vel = this->GetVelocityFromPositions(pos);
+	for(int i = 0; i < mMotions_raw.size(); i++)
+		mMotions_raw[i]->SetVelocity(vel[i]);
 
 	mPhaseLength = mMotions_raw.size();
 	mTimeStep = bvh->GetTimeStep();
@@ -223,33 +234,99 @@ LoadMotionFromBVH(std::string filename)
 	}
 	this->GenerateMotionsFromSinglePhase(1000, false, mMotions_phase_adaptive, mMotions_gen_adaptive);
 }
-std::vector<Eigen::VectorXd> 
+void
 ReferenceManager::
-GetVelocityFromPositions(std::vector<Eigen::VectorXd> pos)
+LockFootContacts(std::vector<Motion*>& p_gen)
 {
-	std::vector<Eigen::VectorXd> vel;
-	auto skel = mCharacter->GetSkeleton();
-	for(int i = 0; i < pos.size() - 1; i++) {
+	auto& skel = mCharacter->GetSkeleton();
+	int num_contacts = mContactBodies.size();
+	int n = p_gen.size();
+	if(mIKSolver == nullptr) {
+		mIKSolver = new IKSolver(skel);
+		for(int j = 0; j < num_contacts; j++)
+			mIKSolver->AddConstraint(mContactBodies[j], Eigen::Vector3d::Zero());
+	}
+	Eigen::VectorXd v_save = skel->getVelocities();
+
+	// every contact body is held at its position of the first frame of each contact of the reference
+	std::vector<Eigen::VectorXd> pos(n);
+	std::vector<std::vector<Eigen::Vector3d>> targets(n, std::vector<Eigen::Vector3d>(num_contacts));
+	std::vector<std::vector<bool>> active(n, std::vector<bool>(num_contacts, false));
+	for(int i = 0; i < n; i++) {
+		pos[i] = p_gen[i]->GetPosition();
 		skel->setPositions(pos[i]);
 		skel->computeForwardKinematics(true,false,false);
-		Eigen::VectorXd v = skel->getPositionDifferences(pos[i + 1], pos[i]) / 0.033;
-		for(auto& jn : skel->getJoints()){
-			if(dynamic_cast<dart::dynamics::RevoluteJoint*>(jn)!=nullptr){
-				double v_ = v[jn->getIndexInSkeleton(0)];
-				if(v_ > M_PI){
-					v_ -= 2*M_PI;
-				}
-				else if(v_ < -M_PI){
-					v_ += 2*M_PI;
+
+		const std::vector<bool>& contact = mContacts[i % mPhaseLength];
+		for(int j = 0; j < num_contacts; j++) {
+			active[i][j] = contact[j];
+			if(contact[j] && i != 0 && active[i-1][j])
+				targets[i][j] = targets[i-1][j];
+			else
+				targets[i][j] = skel->getBodyNode(mContactBodies[j])->getWorldTransform().translation();
+		}
+	}
+	std::vector<Eigen::VectorXd> locked_pos = pos;
+	mIKSolver->SolveSequence(locked_pos, targets, active);
+
+	// corrections of the stance legs, faded in and out over mBlendingInterval frames around each contact
+	// so the swing leg does not jump when a lock is released
+	std::vector<Eigen::VectorXd> correction(n);
+	std::vector<std::vector<bool>> locked(n, std::vector<bool>(mDOF, false));
+	for(int i = 0; i < n; i++) {
+		correction[i] = skel->getPositionDifferences(locked_pos[i], pos[i]);
+		for(int j = 0; j < num_contacts; j++) {
+			if(!active[i][j])
+				continue;
+			const std::vector<int>& dofs = mIKSolver->GetChainDofs(j);
+			for(int k = 0; k < dofs.size(); k++)
+				locked[i][dofs[k]] = true;
+		}
+	}
+	for(int i = 0; i < n; i++) {
+		Eigen::VectorXd faded = correction[i];
+		bool changed = false;
+		for(int d = 0; d < mDOF; d++) {
+			if(locked[i][d])
+				continue;
+			faded[d] = 0;
+			for(int s = 1; s <= mBlendingInterval; s++) {
+				int nearest = -1;
+				if(i - s >= 0 && locked[i-s][d])
+					nearest = i - s;
+				else if(i + s < n && locked[i+s][d])
+					nearest = i + s;
+				if(nearest != -1) {
+					faded[d] = (1.0 - s / (double)(mBlendingInterval + 1)) * correction[nearest][d];
+					changed = true;
+					break;
 				}
-				v[jn->getIndexInSkeleton(0)] = v_;
 			}
 		}
-		vel.push_back(v);
+		if(!changed) {
+			pos[i] = locked_pos[i];
+			continue;
+		}
+		skel->setPositions(pos[i]);
+		skel->setVelocities(faded);
+		skel->integratePositions(1.0);
+		pos[i] = skel->getPositions();
 	}
-	vel.push_back(vel.front());
+	skel->setVelocities(v_save);
 
-	return vel;
+	for(int i = 0; i < n; i++) {
+		p_gen[i]->SetPosition(pos[i]);
+		if(i != 0)
+			p_gen[i-1]->SetVelocity(skel->getPositionDifferences(pos[i], pos[i-1]) / 0.033);
+	}
+	if(n > 1)
+		p_gen.back()->SetVelocity(p_gen[n-2]->GetVelocity());
+}
+std::vector<Eigen::VectorXd> 
+ReferenceManager::
+GetVelocityFromPositions(std::vector<Eigen::VectorXd> pos)
+{
+	return mCharacter->GetPositionDifference()->ComputeVelocities(pos, 1.0 / 0.033);
 }
 void 
 ReferenceManager::
@@ -345,6 +422,9 @@ GenerateMotionsFromSinglePhase(int frames, bool blend, std::vector<Motion*>& p_p
 			}
 		}
 	}
+	if(mFootLock)
+		this->LockFootContacts(p_gen);
+	mMotionVersion += 1;
 	mLock.unlock();
 
 }
@@ -374,6 +454,16 @@ GetPosition(double t , bool adaptive)
 	else
 		return DPhy::BlendPosition((*p_gen)[k1]->GetPosition(), (*p_gen)[k0]->GetPosition(), 1 - (t-k0));	
 }
+Eigen::VectorXd
+ReferenceManager::
+GetPhasePosition(double t)
+{
+	int k0 = (int) std::floor(t);
+	int k1 = std::min((int) std::ceil(t), (int)mMotions_phase.size() - 1);
+	if(k0 >= k1)
+		return mMotions_phase[k1]->GetPosition();
+	return DPhy::BlendPosition(mMotions_phase[k1]->GetPosition(), mMotions_phase[k0]->GetPosition(), 1 - (t-k0));
+}
 Motion*
 ReferenceManager::
 GetMotion(double t, bool adaptive)
@@ -519,6 +609,19 @@ SaveTrajectories(std::vector<std::pair<Eigen::VectorXd,double>> data_raw,
 	if(dart::math::isNan(std::get<0>(rewards)) || dart::math::isNan(std::get<1>(rewards))) {
 		return;
 	}
+	TrajectoryJob job;
+	job.data_raw = std::move(data_raw);
+	job.rewards = rewards;
+	job.parameters = parameters;
+	mTrajectoryQueue->Push(std::move(job));
+}
+void 
+ReferenceManager::
+ProcessTrajectory(TrajectoryJob& job) {
+	std::vector<std::pair<Eigen::VectorXd,double>>& data_raw = job.data_raw;
+	std::tuple<double, double, Fitness>& rewards = job.rewards;
+	Eigen::VectorXd& parameters = job.parameters;
+
 	mMeanTrackingReward = 0.99 * mMeanTrackingReward + 0.01 * std::get<0>(rewards);
 	mMeanParamReward = 0.99 * mMeanParamReward + 0.01 * std::get<1>(rewards);
 
@@ -540,53 +643,74 @@ SaveTrajectories(std::vector<std::pair<Eigen::VectorXd,double>> data_raw,
 		data_raw[i].first = trajectory[i];
 	}
 
-	std::vector<std::pair<Eigen::VectorXd,double>> data_uniform;
+	// resample to one frame per phase step; the blends of every frame are done in one batch
+	std::vector<Eigen::VectorXd> blend_a(mPhaseLength), blend_b(mPhaseLength);
+	Eigen::ArrayXd blend_weight(mPhaseLength);
+	std::vector<int> root_from(mPhaseLength, -1);
+	std::vector<double> t_blend(mPhaseLength);
 	int count = 0;
 	for(int i = 0; i < mPhaseLength; i++) {
 		while(count + 1 < data_raw.size() && i >= data_raw[count+1].second)
 			count += 1;
-		Eigen::VectorXd p(mDOF + 1);
 
 		if(i < data_raw[count].second) {
 			int size = data_raw.size();
 			double t0 = data_raw[size-1].second - data_raw[size-2].second;
 			double weight = 1.0 - (mPhaseLength + i - data_raw[size-1].second) / (mPhaseLength + data_raw[count].second - data_raw[size-1].second);
 			double t1 = data_raw[count+1].second - data_raw[count].second;
-			Eigen::VectorXd p_blend = DPhy::BlendPosition(data_raw[size-1].first, data_raw[0].first, weight);
-			p_blend.segment<6>(0) = data_raw[0].first.segment<6>(0);
-			double t_blend = (1 - weight) * t0 + weight * t1;
-			p << p_blend, log(t_blend);
+			blend_a[i] = data_raw[size-1].first;
+			blend_b[i] = data_raw[0].first;
+			blend_weight[i] = weight;
+			root_from[i] = 0;
+			t_blend[i] = (1 - weight) * t0 + weight * t1;
 		} else if(count == data_raw.size() - 1 && i > data_raw[count].second) {
 			double t0 = data_raw[count].second - data_raw[count-1].second;
 			double weight = 1.0 - (data_raw[0].second + mPhaseLength - i) / (data_raw[0].second + mPhaseLength - data_raw[count].second);
 			double t1 = data_raw[1].second - data_raw[0].second;
-			
-			Eigen::VectorXd p_blend = DPhy::BlendPosition(data_raw[count].first, data_raw[0].first, weight);
-			p_blend.segment<6>(0) = data_raw[count].first.segment<6>(0);
-
-			double t_blend = (1 - weight) * t0 + weight * t1;
-			p << p_blend, log(t_blend);
+			blend_a[i] = data_raw[count].first;
+			blend_b[i] = data_raw[0].first;
+			blend_weight[i] = weight;
+			root_from[i] = count;
+			t_blend[i] = (1 - weight) * t0 + weight * t1;
 		} else if(i == data_raw[count].second) {
+			blend_a[i] = data_raw[count].first;
+			blend_b[i] = data_raw[count].first;
+			blend_weight[i] = 0;
 			if(count < data_raw.size())
-				p << data_raw[count].first, log(data_raw[count+1].second - data_raw[count].second);
+				t_blend[i] = data_raw[count+1].second - data_raw[count].second;
 			else
-				p << data_raw[count].first, log(data_raw[0].second + mPhaseLength - data_raw[count].second);
-
+				t_blend[i] = data_raw[0].second + mPhaseLength - data_raw[count].second;
 		} else {
 			double weight = 1.0 - (data_raw[count+1].second - i) / (data_raw[count+1].second - data_raw[count].second);
-			Eigen::VectorXd p_blend = DPhy::BlendPosition(data_raw[count].first, data_raw[count+1].first, weight);
-			double t_blend;
+			blend_a[i] = data_raw[count].first;
+			blend_b[i] = data_raw[count+1].first;
+			blend_weight[i] = weight;
 			if(count + 2 >= data_raw.size()) {
 				double t0 = data_raw[count+1].second - data_raw[count].second;
 				double t1 = data_raw[1].second - data_raw[0].second;
-				t_blend = (1 - weight) * t0 + weight * t1;
+				t_blend[i] = (1 - weight) * t0 + weight * t1;
 			} else {
 				double t0 = data_raw[count+1].second - data_raw[count].second;
 				double t1 = data_raw[count+2].second - data_raw[count+1].second;
-				t_blend = (1 - weight) * t0 + weight * t1;
+				t_blend[i] = (1 - weight) * t0 + weight * t1;
 			}
-			p << p_blend, log(t_blend);
 		}
+	}
+
+	PoseLayout* layout = mCharacter->GetPoseLayout();
+	PoseTrajectory pose_a(layout), pose_b(layout), pose_blend(layout);
+	pose_a.FromPositions(blend_a);
+	pose_b.FromPositions(blend_b);
+	PoseTrajectory::Slerp(pose_a, pose_b, blend_weight, pose_blend);
+	std::vector<Eigen::VectorXd> p_blend;
+	pose_blend.ToPositions(p_blend);
+
+	std::vector<std::pair<Eigen::VectorXd,double>> data_uniform;
+	for(int i = 0; i < mPhaseLength; i++) {
+		if(root_from[i] != -1)
+			p_blend[i].segment<6>(0) = data_raw[root_from[i]].first.segment<6>(0);
+		Eigen::VectorXd p(mDOF + 1);
+		p << p_blend[i], log(t_blend[i]);
 		data_uniform.push_back(std::pair<Eigen::VectorXd,double>(p, i));
 	}
 
@@ -620,70 +744,50 @@ SaveTrajectories(std::vector<std::pair<Eigen::VectorXd,double>> data_raw,
 	if(reward_trajectory_th < 0.2)
 		return;
 
-	mLock.lock();
-
 	if(isParametric) {
 		mRegressionMemory->UpdateParamSpace(std::tuple<std::vector<Eigen::VectorXd>, Eigen::VectorXd, double>
 											(d, parameters, reward_trajectory));
 
 	}
-	
-	mLock.unlock();
 
 
 }
 void 
 ReferenceManager::
 AddDisplacementToBVH(std::vector<Eigen::VectorXd> displacement, std::vector<Eigen::VectorXd>& position) {
-	position.clear();
-	int n_bnodes = mCharacter->GetSkeleton()->getNumBodyNodes();
-
+	std::vector<Eigen::VectorXd> p_bvh;
 	for(int i = 0; i < displacement.size(); i++) {
-
-		Eigen::VectorXd p_bvh = mMotions_phase[i]->GetPosition();
-		Eigen::VectorXd d = displacement[i];
-		Eigen::VectorXd p(mCharacter->GetSkeleton()->getNumDofs());
-
-		for(int j = 0; j < n_bnodes; j++) {
-			int idx = mCharacter->GetSkeleton()->getBodyNode(j)->getParentJoint()->getIndexInSkeleton(0);
-			int dof = mCharacter->GetSkeleton()->getBodyNode(j)->getParentJoint()->getNumDofs();
-			if(dof == 6) {
-				p.segment<3>(idx) = Rotate3dVector(p_bvh.segment<3>(idx), d.segment<3>(idx));
-				p.segment<3>(idx + 3) = d.segment<3>(idx + 3) + p_bvh.segment<3>(idx + 3);
-			} else if (dof == 3) {
-				p.segment<3>(idx) = Rotate3dVector(p_bvh.segment<3>(idx), d.segment<3>(idx));
-			} else {
-				p(idx) = d(idx) + p_bvh(idx);
-			}
-		}
-		position.push_back(p);
+		p_bvh.push_back(mMotions_phase[i]->GetPosition());
 	}
+
+	PoseLayout* layout = mCharacter->GetPoseLayout();
+	PoseTrajectory pose_bvh(layout), pose_d(layout), pose(layout);
+	pose_bvh.FromPositions(p_bvh);
+	pose_d.FromPositions(displacement);
+	PoseTrajectory::Compose(pose_bvh, pose_d, pose);
+	pose.ToPositions(position);
 }
 void
 ReferenceManager::
 GetDisplacementWithBVH(std::vector<std::pair<Eigen::VectorXd, double>> position, std::vector<std::pair<Eigen::VectorXd, double>>& displacement) {
 	displacement.clear();
-	int n_bnodes = mCharacter->GetSkeleton()->getNumBodyNodes();
+	std::vector<Eigen::VectorXd> p, p_bvh;
 	for(int i = 0; i < position.size(); i++) {
 		double phase = std::fmod(position[i].second, mPhaseLength);
-		
-		Eigen::VectorXd p = position[i].first;
-		Eigen::VectorXd p_bvh = this->GetPosition(phase);
-		Eigen::VectorXd d(mCharacter->GetSkeleton()->getNumDofs());
-		for(int j = 0; j < n_bnodes; j++) {
-			int idx = mCharacter->GetSkeleton()->getBodyNode(j)->getParentJoint()->getIndexInSkeleton(0);
-			int dof = mCharacter->GetSkeleton()->getBodyNode(j)->getParentJoint()->getNumDofs();
-			
-			if(dof == 6) {
-				d.segment<3>(idx) = JointPositionDifferences(p.segment<3>(idx), p_bvh.segment<3>(idx));
-				d.segment<3>(idx + 3) = p.segment<3>(idx + 3) -  p_bvh.segment<3>(idx + 3);
-			} else if (dof == 3) {
-				d.segment<3>(idx) = JointPositionDifferences(p.segment<3>(idx), p_bvh.segment<3>(idx));
-			} else {
-				d(idx) = p(idx) - p_bvh(idx);
-			}
-		}
-		displacement.push_back(std::pair<Eigen::VectorXd,double>(d, phase));
+		p.push_back(position[i].first);
+		p_bvh.push_back(this->GetPhasePosition(phase));
+	}
+
+	PoseLayout* layout = mCharacter->GetPoseLayout();
+	PoseTrajectory pose(layout), pose_bvh(layout);
+	pose.FromPositions(p);
+	pose_bvh.FromPositions(p_bvh);
+	Eigen::MatrixXd d;
+	PoseTrajectory::LogDifference(pose, pose_bvh, d);
+
+	for(int i = 0; i < position.size(); i++) {
+		double phase = std::fmod(position[i].second, mPhaseLength);
+		displacement.push_back(std::pair<Eigen::VectorXd,double>(d.row(i).transpose(), phase));
 	}
 }
 void 
@@ -7,8 +7,12 @@
 #include "BVH.h"
 #include "MultilevelSpline.h"
 #include "RegressionMemory.h"
+#include "AsyncQueue.h"
+#include "BVHWriter.h"
+#include "IKSolver.h"
 #include <tuple>
 #include <mutex>
+#include <atomic>
 
 namespace DPhy
 {
@@ -47,22 +51,40 @@ protected:
 	Eigen::VectorXd velocity;
 
 };
+// one finished phase of a slave, waiting to be inserted into the regression memory
+struct TrajectoryJob
+{
+	std::vector<std::pair<Eigen::VectorXd,double>> data_raw;
+	std::tuple<double, double, Fitness> rewards;
+	Eigen::VectorXd parameters;
+};
 class ReferenceManager
 {
 public:
 	ReferenceManager(Character* character=nullptr);
+	~ReferenceManager();
 	void SaveAdaptiveMotion(std::string postfix="");
 	void LoadAdaptiveMotion(std::vector<Eigen::VectorXd> cps);
 	void LoadAdaptiveMotion(std::string postfix="");
 	void LoadMotionFromBVH(std::string filename);
 	void GenerateMotionsFromSinglePhase(int frames, bool blend, std::vector<Motion*>& p_phase, std::vector<Motion*>& p_gen);
+	// keep feet in place while they are in contact in generated motions, on by default,
+	// applies to motions generated afterwards
+	void SetFootLock(bool on) { mFootLock = on; }
 	Motion* GetMotion(double t, bool adaptive=false);
 	std::vector<Eigen::VectorXd> GetVelocityFromPositions(std::vector<Eigen::VectorXd> pos); 
 	Eigen::VectorXd GetPosition(double t, bool adaptive=false);
+	// pose of the single phase motion, without foot lock; displacements of the regression memory are taken against it
+	Eigen::VectorXd GetPhasePosition(double t);
 	int GetPhaseLength() {return mPhaseLength; }
+	// changes whenever generated motions are rebuilt, for caches of reference states
+	int GetMotionVersion() {return mMotionVersion; }
 	double GetTimeStep(double t, bool adaptive);
 
+	// queues the trajectory; alignment, resampling and memory insertion run on a background thread
 	void SaveTrajectories(std::vector<std::pair<Eigen::VectorXd,double>> data_raw, std::tuple<double, double, Fitness> rewards, Eigen::VectorXd parameters);
+	// blocks until every queued trajectory is in the regression memory
+	void WaitTrajectories();
 	void InitOptimization(int nslaves, std::string save_path, bool adaptive=false);
 	void AddDisplacementToBVH(std::vector<Eigen::VectorXd> displacement, std::vector<Eigen::VectorXd>& position);
 	void GetDisplacementWithBVH(std::vector<std::pair<Eigen::VectorXd, double>> position, std::vector<std::pair<Eigen::VectorXd, double>>& displacement);
@@ -82,8 +104,13 @@ public:
 	std::vector<Eigen::VectorXd> GetCPSexp() { return mCPS_exp; }
 	void SelectReference();
 	std::vector<std::string> GetHierarchyStr() {return mHierarchyStr; }
+	// writer with the hierarchy of the loaded bvh
+	BVHWriter* GetBVHWriter() {return mBVHWriter; }
 
 protected:
+	void ProcessTrajectory(TrajectoryJob& job);
+	void LockFootContacts(std::vector<Motion*>& p_gen);
+
 	Character* mCharacter;
 	double mTimeStep;
 	int mBlendingInterval;
@@ -93,6 +120,9 @@ protected:
 	std::vector<Motion*> mMotions_phase;
 	std::vector<Motion*> mMotions_phase_adaptive;
 	std::vector<std::vector<bool>> mContacts;
+	std::vector<std::string> mContactBodies;
+	bool mFootLock;
+	IKSolver* mIKSolver;
 	std::vector<Motion*> mMotions_gen;
 	std::vector<Motion*> mMotions_gen_adaptive;
 	std::vector<std::vector<Motion*>> mMotions_gen_temp;
@@ -103,6 +133,7 @@ protected:
 
 	double mSlaves;
 	std::mutex mLock;
+	std::atomic<int> mMotionVersion;
 
 	std::string mPath;
 	
@@ -115,6 +146,7 @@ protected:
 	Eigen::VectorXd mParamEnd;
 
 	RegressionMemory* mRegressionMemory;
+	AsyncQueue<TrajectoryJob>* mTrajectoryQueue;
 	
 	double mMeanTrackingReward;
 	double mMeanParamReward;
@@ -125,6 +157,7 @@ protected:
 	std::mt19937 mMT;
 	std::uniform_real_distribution<double> mUniform;
 	std::vector<std::string> mHierarchyStr;
+	BVHWriter* mBVHWriter;
 
 };
 }
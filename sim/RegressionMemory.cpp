@@ -7,8 +7,87 @@ namespace DPhy
 {
 void
 ParamCube::
+PutParam(Param* p) {
+	std::shared_ptr<std::vector<Param*>> next = std::make_shared<std::vector<Param*>>(*GetSnapshot());
+	next->push_back(p);
+	std::atomic_store(&param, std::shared_ptr<const std::vector<Param*>>(next));
+}
+void
+ParamCube::
 PutParams(std::vector<Param*> ps) {
-	param = ps;
+	std::shared_ptr<const std::vector<Param*>> next = std::make_shared<const std::vector<Param*>>(ps);
+	std::atomic_store(&param, next);
+}
+void
+PackedCPS::
+Encode(const std::vector<Eigen::VectorXd>& cps, CPSEncoding encoding) {
+	mNumKnots = cps.size();
+	mDof = mNumKnots > 0 ? cps[0].rows() : 0;
+	mEncoding = encoding;
+	std::vector<double>().swap(mDouble);
+	std::vector<float>().swap(mFloat);
+	std::vector<uint16_t>().swap(mInt16);
+	std::vector<float>().swap(mOffset);
+	std::vector<float>().swap(mStep);
+
+	int n = mNumKnots * mDof;
+	if(mEncoding == CPS_DOUBLE) {
+		mDouble.resize(n);
+		for(int i = 0; i < mNumKnots; i++)
+			Eigen::Map<Eigen::VectorXd>(mDouble.data() + i * mDof, mDof) = cps[i];
+	} else if(mEncoding == CPS_FLOAT) {
+		mFloat.resize(n);
+		for(int i = 0; i < mNumKnots; i++)
+			Eigen::Map<Eigen::VectorXf>(mFloat.data() + i * mDof, mDof) = cps[i].cast<float>();
+	} else {
+		mInt16.resize(n);
+		mOffset.resize(mDof);
+		mStep.resize(mDof);
+		for(int j = 0; j < mDof; j++) {
+			double lo = cps[0][j];
+			double hi = cps[0][j];
+			for(int i = 1; i < mNumKnots; i++) {
+				lo = std::min(lo, cps[i][j]);
+				hi = std::max(hi, cps[i][j]);
+			}
+			mOffset[j] = lo;
+			mStep[j] = (hi - lo) / 65535.0;
+			for(int i = 0; i < mNumKnots; i++) {
+				double q = mStep[j] > 0 ? std::round((cps[i][j] - mOffset[j]) / mStep[j]) : 0;
+				mInt16[i * mDof + j] = (uint16_t)std::max(0.0, std::min(65535.0, q));
+			}
+		}
+	}
+}
+std::vector<Eigen::VectorXd>
+PackedCPS::
+Decode() const {
+	std::vector<Eigen::VectorXd> cps(mNumKnots, Eigen::VectorXd::Zero(mDof));
+	this->AddWeighted(1.0, cps);
+	return cps;
+}
+void
+PackedCPS::
+AddWeighted(double w, std::vector<Eigen::VectorXd>& out) const {
+	if(mEncoding == CPS_DOUBLE) {
+		for(int i = 0; i < mNumKnots; i++)
+			out[i] += w * Eigen::Map<const Eigen::VectorXd>(mDouble.data() + i * mDof, mDof);
+	} else if(mEncoding == CPS_FLOAT) {
+		for(int i = 0; i < mNumKnots; i++)
+			out[i] += w * Eigen::Map<const Eigen::VectorXf>(mFloat.data() + i * mDof, mDof).cast<double>();
+	} else {
+		typedef Eigen::Matrix<uint16_t, Eigen::Dynamic, 1> VectorXu16;
+		Eigen::VectorXd offset = Eigen::Map<const Eigen::VectorXf>(mOffset.data(), mDof).cast<double>();
+		Eigen::VectorXd step = Eigen::Map<const Eigen::VectorXf>(mStep.data(), mDof).cast<double>();
+		for(int i = 0; i < mNumKnots; i++)
+			out[i] += w * (offset + Eigen::Map<const VectorXu16>(mInt16.data() + i * mDof, mDof).cast<double>().cwiseProduct(step));
+	}
+}
+size_t
+PackedCPS::
+GetBytes() const {
+	return mDouble.size() * sizeof(double) + mFloat.size() * sizeof(float) + mInt16.size() * sizeof(uint16_t)
+		 + (mOffset.size() + mStep.size()) * sizeof(float);
 }
 bool
 IsEqualParam(Param* p0, Param* p1) {
@@ -16,8 +95,12 @@ IsEqualParam(Param* p0, Param* p1) {
 		return false;
 	if(abs(p0->reward - p1->reward) > 1e-8)
 		return false;
-	for(int i = 0; i < p0->cps.size(); i++) {
-		if((p0->cps[i] - p1->cps[i]).norm() > 1e-8)
+	if(p0 == p1)
+		return true;
+	std::vector<Eigen::VectorXd> cps0 = p0->cps.Decode();
+	std::vector<Eigen::VectorXd> cps1 = p1->cps.Decode();
+	for(int i = 0; i < cps0.size(); i++) {
+		if((cps0[i] - cps1[i]).norm() > 1e-8)
 			return false;
 	}
 
@@ -25,6 +108,72 @@ IsEqualParam(Param* p0, Param* p1) {
 }
 RegressionMemory::
 RegressionMemory() :mRD(), mMT(mRD()), mUniform(0.0, 1.0) {
+	mGridMap = std::make_shared<const ParamGrid>();
+	mCPSEncoding = CPS_DOUBLE;
+}
+void
+RegressionMemory::
+SetCPSEncoding(CPSEncoding encoding) {
+	mCPSEncoding = encoding;
+
+	size_t bytes = 0;
+	int n = 0;
+	std::shared_ptr<const ParamGrid> grid = GetGrid();
+	for(auto iter = grid->begin(); iter != grid->end(); iter++) {
+		std::lock_guard<std::mutex> lock(iter->second->GetLock());
+		std::shared_ptr<const std::vector<Param*>> snapshot = iter->second->GetSnapshot();
+		for(int i = 0; i < snapshot->size(); i++) {
+			Param* p = (*snapshot)[i];
+			if(p->cps.GetEncoding() != encoding)
+				p->cps.Encode(p->cps.Decode(), encoding);
+			bytes += p->cps.GetBytes();
+			n += 1;
+		}
+	}
+	std::cout << "control point encoding " << encoding << " : " << n << " samples, " << bytes / 1024 << " KB" << std::endl;
+}
+ParamCube*
+RegressionMemory::
+FindCube(const Eigen::VectorXd& idx) {
+	std::shared_ptr<const ParamGrid> grid = GetGrid();
+	auto iter = grid->find(idx);
+	if(iter == grid->end())
+		return nullptr;
+	return iter->second;
+}
+ParamCube*
+RegressionMemory::
+FindOrCreateCube(const Eigen::VectorXd& idx) {
+	ParamCube* pcube = FindCube(idx);
+	if(pcube != nullptr)
+		return pcube;
+
+	std::lock_guard<std::mutex> lock(mGridLock);
+	std::shared_ptr<const ParamGrid> grid = GetGrid();
+	auto iter = grid->find(idx);
+	if(iter != grid->end())
+		return iter->second;
+
+	// copy on write, readers keep iterating the old grid
+	std::shared_ptr<ParamGrid> next = std::make_shared<ParamGrid>(*grid);
+	pcube = new ParamCube(idx);
+	next->insert(std::pair<Eigen::VectorXd, ParamCube*>(idx, pcube));
+	std::atomic_store(&mGridMap, std::shared_ptr<const ParamGrid>(next));
+	return pcube;
+}
+void
+RegressionMemory::
+PushLog(const std::string& log) {
+	std::lock_guard<std::mutex> lock(mLogLock);
+	mRecordLog.push_back(log);
+}
+void
+RegressionMemory::
+ReleaseRetired() {
+	std::lock_guard<std::mutex> lock(mRetiredLock);
+	for(int i = 0; i < mRetired.size(); i++)
+		delete mRetired[i];
+	mRetired.clear();
 }
 void
 RegressionMemory::
@@ -62,16 +211,17 @@ InitParamSpace(Eigen::VectorXd paramBvh, std::pair<Eigen::VectorXd, Eigen::Vecto
 
 	for(int i = 0; i < 2; i++) {
 		mParamBVH = new Param();
-		mParamBVH->cps.clear();
+		std::vector<Eigen::VectorXd> cps_zero;
 		for(int i = 0; i < mNumKnots; i++) {
 			Eigen::VectorXd cps(mDimDOF);
 			cps.setZero();
-			mParamBVH->cps.push_back(cps);
+			cps_zero.push_back(cps);
 		}
+		mParamBVH->cps.Encode(cps_zero, mCPSEncoding);
 
 		mParamBVH->param_normalized = Normalize(paramBvh);
 		mParamBVH->reward = 1;
-		mParamBVH->update = 0;
+		mParamBVH->update.store(0, std::memory_order_relaxed);
 		AddMapping(mParamBVH);
 	}
 
@@ -156,15 +306,18 @@ GetTrainingData() {
 	std::vector<Eigen::VectorXd> x;
 	std::vector<Eigen::VectorXd> y;
 	std::vector<double> r;
-	auto iter = mGridMap.begin();
-	while(iter != mGridMap.end()) {
-		std::vector<Param*> p = iter->second->GetParams();
+	std::shared_ptr<const ParamGrid> grid = GetGrid();
+	auto iter = grid->begin();
+	while(iter != grid->end()) {
+		std::shared_ptr<const std::vector<Param*>> ps = iter->second->GetSnapshot();
+		const std::vector<Param*>& p = *ps;
 		for(int i = 0; i < p.size(); i++) {
+			std::vector<Eigen::VectorXd> cps = p[i]->cps.Decode();
 			for(int j = 0; j < mNumKnots; j++) {
 				Eigen::VectorXd x_elem(mDim + 1);
 				x_elem << j, p[i]->param_normalized;
 				x.push_back(x_elem);
-				y.push_back((p[i]->cps)[j]);
+				y.push_back(cps[j]);
 			}
 			r.push_back(p[i]->reward);
 			mNumSamples += 1;
@@ -173,7 +326,7 @@ GetTrainingData() {
 	}
 	std::cout << "num new data: " << r.size() << std::endl;
 
-	mRecordLog.push_back("save training data: " + std::to_string(r.size()));
+	PushLog("save training data: " + std::to_string(r.size()));
 	return std::tuple<std::vector<Eigen::VectorXd>, 
 					  std::vector<Eigen::VectorXd>, 
 					  std::vector<double>> (x, y, r);
@@ -182,12 +335,10 @@ int
 RegressionMemory::
 GetNumSamples() {
 	int n = 0;
-	auto iter = mGridMap.begin();
-	while(iter != mGridMap.end()) {
-		std::vector<Param*> p = iter->second->GetParams();
-		for(int i = 0; i < p.size(); i++) {
-			n += 1;
-		} 
+	std::shared_ptr<const ParamGrid> grid = GetGrid();
+	auto iter = grid->begin();
+	while(iter != grid->end()) {
+		n += iter->second->GetNumParams();
 		iter++;
 	}
 	return n;
@@ -219,6 +370,7 @@ SaveParamSpace(std::string path) {
 	std::cout << "save param space : " << x.size() / mNumKnots << std::endl;
 
 	ofs.open(path+"_active");
+	std::lock_guard<std::mutex> lock(mActivationLock);
 	auto it = mParamActivated.begin();
 	while(it != mParamActivated.end()) {
 		ofs << it->first.cwiseProduct(mParamGridUnit).transpose() << std::endl;
@@ -257,7 +409,7 @@ LoadParamSpace(std::string path) {
 
 	if(is.fail())
 		return;
-	mGridMap.clear();
+	std::atomic_store(&mGridMap, std::make_shared<const ParamGrid>());
 
 	is >> buffer;
 	mNumSamples = atoi(buffer);
@@ -325,9 +477,9 @@ LoadParamSpace(std::string path) {
 
 		Param* p = new Param();
 		p->param_normalized = param;
-		p->cps = cps;
+		p->cps.Encode(cps, mCPSEncoding);
 		p->reward = reward;
-		p->update = 0;
+		p->update.store(0, std::memory_order_relaxed);
 		AddMapping(p);
 		mloadAllSamples.push_back(p);
 
@@ -347,11 +499,6 @@ LoadParamSpace(std::string path) {
 	std::cout << "num samples: " << mNumSamples << std::endl;
 
 	// std::vector<std::pair<int, Eigen::VectorXd>> stats;
-	auto iter = mParamActivated.begin();
-	while(iter != mParamActivated.end()) {
-		auto it = mGridMap.find(iter->first);
-		iter++;
-	}
 	// std::stable_sort(stats.begin(), stats.end(), cmp);
 	// for(int i = 0; i < stats.size(); i++) {
 	// 	std::cout << stats[i].first << " " << stats[i].second.cwiseProduct(mParamGridUnit).transpose() << std::endl;
@@ -376,6 +523,7 @@ RegressionMemory::
 GetNearestActivatedParam(Eigen::VectorXd p) {
 	double dist = 1e5;
 	Eigen::VectorXd n;
+	std::lock_guard<std::mutex> lock(mActivationLock);
 	auto it = mParamActivated.begin();
 	while(it != mParamActivated.end()) {
 		Eigen::VectorXd n_param = it->first.cwiseProduct(mParamGridUnit);
@@ -443,9 +591,10 @@ GetNeighborParams(Eigen::VectorXd p) {
 	std::vector<Eigen::VectorXd> result;
 	std::vector<Eigen::VectorXd> points = GetNeighborPointsOnGrid(p, mRadiusNeighbor * 1.5);
 	for(int i = 0; i < points.size(); i++) {
-		auto iter = mGridMap.find(points[i]);
-		if(iter != mGridMap.end()) {
-			std::vector<Param*> ps = iter->second->GetParams();
+		ParamCube* pcube = FindCube(points[i]);
+		if(pcube != nullptr) {
+			std::shared_ptr<const std::vector<Param*>> snapshot = pcube->GetSnapshot();
+			const std::vector<Param*>& ps = *snapshot;
 			for(int j = 0; j < ps.size(); j++) {
 				if(GetDistanceNorm(p, ps[j]->param_normalized) <mRadiusNeighbor * 1.5)
 					result.push_back(ps[j]->param_normalized);
@@ -461,14 +610,15 @@ GetNearestParams(Eigen::VectorXd p, int n, bool search_neighbor, bool old, bool
 	if(search_neighbor) {
 		std::vector<Eigen::VectorXd> grids = GetNeighborPointsOnGrid(p, 1);
 		for(int i = 0; i < grids.size(); i++) {
-			auto iter = mGridMap.find(grids[i]);
-			if (iter != mGridMap.end()) {
-				std::vector<Param*> ps = iter->second->GetParams();
+			ParamCube* pcube = FindCube(grids[i]);
+			if (pcube != nullptr) {
+				std::shared_ptr<const std::vector<Param*>> snapshot = pcube->GetSnapshot();
+				const std::vector<Param*>& ps = *snapshot;
 				for(int j = 0; j < ps.size(); j++) {
 					if(old) {
-						if(!ps[j]->update && !inside)
+						if(!ps[j]->update.load(std::memory_order_relaxed) && !inside)
 							params.push_back(std::pair<double, Param*>(GetDistanceNorm(p, ps[j]->param_normalized), ps[j]));
-						else if(!ps[j]->update && inside && GetDensity(ps[j]->param_normalized) >= mThresholdInside)
+						else if(!ps[j]->update.load(std::memory_order_relaxed) && inside && GetDensity(ps[j]->param_normalized) >= mThresholdInside)
 							params.push_back(std::pair<double, Param*>(GetDistanceNorm(p, ps[j]->param_normalized), ps[j]));
 					} else {
 						if(!inside)
@@ -480,14 +630,16 @@ GetNearestParams(Eigen::VectorXd p, int n, bool search_neighbor, bool old, bool
 			}
 		}
 	} else {
-		auto iter = mGridMap.begin();
-		while(iter != mGridMap.end()) {
-			std::vector<Param*> ps = iter->second->GetParams();
+		std::shared_ptr<const ParamGrid> grid = GetGrid();
+		auto iter = grid->begin();
+		while(iter != grid->end()) {
+			std::shared_ptr<const std::vector<Param*>> snapshot = iter->second->GetSnapshot();
+			const std::vector<Param*>& ps = *snapshot;
 			for(int j = 0; j < ps.size(); j++) {
 				if(old) {
-					if(!ps[j]->update && !inside)
+					if(!ps[j]->update.load(std::memory_order_relaxed) && !inside)
 						params.push_back(std::pair<double, Param*>(GetDistanceNorm(p, ps[j]->param_normalized), ps[j]));
-					else if(!ps[j]->update && inside && GetDensity(ps[j]->param_normalized) >= mThresholdInside)
+					else if(!ps[j]->update.load(std::memory_order_relaxed) && inside && GetDensity(ps[j]->param_normalized) >= mThresholdInside)
 						params.push_back(std::pair<double, Param*>(GetDistanceNorm(p, ps[j]->param_normalized), ps[j]));
 
 				} else {
@@ -521,22 +673,23 @@ AddMapping(Param* p) {
 void 
 RegressionMemory::
 AddMapping(Eigen::VectorXd nearest, Param* p) {
-	auto iter = mGridMap.find(nearest);
-	if (iter != mGridMap.end()) {
-		ParamCube* pcube = iter->second;
-
-		pcube->PutParam(p);
-		if(!pcube->GetActivated() && (pcube->GetNumParams() > mThresholdActivate)) {
-			pcube->SetActivated(true);
+	ParamCube* pcube = FindOrCreateCube(nearest);
+	std::lock_guard<std::mutex> lock(pcube->GetLock());
+	AddMappingLocked(pcube, p);
+}
+void 
+RegressionMemory::
+AddMappingLocked(ParamCube* pcube, Param* p) {
+	pcube->PutParam(p);
+	if(!pcube->GetActivated() && (pcube->GetNumParams() > mThresholdActivate)) {
+		Eigen::VectorXd nearest = pcube->GetIdx();
+		pcube->SetActivated(true);
+		{
+			std::lock_guard<std::mutex> lock(mActivationLock);
 			mParamActivated.insert(std::pair<Eigen::VectorXd, int>(nearest, 1));
 			mParamDeactivated.erase(nearest);
-			mRecordLog.push_back("activated: " + vectorXd_to_string(nearest));
 		}
-
-	} else {
-		ParamCube* pcube = new ParamCube(nearest);
-		pcube->PutParam(p);
-		mGridMap.insert(std::pair<Eigen::VectorXd, ParamCube* >(nearest, pcube));
+		PushLog("activated: " + vectorXd_to_string(nearest));
 	}
 }
 double 
@@ -563,56 +716,53 @@ Denormalize(Eigen::VectorXd p) {
 void
 RegressionMemory::
 DeleteMappings(Eigen::VectorXd nearest, std::vector<Param*> ps) {
-	// std::cout << "delete" << std::endl;
-	auto iter = mGridMap.find(nearest);
-	// std::cout << nearest << std::endl;
-
-	if (iter != mGridMap.end()) {
-		ParamCube* pcube = iter->second;
-
-		std::vector<Param*> ps_new;
-		std::vector<Param*> ps_old = pcube->GetParams();
-		std::vector<std::pair<Eigen::VectorXd, double>>	v;
-
-		auto iter_trash = mTrashMap.find(nearest);
-		if(iter_trash != mTrashMap.end())
-			v = iter_trash->second;
-
-		for(int i = 0; i < ps.size(); i++) {
-			v.push_back(std::pair<Eigen::VectorXd, double>(ps[i]->param_normalized, ps[i]->reward));
-		}
-		while(v.size() > 100) {
-			v.erase(v.begin());
-		}
-
-		if(iter_trash != mTrashMap.end())
-			iter_trash->second = v;
-		else
-			mTrashMap.insert(std::pair<Eigen::VectorXd, std::vector<std::pair<Eigen::VectorXd, double>>>(nearest, v));
-
+	ParamCube* pcube = FindCube(nearest);
+	if(pcube != nullptr) {
+		std::lock_guard<std::mutex> lock(pcube->GetLock());
+		DeleteMappingsLocked(pcube, ps);
+	}
+}
+void
+RegressionMemory::
+DeleteMappingsLocked(ParamCube* pcube, std::vector<Param*> ps) {
+	std::vector<Param*> ps_new;
+	std::vector<Param*> ps_old = pcube->GetParams();
 
+	for(int i = 0; i < ps.size(); i++) {
+		pcube->trash.push_back(std::pair<Eigen::VectorXd, double>(ps[i]->param_normalized, ps[i]->reward));
+	}
+	if(pcube->trash.size() > 100) {
+		pcube->trash.erase(pcube->trash.begin(), pcube->trash.end() - 100);
+	}
 
-		int count = 0;
-		for(int i = 0; i < ps_old.size(); i++) {
-			if(count < ps.size() && IsEqualParam(ps_old[i], ps[count])) {
-				delete ps_old[i];
-				count += 1;
-			} else {
-				ps_new.push_back(ps_old[i]);
-			}
+	// readers may still hold a snapshot with the removed params, they are freed in ReleaseRetired
+	std::vector<Param*> retired;
+	int count = 0;
+	for(int i = 0; i < ps_old.size(); i++) {
+		if(count < ps.size() && IsEqualParam(ps_old[i], ps[count])) {
+			retired.push_back(ps_old[i]);
+			count += 1;
+		} else {
+			ps_new.push_back(ps_old[i]);
 		}
+	}
+	{
+		std::lock_guard<std::mutex> lock(mRetiredLock);
+		mRetired.insert(mRetired.end(), retired.begin(), retired.end());
+	}
 
-		pcube->PutParams(ps_new);
-		bool wasActivated = pcube->GetActivated();
-		if(wasActivated && ps_new.size() <= mThresholdActivate) {
-			pcube->SetActivated(false);
+	pcube->PutParams(ps_new);
+	bool wasActivated = pcube->GetActivated();
+	if(wasActivated && ps_new.size() <= mThresholdActivate) {
+		Eigen::VectorXd nearest = pcube->GetIdx();
+		pcube->SetActivated(false);
+		{
+			std::lock_guard<std::mutex> lock(mActivationLock);
 			mParamActivated.erase(nearest);
 			mParamDeactivated.insert(std::pair<Eigen::VectorXd, int>(nearest, 1));
-			mRecordLog.push_back("deactivated: " + vectorXd_to_string(nearest));
 		}
-	} 
-	//std::cout << "delete done" << std::endl;
-
+		PushLog("deactivated: " + vectorXd_to_string(nearest));
+	}
 }
 double 
 RegressionMemory::
@@ -622,11 +772,12 @@ GetDensity(Eigen::VectorXd p, bool old) {
 	std::vector<Eigen::VectorXd> neighborlist = GetNeighborPointsOnGrid(p, 1);
 
 	for(int j = 0; j < neighborlist.size(); j++) {
-		auto iter = mGridMap.find(neighborlist[j]);
-		if(iter != mGridMap.end()) {
-			std::vector<Param*> ps = iter->second->GetParams();
+		ParamCube* pcube = FindCube(neighborlist[j]);
+		if(pcube != nullptr) {
+			std::shared_ptr<const std::vector<Param*>> snapshot = pcube->GetSnapshot();
+			const std::vector<Param*>& ps = *snapshot;
 			for(int k = 0; k < ps.size(); k++) {
-				if(old && ps[k]->update) 
+				if(old && ps[k]->update.load(std::memory_order_relaxed))
 					continue;
 				double d = GetDistanceNorm(p, ps[k]->param_normalized);
 
@@ -704,12 +855,13 @@ std::pair<Eigen::VectorXd , bool>
 RegressionMemory::
 UniformSample(double d0, double d1) {
 	int count = 0;
+	std::shared_ptr<const ParamGrid> grid = GetGrid();
 	while(1) {
 		double r = mUniform(mMT);
-		r = std::floor(r * mGridMap.size());
-		if(r == mGridMap.size())
+		r = std::floor(r * grid->size());
+		if(r == grid->size())
 			r -= 1;
-		auto it_grid = std::next(mGridMap.begin(), (int)r);
+		auto it_grid = std::next(grid->begin(), (int)r);
 		std::vector<Param*> params = it_grid->second->GetParams(); 
 		if(params.size() == 0)
 			continue;
@@ -718,7 +870,7 @@ UniformSample(double d0, double d1) {
 		r = std::floor(r * params.size());
 		if(r == params.size())
 			r -= 1;
-		if(params[r]->update)
+		if(params[r]->update.load(std::memory_order_relaxed))
 			continue;
 		Eigen::VectorXd p = params[r]->param_normalized;
 		Eigen::VectorXd dir(mDim);
@@ -760,31 +912,48 @@ UpdateParamSpace(std::tuple<std::vector<Eigen::VectorXd>, Eigen::VectorXd, doubl
 	Eigen::VectorXd nearest = GetNearestPointOnGrid(candidate_scaled);
 
 	std::vector<Eigen::VectorXd> checklist = GetNeighborPointsOnGrid(candidate_scaled, nearest, mRadiusNeighbor);
+
+	// lock every cell the candidate is compared with, in address order so concurrent updates cannot deadlock
+	ParamCube* pcube_nearest = FindOrCreateCube(nearest);
+	std::vector<ParamCube*> cubes(checklist.size());
+	std::vector<ParamCube*> to_lock;
+	for(int i = 0; i < checklist.size(); i++) {
+		cubes[i] = FindCube(checklist[i]);
+		if(cubes[i] != nullptr)
+			to_lock.push_back(cubes[i]);
+	}
+	std::sort(to_lock.begin(), to_lock.end());
+	to_lock.erase(std::unique(to_lock.begin(), to_lock.end()), to_lock.end());
+	std::vector<std::unique_lock<std::mutex>> locks;
+	for(int i = 0; i < to_lock.size(); i++)
+		locks.push_back(std::unique_lock<std::mutex>(to_lock[i]->GetLock()));
+
 	int n_compare = 0;
 	double prev_max = 0;
 	bool flag = true;
 
 	double update_max = 5;
-	std::vector<std::pair<Eigen::VectorXd, std::vector<Param*>>> to_be_deleted;
+	std::vector<std::pair<ParamCube*, std::vector<Param*>>> to_be_deleted;
 	for(int i = 0 ; i < checklist.size(); i++) {
-		auto iter = mGridMap.find(checklist[i]);
-		if (iter != mGridMap.end()) {
-			ParamCube* pcube = iter->second;
+		ParamCube* pcube = cubes[i];
+		if (pcube != nullptr) {
 			std::vector<Param*> ps = pcube->GetParams();
 			std::vector<Param*> p_delete;
 			for(int j =0; j < ps.size(); j++) {
 				double dist = GetDistanceNorm(candidate_scaled, ps[j]->param_normalized);
 				if(dist < mRadiusNeighbor) {
 					n_compare += 1;
-					if(ps[j]->update > 0)
-						ps[j]->update -= 1;
+					int update = ps[j]->update.load(std::memory_order_relaxed);
+					if(update > 0)
+						ps[j]->update.store(update - 1, std::memory_order_relaxed);
 		
 					if(prev_max < ps[j]->reward)
 						prev_max = ps[j]->reward;
 					if(ps[j]->reward < std::get<2>(candidate)) {
 						p_delete.push_back(ps[j]);
-						if(update_max < ps[j]->update || update_max == 5)
-							update_max = ps[j]->update;
+						int update = ps[j]->update.load(std::memory_order_relaxed);
+						if(update_max < update || update_max == 5)
+							update_max = update;
 					} else {
 						flag = false;
 						break;
@@ -794,13 +963,13 @@ UpdateParamSpace(std::tuple<std::vector<Eigen::VectorXd>, Eigen::VectorXd, doubl
 			if(!flag)
 				break;
 			else if(p_delete.size() != 0) {
-				to_be_deleted.push_back(std::pair<Eigen::VectorXd, std::vector<Param*>>(checklist[i], p_delete));
+				to_be_deleted.push_back(std::pair<ParamCube*, std::vector<Param*>>(pcube, p_delete));
 			}
 		}
 	}
 
 	if(n_compare == 0) {
-		mRecordLog.push_back("new parameter: " + vectorXd_to_string(nearest) + ", " + std::to_string(std::get<2>(candidate)));
+		PushLog("new parameter: " + vectorXd_to_string(nearest) + ", " + std::to_string(std::get<2>(candidate)));
 	}
 
 	if(flag) {
@@ -809,9 +978,8 @@ UpdateParamSpace(std::tuple<std::vector<Eigen::VectorXd>, Eigen::VectorXd, doubl
 		double d = GetDensity(candidate_scaled);
 		if(d > mThresholdInside) {
 			for(int i = 0 ; i < checklist.size(); i++) {
-				auto iter_trash = mTrashMap.find(checklist[i]);
-				if (iter_trash != mTrashMap.end()) {
-					std::vector<std::pair<Eigen::VectorXd, double>> flist = iter_trash->second;
+				if (cubes[i] != nullptr) {
+					const std::vector<std::pair<Eigen::VectorXd, double>>& flist = cubes[i]->trash;
 					for(int j =0; j < flist.size(); j++) {
 						double dist = GetDistanceNorm(candidate_scaled, flist[j].first);
 						if(dist < mRadiusNeighbor) {
@@ -819,6 +987,7 @@ UpdateParamSpace(std::tuple<std::vector<Eigen::VectorXd>, Eigen::VectorXd, doubl
 								update_max = 0;
 							} else {
 								flag = false;
+								std::lock_guard<std::mutex> lock(mLogLock);
 								std::cout << "insert fail, cur: "  << std::get<2>(candidate) << " prev: " << flist[j].second  << std::endl;
 								return flag;
 							}
@@ -829,25 +998,26 @@ UpdateParamSpace(std::tuple<std::vector<Eigen::VectorXd>, Eigen::VectorXd, doubl
 		}
 		// std::cout << 2 << std::endl;
 
-		std::cout << candidate_scaled.transpose() << " " << std::get<2>(candidate) << " "<< update_max << std::endl;
+		{
+			std::lock_guard<std::mutex> lock(mLogLock);
+			std::cout << candidate_scaled.transpose() << " " << std::get<2>(candidate) << " "<< update_max << std::endl;
+		}
 
 		// std::cout << Denormalize(std::get<1>(candidate)).transpose() << " " <<to_be_deleted.size() << std::endl; 
 		for(int i = 0; i < to_be_deleted.size(); i++) {
-			for(int j = 0; j < to_be_deleted[i].second.size(); j++) {
-				Param* p = (to_be_deleted[i].second)[j];
-			}
-			DeleteMappings(to_be_deleted[i].first, to_be_deleted[i].second);
+			DeleteMappingsLocked(to_be_deleted[i].first, to_be_deleted[i].second);
 		}
 		// std::cout << "delete done" << std::endl;
 
 		Param* p = new Param();
 		p->param_normalized = candidate_scaled;
 		p->reward = std::get<2>(candidate);
-		p->cps = std::get<0>(candidate);
-		p->update = std::max(0.0, update_max);
+		p->cps.Encode(std::get<0>(candidate), mCPSEncoding);
+		p->update.store(std::max(0.0, update_max), std::memory_order_relaxed);
 
-	 	AddMapping(nearest, p);
+	 	AddMappingLocked(pcube_nearest, p);
 	
+		std::lock_guard<std::mutex> lock(mLogLock);
 		if(GetDistanceNorm(candidate_scaled, Normalize(mParamGoalCur)) < 1.0 && to_be_deleted.size() == 0) {
 			// if(mUpdatedSamplesNearGoal == 0)
 				mNewSamplesNearGoal = 1;
@@ -904,7 +1074,7 @@ RegressionMemory::
 SetParamGoal(Eigen::VectorXd paramGoal) { 
 	mParamGoalCur = paramGoal; 
 	auto pairs = GetNearestParams(Normalize(mParamGoalCur), 10, false, true);
-	mRecordLog.push_back("new goal: " + vectorXd_to_string(mParamGoalCur));
+	PushLog("new goal: " + vectorXd_to_string(mParamGoalCur));
 	mEliteGoalDistance = 0;
 	std::string result ="distance : ";
 	for(int i = 0; i < pairs.size(); i++) {
@@ -915,7 +1085,7 @@ SetParamGoal(Eigen::VectorXd paramGoal) {
 	mNewSamplesNearGoal = 0;
 	mUpdatedSamplesNearGoal = 0;
 
-	mRecordLog.push_back(result);
+	PushLog(result);
 }
 std::vector<Eigen::VectorXd> 
 RegressionMemory::
@@ -924,7 +1094,7 @@ GetCPSFromNearestParams(Eigen::VectorXd p_goal) {
 	std::vector<std::pair<double, Param*>> ps = GetNearestParams(Normalize(p_goal), mNumElite * 10, false, true);
 	// std::cout << p_goal.transpose() << " " << GetDensity(Normalize(p_goal)) << std::endl;
 	if(ps.size() < mNumElite) {
-		return mParamBVH->cps;
+		return mParamBVH->cps.Decode();
 	}
 
 	double f_baseline = GetParamReward(Denormalize(mParamBVH->param_normalized), p_goal);
@@ -962,10 +1132,7 @@ GetCPSFromNearestParams(Eigen::VectorXd p_goal) {
 	for(int i = 0; i < mNumElite; i++) {
 		double w = ps_elite[i].first;
 		weight_sum += w;
-	    std::vector<Eigen::VectorXd> cps = ps_elite[i].second->cps;
-	    for(int j = 0; j < mNumKnots; j++) {
-			mean_cps[j] += w * cps[j];
-	    }
+	    ps_elite[i].second->cps.AddWeighted(w, mean_cps);
 	}
 
 	for(int i = 0; i < mNumKnots; i++) {
@@ -978,6 +1145,7 @@ GetCPSFromNearestParams(Eigen::VectorXd p_goal) {
 void 
 RegressionMemory::
 SaveLog(std::string path) {
+	std::lock_guard<std::mutex> lock(mLogLock);
 	std::ofstream ofs;
 	ofs.open(path, std::fstream::out | std::fstream::app);
 	ofs << std::to_string(mNumSamples) << std::endl;
@@ -1069,9 +1237,11 @@ GetFitnessMean() {
 
 	int count = 0;
 	double fitness = 0;
-	auto iter = mGridMap.begin();
-	while(iter != mGridMap.end()) {
-		std::vector<Param*> p = iter->second->GetParams();
+	std::shared_ptr<const ParamGrid> grid = GetGrid();
+	auto iter = grid->begin();
+	while(iter != grid->end()) {
+		std::shared_ptr<const std::vector<Param*>> snapshot = iter->second->GetSnapshot();
+		const std::vector<Param*>& p = *snapshot;
 		for(int i = 0; i < p.size(); i++) {
 			fitness += p[i]->reward;
 			count += 1;
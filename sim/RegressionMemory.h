@@ -5,6 +5,10 @@
 #include <map>
 #include <Eigen/Dense>
 #include <random>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <atomic>
 
 template<>
 struct std::less<Eigen::VectorXd>
@@ -24,29 +28,83 @@ struct std::less<Eigen::VectorXd>
 
 namespace DPhy
 {
+enum CPSEncoding
+{
+	CPS_DOUBLE,
+	CPS_FLOAT,
+	// 16 bit fixed point with a per-dof offset and step
+	CPS_INT16
+};
+/**
+*
+* @brief Control points of a sample, stored knots x dof in one contiguous buffer.
+* @details Depending on the encoding values are kept as doubles, floats (half the memory) or 16 bit integers
+* quantized per dof between the min and max over knots (a quarter of the memory, error below range / 65535).
+* AddWeighted decodes straight into a weighted sum, which is all GetCPSFromNearestParams needs.
+*
+*/
+class PackedCPS
+{
+public:
+	PackedCPS() : mNumKnots(0), mDof(0), mEncoding(CPS_DOUBLE) {}
+	PackedCPS(const std::vector<Eigen::VectorXd>& cps, CPSEncoding encoding=CPS_DOUBLE) { Encode(cps, encoding); }
+
+	void Encode(const std::vector<Eigen::VectorXd>& cps, CPSEncoding encoding);
+	std::vector<Eigen::VectorXd> Decode() const;
+	// out[j] += w * cps[j]
+	void AddWeighted(double w, std::vector<Eigen::VectorXd>& out) const;
+
+	int GetNumKnots() const { return mNumKnots; }
+	CPSEncoding GetEncoding() const { return mEncoding; }
+	size_t GetBytes() const;
+private:
+	int mNumKnots;
+	int mDof;
+	CPSEncoding mEncoding;
+	std::vector<double> mDouble;
+	std::vector<float> mFloat;
+	std::vector<uint16_t> mInt16;
+	std::vector<float> mOffset;
+	std::vector<float> mStep;
+};
 struct Param
 {
 	Eigen::VectorXd param_normalized;
-	std::vector<Eigen::VectorXd> cps;
+	PackedCPS cps;
 	double reward;
-	int update;
+	// decremented by inserts under the cell lock while snapshot readers check it, so it is accessed atomically
+	std::atomic<int> update;
 };
+/**
+*
+* @brief Grid cell of the parameter space.
+* @details The param list is a copy-on-write snapshot: writers replace it while holding the cell lock, readers take
+* the current snapshot without locking.
+*
+*/
 class ParamCube
 {
 public:
-	ParamCube(Eigen::VectorXd i) { idx = i; activated = false; }
+	ParamCube(Eigen::VectorXd i) { idx = i; activated = false; param = std::make_shared<const std::vector<Param*>>(); }
 	Eigen::VectorXd GetIdx(){ return idx; }
-	void PutParam(Param* p) { param.push_back(p); }
-	int GetNumParams() { return param.size(); }
-	std::vector<Param*> GetParams() {return param;}
+	void PutParam(Param* p);
+	int GetNumParams() { return GetSnapshot()->size(); }
+	std::vector<Param*> GetParams() { return *GetSnapshot(); }
+	std::shared_ptr<const std::vector<Param*>> GetSnapshot() { return std::atomic_load(&param); }
 	void PutParams(std::vector<Param*> ps);
 	void SetActivated(bool ac) { activated = ac; }
 	bool GetActivated() { return activated;}
+	std::mutex& GetLock() { return lock; }
+
+	// recently replaced params of this cell, guarded by the cell lock
+	std::vector<std::pair<Eigen::VectorXd, double>> trash;
 private:
 	Eigen::VectorXd idx;
-	std::vector<Param*> param;
+	std::shared_ptr<const std::vector<Param*>> param;
 	bool activated;
+	std::mutex lock;
 };
+typedef std::map<Eigen::VectorXd, ParamCube*> ParamGrid;
 class RegressionMemory
 {
 public:
@@ -64,6 +122,8 @@ public:
 	void AddMapping(Param* p);
 	void AddMapping(Eigen::VectorXd nearest, Param* p);
 	void DeleteMappings(Eigen::VectorXd nearest, std::vector<Param*> ps);
+	// frees params removed by DeleteMappings; only call while no update is running
+	void ReleaseRetired();
 	double GetDistanceNorm(Eigen::VectorXd p0, Eigen::VectorXd p1);	
 	double GetDensity(Eigen::VectorXd p, bool old=false);
 	Eigen::VectorXd GetNearestPointOnGrid(Eigen::VectorXd p);
@@ -82,6 +142,8 @@ public:
 	Eigen::VectorXd GetParamGoal() {return mParamGoalCur; }
 	void SetParamGoal(Eigen::VectorXd paramGoal);
 	void SetRadius(double rn) { mRadiusNeighbor = rn; }
+	// encoding of the control points of new samples; stored samples are re-encoded
+	void SetCPSEncoding(CPSEncoding encoding);
 	void SetParamGridUnit(Eigen::VectorXd gridUnit) { mParamGridUnit = gridUnit;}
 	int GetDim() {return mDim; }
 
@@ -96,7 +158,11 @@ public:
 	std::vector<Param*> mloadAllSamples;
 
 	int GetNumSamples();
-	std::pair<double, double> GetExplorationRate() {return std::pair<double, double>(mNewSamplesNearGoal, mUpdatedSamplesNearGoal);}
+	// the flags are set by inserts under the log lock
+	std::pair<double, double> GetExplorationRate() {
+		std::lock_guard<std::mutex> lock(mLogLock);
+		return std::pair<double, double>(mNewSamplesNearGoal, mUpdatedSamplesNearGoal);
+	}
 	std::tuple<std::vector<Eigen::VectorXd>, 
 	   	   std::vector<Eigen::VectorXd>,  
 		   std::vector<double>, 
@@ -104,12 +170,18 @@ public:
 	double GetFitness(Eigen::VectorXd p);
 	double GetFitnessMean();
 private:
+	std::shared_ptr<const ParamGrid> GetGrid() { return std::atomic_load(&mGridMap); }
+	ParamCube* FindCube(const Eigen::VectorXd& idx);
+	ParamCube* FindOrCreateCube(const Eigen::VectorXd& idx);
+	// the caller holds the lock of pcube
+	void AddMappingLocked(ParamCube* pcube, Param* p);
+	void DeleteMappingsLocked(ParamCube* pcube, std::vector<Param*> ps);
+	void PushLog(const std::string& log);
+
 	std::map<Eigen::VectorXd, int> mParamActivated;
 	std::map<Eigen::VectorXd, int> mParamDeactivated;
 	std::map<Eigen::VectorXd, Param*> mParamNew;
 
-	std::map<Eigen::VectorXd, std::vector<std::pair<Eigen::VectorXd, double>>> mTrashMap;
-
 	Eigen::VectorXd mParamScale;
 	Eigen::VectorXd mParamScaleInv;
 	Eigen::VectorXd mParamGoalCur;
@@ -118,7 +190,13 @@ private:
 	Eigen::VectorXd mParamGridUnit;
 	Param* mParamBVH;
 
-	std::map< Eigen::VectorXd, ParamCube* > mGridMap;
+	// replaced as a whole when a cell is added, so lookups never lock
+	std::shared_ptr<const ParamGrid> mGridMap;
+	std::mutex mGridLock;
+	std::mutex mActivationLock;
+	std::mutex mLogLock;
+	std::mutex mRetiredLock;
+	std::vector<Param*> mRetired;
 
 	std::vector<std::pair<double, Param*>> mPrevElite;
 	std::vector<Eigen::VectorXd> mPrevCPS;   
@@ -136,6 +214,8 @@ private:
 	int mNumElite;
 	int mNumSamples;
 
+	CPSEncoding mCPSEncoding;
+
 	int mExplorationStep;
 	int mNumGoalCandidate;
 	int mIdxCandidate;
@@ -0,0 +1,171 @@
+#include "RolloutRecorder.h"
+#include <iostream>
+#include <cstring>
+#include <cstdint>
+namespace DPhy
+{
+static const char RECORD_MAGIC[8] = {'C', 'A', 'R', 'R', 'E', 'C', '0', '1'};
+
+RolloutRecorder::
+RolloutRecorder(int dof, int capacity)
+	:mDof(dof), mCapacity(capacity), mEpisode(0), mHead(0), mTail(0), mStop(false)
+{
+	mStride = GetStride(dof);
+	mBuffer.resize((size_t)mCapacity * mStride);
+}
+RolloutRecorder::
+~RolloutRecorder()
+{
+	this->Close();
+}
+bool
+RolloutRecorder::
+Open(const std::string& path)
+{
+	this->Close();
+	mFile.open(path, std::ios::binary | std::ios::trunc);
+	if(!mFile.is_open()) {
+		std::cout << "rollout recorder : cannot open " << path << std::endl;
+		return false;
+	}
+	int32_t header[2] = {mDof, mStride};
+	mFile.write(RECORD_MAGIC, sizeof(RECORD_MAGIC));
+	mFile.write((const char*)header, sizeof(header));
+
+	mEpisode = 0;
+	mHead = 0;
+	mTail = 0;
+	mStop = false;
+	mThread = std::thread(&RolloutRecorder::Run, this);
+	return true;
+}
+void
+RolloutRecorder::
+Close()
+{
+	if(!mThread.joinable())
+		return;
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		mStop = true;
+	}
+	mReady.notify_one();
+	mThread.join();
+	mFile.close();
+}
+void
+RolloutRecorder::
+Record(double phase, int contact, const Eigen::Vector3d& com, const Eigen::VectorXd& pos,
+	   const Eigen::VectorXd& vel, const Eigen::VectorXd& target, const Eigen::VectorXd& bvh)
+{
+	if(!mThread.joinable())
+		return;
+	long slot;
+	{
+		std::unique_lock<std::mutex> lock(mLock);
+		mSpace.wait(lock, [this]() { return mHead - mTail < mCapacity; });
+		slot = mHead % mCapacity;
+	}
+
+	// the writer never touches slots at or past mHead, so the copy needs no lock
+	float* f = mBuffer.data() + (size_t)slot * mStride;
+	f[0] = mEpisode;
+	f[1] = phase;
+	f[2] = contact;
+	Eigen::Map<Eigen::Vector3f>(f + 3) = com.cast<float>();
+	Eigen::Map<Eigen::VectorXf>(f + 6, mDof) = pos.cast<float>();
+	Eigen::Map<Eigen::VectorXf>(f + 6 + mDof, mDof) = vel.cast<float>();
+	Eigen::Map<Eigen::VectorXf>(f + 6 + 2 * mDof, mDof) = target.cast<float>();
+	Eigen::Map<Eigen::VectorXf>(f + 6 + 3 * mDof, mDof) = bvh.cast<float>();
+
+	bool wake;
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		mHead += 1;
+		wake = (mHead - mTail) * 2 >= mCapacity;
+	}
+	if(wake)
+		mReady.notify_one();
+}
+void
+RolloutRecorder::
+Run()
+{
+	while(true) {
+		long begin, end;
+		bool stop;
+		{
+			std::unique_lock<std::mutex> lock(mLock);
+			mReady.wait(lock, [this]() { return mStop || (mHead - mTail) * 2 >= mCapacity; });
+			begin = mTail;
+			end = mHead;
+			stop = mStop;
+		}
+		// at most two contiguous pieces because of the wrap around
+		while(begin < end) {
+			long slot = begin % mCapacity;
+			long n = std::min(end - begin, mCapacity - slot);
+			mFile.write((const char*)(mBuffer.data() + (size_t)slot * mStride), sizeof(float) * n * mStride);
+			begin += n;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mLock);
+			mTail = end;
+		}
+		mSpace.notify_one();
+		if(stop)
+			break;
+	}
+	mFile.flush();
+}
+bool
+RolloutReader::
+IsRecordFile(const std::string& path)
+{
+	std::ifstream is(path, std::ios::binary);
+	char magic[sizeof(RECORD_MAGIC)];
+	if(!is.read(magic, sizeof(magic)))
+		return false;
+	return std::memcmp(magic, RECORD_MAGIC, sizeof(magic)) == 0;
+}
+bool
+RolloutReader::
+Load(const std::string& path)
+{
+	std::ifstream is(path, std::ios::binary | std::ios::ate);
+	if(!is.is_open()) {
+		std::cout << "rollout reader : cannot open " << path << std::endl;
+		return false;
+	}
+	long size = is.tellg();
+	is.seekg(0);
+
+	char magic[sizeof(RECORD_MAGIC)];
+	int32_t header[2];
+	if(!is.read(magic, sizeof(magic)) || std::memcmp(magic, RECORD_MAGIC, sizeof(magic)) != 0
+	   || !is.read((char*)header, sizeof(header))) {
+		std::cout << "rollout reader : " << path << " is not a record file" << std::endl;
+		return false;
+	}
+	mDof = header[0];
+	mStride = header[1];
+	mNumFrames = (size - sizeof(magic) - sizeof(header)) / (sizeof(float) * mStride);
+	mData.resize((size_t)mNumFrames * mStride);
+	is.read((char*)mData.data(), sizeof(float) * mData.size());
+	return true;
+}
+std::vector<std::pair<int, int>>
+RolloutReader::
+GetEpisodes()
+{
+	std::vector<std::pair<int, int>> episodes;
+	int begin = 0;
+	for(int i = 1; i <= mNumFrames; i++) {
+		if(i == mNumFrames || GetEpisode(i) != GetEpisode(begin)) {
+			episodes.push_back(std::make_pair(begin, i));
+			begin = i;
+		}
+	}
+	return episodes;
+}
+}
@@ -0,0 +1,100 @@
+#ifndef __DEEP_PHYSICS_ROLLOUT_RECORDER_H__
+#define __DEEP_PHYSICS_ROLLOUT_RECORDER_H__
+#include <Eigen/Dense>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+namespace DPhy
+{
+// foot contact flags of a recorded step
+enum RecordContact
+{
+	RECORD_CONTACT_RIGHT = 1,
+	RECORD_CONTACT_LEFT = 2
+};
+/**
+*
+* @brief Streams controller steps to a binary record file.
+* @details Steps are copied as floats into a ring buffer of fixed capacity and a writer thread appends them to the
+* file in blocks, so a rollout of any length keeps the same memory. A frame is
+* [episode, phase, contact flags, com(3), positions, velocities, target positions, bvh positions]. The header only
+* holds the dof, the number of frames follows from the file size, so a file cut short is still readable.
+*
+*/
+class RolloutRecorder
+{
+public:
+	RolloutRecorder(int dof, int capacity=1024);
+	~RolloutRecorder();
+
+	bool Open(const std::string& path);
+	// writes out every buffered step and closes the file
+	void Close();
+	bool IsOpen() { return mFile.is_open(); }
+
+	// following steps belong to a new episode
+	void BeginEpisode() { mEpisode += 1; }
+	// blocks only when the writer is a whole buffer behind
+	void Record(double phase, int contact, const Eigen::Vector3d& com, const Eigen::VectorXd& pos,
+				const Eigen::VectorXd& vel, const Eigen::VectorXd& target, const Eigen::VectorXd& bvh);
+
+	static int GetStride(int dof) { return 6 + 4 * dof; }
+private:
+	void Run();
+
+	int mDof;
+	int mStride;
+	int mCapacity;
+	int mEpisode;
+	std::vector<float> mBuffer;
+	// number of steps recorded and written so far, slot of step i is i % mCapacity
+	long mHead;
+	long mTail;
+	bool mStop;
+
+	std::ofstream mFile;
+	std::mutex mLock;
+	std::condition_variable mReady;
+	std::condition_variable mSpace;
+	std::thread mThread;
+};
+/**
+*
+* @brief Reads a file written by RolloutRecorder.
+*
+*/
+class RolloutReader
+{
+public:
+	RolloutReader() : mDof(0), mStride(0), mNumFrames(0) {}
+
+	static bool IsRecordFile(const std::string& path);
+	bool Load(const std::string& path);
+
+	int GetDof() { return mDof; }
+	int GetNumFrames() { return mNumFrames; }
+	// [begin, end) frame range of each episode
+	std::vector<std::pair<int, int>> GetEpisodes();
+
+	int GetEpisode(int idx) { return (int)Frame(idx)[0]; }
+	double GetPhase(int idx) { return Frame(idx)[1]; }
+	int GetContact(int idx) { return (int)Frame(idx)[2]; }
+	Eigen::Vector3d GetCOM(int idx) { return Eigen::Map<const Eigen::Vector3f>(Frame(idx) + 3).cast<double>(); }
+	Eigen::VectorXd GetPositions(int idx) { return Segment(idx, 0); }
+	Eigen::VectorXd GetVelocities(int idx) { return Segment(idx, 1); }
+	Eigen::VectorXd GetTargetPositions(int idx) { return Segment(idx, 2); }
+	Eigen::VectorXd GetBVHPositions(int idx) { return Segment(idx, 3); }
+private:
+	const float* Frame(int idx) { return mData.data() + (size_t)idx * mStride; }
+	Eigen::VectorXd Segment(int idx, int n) { return Eigen::Map<const Eigen::VectorXf>(Frame(idx) + 6 + n * mDof, mDof).cast<double>(); }
+
+	int mDof;
+	int mStride;
+	int mNumFrames;
+	std::vector<float> mData;
+};
+}
+#endif
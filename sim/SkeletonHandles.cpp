@@ -0,0 +1,57 @@
+#include "SkeletonHandles.h"
+#include <iostream>
+namespace DPhy
+{
+static const char* BODY_HANDLE_NAMES[NUM_BODY_HANDLES] = {
+	"Hips", "RightFoot", "RightToe", "LeftFoot", "LeftToe", "RightHand", "LeftHand", "Head"
+};
+SkeletonHandles::
+SkeletonHandles(const dart::dynamics::SkeletonPtr& skel)
+{
+	mBodies.resize(NUM_BODY_HANDLES, nullptr);
+	for(int i = 0; i < NUM_BODY_HANDLES; i++) {
+		mBodies[i] = skel->getBodyNode(BODY_HANDLE_NAMES[i]);
+		if(mBodies[i] == nullptr)
+			std::cout << "skeleton handles : no body named " << BODY_HANDLE_NAMES[i] << std::endl;
+	}
+
+	int n_bnodes = skel->getNumBodyNodes();
+	mDofIndex.resize(n_bnodes);
+	mNumDofs.resize(n_bnodes);
+	for(int i = 0; i < n_bnodes; i++) {
+		dart::dynamics::Joint* jn = skel->getBodyNode(i)->getParentJoint();
+		mNumDofs[i] = jn->getNumDofs();
+		mDofIndex[i] = mNumDofs[i] > 0 ? jn->getIndexInSkeleton(0) : 0;
+		if(dynamic_cast<dart::dynamics::RevoluteJoint*>(jn) != nullptr)
+			mRevoluteDofs.push_back(mDofIndex[i]);
+	}
+}
+BodyHandle
+SkeletonHandles::
+FromName(const std::string& name)
+{
+	for(int i = 0; i < NUM_BODY_HANDLES; i++) {
+		if(name == BODY_HANDLE_NAMES[i])
+			return (BodyHandle)i;
+	}
+	return NUM_BODY_HANDLES;
+}
+const char*
+SkeletonHandles::
+GetName(BodyHandle h)
+{
+	return BODY_HANDLE_NAMES[h];
+}
+void
+SkeletonHandles::
+WrapRevolute(Eigen::VectorXd& v)
+{
+	for(int i = 0; i < mRevoluteDofs.size(); i++) {
+		double& v_ = v[mRevoluteDofs[i]];
+		if(v_ > M_PI)
+			v_ -= 2*M_PI;
+		else if(v_ < -M_PI)
+			v_ += 2*M_PI;
+	}
+}
+}
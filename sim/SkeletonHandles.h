@@ -0,0 +1,53 @@
+#ifndef __DEEP_PHYSICS_SKELETON_HANDLES_H__
+#define __DEEP_PHYSICS_SKELETON_HANDLES_H__
+#include "dart/dart.hpp"
+#include <vector>
+#include <string>
+namespace DPhy
+{
+// bodies referred to by name in the controller
+enum BodyHandle
+{
+	BODY_HIPS,
+	BODY_RIGHT_FOOT,
+	BODY_RIGHT_TOE,
+	BODY_LEFT_FOOT,
+	BODY_LEFT_TOE,
+	BODY_RIGHT_HAND,
+	BODY_LEFT_HAND,
+	BODY_HEAD,
+	NUM_BODY_HANDLES
+};
+/**
+*
+* @brief Handle table resolved once per skeleton.
+* @details Keeps body pointers of named bodies, the dof range of every body's parent joint and the dofs of revolute
+* joints, so per-step code neither hashes names nor walks joints with dynamic_cast.
+*
+*/
+class SkeletonHandles
+{
+public:
+	SkeletonHandles(const dart::dynamics::SkeletonPtr& skel);
+
+	static BodyHandle FromName(const std::string& name);
+	static const char* GetName(BodyHandle h);
+
+	dart::dynamics::BodyNode* GetBody(BodyHandle h) { return mBodies[h]; }
+	int GetDofIndex(BodyHandle h) { return mDofIndex[mBodies[h]->getIndexInSkeleton()]; }
+
+	// dof range of the parent joint of body node i
+	int GetDofIndex(int i) { return mDofIndex[i]; }
+	int GetNumDofs(int i) { return mNumDofs[i]; }
+
+	const std::vector<int>& GetRevoluteDofs() { return mRevoluteDofs; }
+	// wrap revolute dofs of a position difference into [-pi, pi]
+	void WrapRevolute(Eigen::VectorXd& v);
+private:
+	std::vector<dart::dynamics::BodyNode*> mBodies;
+	std::vector<int> mDofIndex;
+	std::vector<int> mNumDofs;
+	std::vector<int> mRevoluteDofs;
+};
+}
+#endif
@@ -0,0 +1,85 @@
+#include "StateLayout.h"
+#include "Functions.h"
+namespace DPhy
+{
+typedef Eigen::Map<Eigen::Matrix<double, 6, 1>> Map6d;
+typedef Eigen::Map<Eigen::Matrix<double, 9, 1>> Map9d;
+typedef Eigen::Map<Eigen::Vector3d> Map3d;
+
+StateLayout::
+StateLayout(const dart::dynamics::SkeletonPtr& skel, const std::vector<std::string>& endEffectors,
+			const std::vector<std::string>& contacts, bool parametric, int dimParam)
+	:mSkel(skel), mParametric(parametric), mDimParam(dimParam)
+{
+	mRoot = skel->getRootBodyNode();
+	for(int i = 1; i < skel->getNumBodyNodes(); i++)
+		mBodies.push_back(skel->getBodyNode(i));
+
+	for(int i = 0; i < endEffectors.size(); i++) {
+		dart::dynamics::BodyNode* bn = skel->getBodyNode(endEffectors[i]);
+		mEndEffectors.push_back(bn);
+		mEndEffectorDofs.push_back(bn->getParentJoint()->getIndexInSkeleton(0));
+	}
+	for(int i = 0; i < contacts.size(); i++)
+		mContacts.push_back(skel->getBodyNode(contacts[i]));
+
+	mOffsetRotation = 0;
+	mOffsetVelocity = mOffsetRotation + mBodies.size()*6;
+	mOffsetUpAngle = mOffsetVelocity + skel->getNumDofs();
+	mOffsetRootHeight = mOffsetUpAngle + 1;
+	mOffsetEndEffectorState = mOffsetRootHeight + 1;
+	mOffsetAdaptiveStep = mOffsetEndEffectorState + GetEndEffectorStateSize();
+	mOffsetEndEffector = mOffsetAdaptiveStep + 1;
+	mOffsetPhase = mOffsetEndEffector + mEndEffectors.size()*3;
+	mOffsetParam = mOffsetPhase + 1;
+	mOffsetContact = mOffsetParam + mDimParam;
+	if(mParametric)
+		mSize = mOffsetContact + mContacts.size();
+	else
+		mSize = mOffsetParam;
+}
+void
+StateLayout::
+WriteBodyRotations(double* out)
+{
+	for(int i = 0; i < mBodies.size(); i++) {
+		const Eigen::Matrix3d& R = mBodies[i]->getRelativeTransform().linear();
+		Map6d(out + 6*i) << R(0,0), R(0,1), R(0,2), R(1,0), R(1,1), R(1,2);
+	}
+}
+void
+StateLayout::
+WriteEndEffectorPositions(const Eigen::Isometry3d& root_inv, double* out)
+{
+	for(int i = 0; i < mEndEffectors.size(); i++)
+		Map3d(out + 3*i) = root_inv * mEndEffectors[i]->getWorldTransform().translation();
+}
+void
+StateLayout::
+WriteEndEffectorState(const Eigen::Isometry3d& root_inv, const Eigen::VectorXd& vel, double* out)
+{
+	int num_ee = mEndEffectors.size();
+	for(int i = 0; i < num_ee; i++) {
+		Eigen::Isometry3d transform = root_inv * mEndEffectors[i]->getWorldTransform();
+		const Eigen::Matrix3d& R = transform.linear();
+		Map9d(out + 9*i) << R(0,0), R(0,1), R(0,2), R(1,0), R(1,1), R(1,2), transform.translation();
+	}
+	for(int i = 0; i < num_ee; i++)
+		Map3d(out + 9*num_ee + 3*i) = vel.segment<3>(mEndEffectorDofs[i]);
+
+	// root diff with target com
+	Eigen::Isometry3d transform = root_inv * mRoot->getWorldTransform();
+	const Eigen::Matrix3d& R = transform.linear();
+	double* tail = out + 12*num_ee;
+	Map9d(tail) << R(0,0), R(0,1), R(0,2), R(1,0), R(1,1), R(1,2), transform.translation();
+	Map3d(tail + 9) = root_inv.linear() * mRoot->getAngularVelocity();
+	Map3d(tail + 12) = root_inv.linear() * mRoot->getCOMLinearVelocity();
+}
+void
+StateLayout::
+WriteContactHeights(double* out)
+{
+	for(int i = 0; i < mContacts.size(); i++)
+		out[i] = mContacts[i]->getWorldTransform().translation()[1];
+}
+}
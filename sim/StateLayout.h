@@ -0,0 +1,57 @@
+#ifndef __DEEP_PHYSICS_STATE_LAYOUT_H__
+#define __DEEP_PHYSICS_STATE_LAYOUT_H__
+#include "dart/dart.hpp"
+#include <vector>
+#include <string>
+namespace DPhy
+{
+/**
+*
+* @brief Precomputed layout of the controller observation.
+* @details Body pointers, dof indices and segment offsets are resolved once from the skeleton, so filling a state
+* does not look up bodies by name or resize vectors. Each Write function fills one segment of a caller-owned buffer.
+*
+*/
+class StateLayout
+{
+public:
+	StateLayout(const dart::dynamics::SkeletonPtr& skel, const std::vector<std::string>& endEffectors,
+				const std::vector<std::string>& contacts, bool parametric, int dimParam);
+
+	int GetSize() { return mSize; }
+	int GetNumEndEffectors() { return mEndEffectors.size(); }
+	int GetEndEffectorStateSize() { return mEndEffectors.size()*12 + 15; }
+
+	// rotation part (first two rows) of each non-root body relative to its parent
+	void WriteBodyRotations(double* out);
+	// end effector positions in the frame of root_inv
+	void WriteEndEffectorPositions(const Eigen::Isometry3d& root_inv, double* out);
+	// end effector and root state of the current pose, expressed in the frame of root_inv
+	void WriteEndEffectorState(const Eigen::Isometry3d& root_inv, const Eigen::VectorXd& vel, double* out);
+	void WriteContactHeights(double* out);
+
+	// offsets of each segment in the observation
+	int mOffsetRotation;
+	int mOffsetVelocity;
+	int mOffsetUpAngle;
+	int mOffsetRootHeight;
+	int mOffsetEndEffectorState;
+	int mOffsetAdaptiveStep;
+	int mOffsetEndEffector;
+	int mOffsetPhase;
+	int mOffsetParam;
+	int mOffsetContact;
+private:
+	dart::dynamics::SkeletonPtr mSkel;
+	dart::dynamics::BodyNode* mRoot;
+	std::vector<dart::dynamics::BodyNode*> mBodies;
+	std::vector<dart::dynamics::BodyNode*> mEndEffectors;
+	std::vector<int> mEndEffectorDofs;
+	std::vector<dart::dynamics::BodyNode*> mContacts;
+
+	int mSize;
+	bool mParametric;
+	int mDimParam;
+};
+}
+#endif
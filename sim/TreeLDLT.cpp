@@ -0,0 +1,72 @@
+#include "TreeLDLT.h"
+#include <iostream>
+namespace DPhy
+{
+TreeLDLT::
+TreeLDLT(const dart::dynamics::SkeletonPtr& skel)
+{
+	mDof = skel->getNumDofs();
+	mParent.assign(mDof, -1);
+	for(int i = 0; i < skel->getNumBodyNodes(); i++) {
+		dart::dynamics::BodyNode* bn = skel->getBodyNode(i);
+		dart::dynamics::Joint* jn = bn->getParentJoint();
+		int n = jn->getNumDofs();
+		if(n == 0)
+			continue;
+		int idx = jn->getIndexInSkeleton(0);
+		for(int j = 1; j < n; j++)
+			mParent[idx + j] = idx + j - 1;
+
+		// the last dof of the nearest ancestor joint that has dofs
+		dart::dynamics::BodyNode* parent = bn->getParentBodyNode();
+		while(parent != nullptr && parent->getParentJoint()->getNumDofs() == 0)
+			parent = parent->getParentBodyNode();
+		if(parent != nullptr) {
+			dart::dynamics::Joint* pj = parent->getParentJoint();
+			mParent[idx] = pj->getIndexInSkeleton(pj->getNumDofs() - 1);
+		}
+	}
+	for(int i = 0; i < mDof; i++) {
+		if(mParent[i] >= i) {
+			std::cout << "tree ldlt : dofs are not ordered from the root, factorizing densely" << std::endl;
+			for(int j = 0; j < mDof; j++)
+				mParent[j] = j - 1;
+			break;
+		}
+	}
+}
+void
+TreeLDLT::
+Compute(const Eigen::MatrixXd& A)
+{
+	mLD = A;
+	for(int k = mDof - 1; k >= 0; k--) {
+		for(int i = mParent[k]; i != -1; i = mParent[i]) {
+			double a = mLD(k, i) / mLD(k, k);
+			for(int j = i; j != -1; j = mParent[j])
+				mLD(i, j) -= a * mLD(k, j);
+			mLD(k, i) = a;
+		}
+	}
+}
+Eigen::VectorXd
+TreeLDLT::
+Solve(const Eigen::VectorXd& b)
+{
+	Eigen::VectorXd x = b;
+	// L^T
+	for(int i = mDof - 1; i >= 0; i--) {
+		for(int j = mParent[i]; j != -1; j = mParent[j])
+			x[j] -= mLD(i, j) * x[i];
+	}
+	// D
+	for(int i = 0; i < mDof; i++)
+		x[i] /= mLD(i, i);
+	// L
+	for(int i = 0; i < mDof; i++) {
+		for(int j = mParent[i]; j != -1; j = mParent[j])
+			x[i] -= mLD(i, j) * x[j];
+	}
+	return x;
+}
+}
@@ -0,0 +1,34 @@
+#ifndef __DEEP_PHYSICS_TREE_LDLT_H__
+#define __DEEP_PHYSICS_TREE_LDLT_H__
+#include "dart/dart.hpp"
+#include <vector>
+namespace DPhy
+{
+/**
+*
+* @brief Sparse L^T D L factorization of joint space matrices of a skeleton.
+* @details Entry (i, j) of the mass matrix of a kinematic tree is nonzero only if dof i is an ancestor of dof j or
+* the other way round, so factorizing along the parent of every dof (Featherstone, RBDA 6.5) fills in nothing and
+* costs O(n d^2) for depth d, instead of O(n^3) for a dense inverse. Only the lower triangle of the input is read.
+*
+*/
+class TreeLDLT
+{
+public:
+	TreeLDLT(const dart::dynamics::SkeletonPtr& skel);
+
+	// factorizes A = L^T D L, A must be symmetric positive definite with the sparsity of the skeleton
+	void Compute(const Eigen::MatrixXd& A);
+	// solves A x = b with the last factorization
+	Eigen::VectorXd Solve(const Eigen::VectorXd& b);
+
+	const std::vector<int>& GetParents() { return mParent; }
+private:
+	int mDof;
+	// parent dof of every dof, -1 for the first dof of the root joint
+	std::vector<int> mParent;
+	// unit lower L below the diagonal and D on the diagonal
+	Eigen::MatrixXd mLD;
+};
+}
+#endif
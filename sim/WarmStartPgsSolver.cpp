@@ -0,0 +1,229 @@
+#include "WarmStartPgsSolver.h"
+#include <cmath>
+namespace DPhy
+{
+// row stride of the lcp matrix, rows are padded to a multiple of four like dPAD of the ode solver
+static int
+Pad(int n)
+{
+	return n > 1 ? (((n - 1) | 3) + 1) : n;
+}
+WarmStartPgsSolver::
+WarmStartPgsSolver(dart::constraint::ConstraintSolver* solver)
+	:mConstraintSolver(solver), mMaxIteration(30), mTolerance(1e-3), mMatchRadius(0.02)
+{
+	this->ClearStats();
+}
+const std::string&
+WarmStartPgsSolver::
+getType() const
+{
+	return getStaticType();
+}
+const std::string&
+WarmStartPgsSolver::
+getStaticType()
+{
+	static const std::string type = "WarmStartPgsSolver";
+	return type;
+}
+void
+WarmStartPgsSolver::
+SetOption(int max_iteration, double tolerance, double match_radius)
+{
+	mMaxIteration = std::max(max_iteration, 1);
+	mTolerance = tolerance;
+	mMatchRadius = match_radius;
+}
+void
+WarmStartPgsSolver::
+Clear()
+{
+	mContacts.clear();
+	mOthers.clear();
+}
+void
+WarmStartPgsSolver::
+SetShapeFrames(const std::vector<const dart::dynamics::ShapeFrame*>& frames)
+{
+	mShapeFrames = frames;
+	mShapeFrameIndex.clear();
+	for(int i = 0; i < frames.size(); i++)
+		mShapeFrameIndex[frames[i]] = i;
+}
+void
+WarmStartPgsSolver::
+GetCache(std::vector<CachedImpulse>& contacts, std::vector<double>& others)
+{
+	contacts.clear();
+	for(int i = 0; i < mContacts.size(); i++) {
+		auto it1 = mShapeFrameIndex.find(mContacts[i].frame1);
+		auto it2 = mShapeFrameIndex.find(mContacts[i].frame2);
+		if(it1 == mShapeFrameIndex.end() || it2 == mShapeFrameIndex.end())
+			continue;
+		CachedImpulse c;
+		c.frame1 = it1->second;
+		c.frame2 = it2->second;
+		c.point = mContacts[i].point;
+		for(int j = 0; j < 3; j++)
+			c.x[j] = mContacts[i].x[j];
+		contacts.push_back(c);
+	}
+	others = mOthers;
+}
+void
+WarmStartPgsSolver::
+SetCache(const std::vector<CachedImpulse>& contacts, const std::vector<double>& others)
+{
+	mContacts.clear();
+	for(int i = 0; i < contacts.size(); i++) {
+		if(contacts[i].frame1 >= mShapeFrames.size() || contacts[i].frame2 >= mShapeFrames.size())
+			continue;
+		ContactImpulse c;
+		c.frame1 = mShapeFrames[contacts[i].frame1];
+		c.frame2 = mShapeFrames[contacts[i].frame2];
+		c.point = contacts[i].point;
+		for(int j = 0; j < 3; j++)
+			c.x[j] = contacts[i].x[j];
+		mContacts.push_back(c);
+	}
+	mOthers = others;
+}
+void
+WarmStartPgsSolver::
+ClearStats()
+{
+	mNumSolves = 0;
+	mNumWarmStarts = 0;
+	mNumIterations = 0;
+}
+bool
+WarmStartPgsSolver::
+WarmStart(int n, double* x, int* findex, int& num_contacts)
+{
+	for(int i = 0; i < n; i++)
+		x[i] = 0;
+
+	const dart::collision::CollisionResult& result = mConstraintSolver->getLastCollisionResult();
+	num_contacts = result.getNumContacts();
+	if(3 * num_contacts > n) {
+		num_contacts = 0;
+		return false;
+	}
+	for(int k = 0; k < num_contacts; k++) {
+		if(findex[3*k] != -1 || findex[3*k+1] != 3*k || findex[3*k+2] != 3*k) {
+			num_contacts = 0;
+			return false;
+		}
+	}
+
+	bool found = false;
+	mUsed.assign(mContacts.size(), false);
+	for(int k = 0; k < num_contacts; k++) {
+		const dart::collision::Contact& c = result.getContacts()[k];
+		int nearest = -1;
+		double nearest_dist = mMatchRadius;
+		for(int j = 0; j < mContacts.size(); j++) {
+			if(mUsed[j] || mContacts[j].frame1 != c.collisionObject1->getShapeFrame() || mContacts[j].frame2 != c.collisionObject2->getShapeFrame())
+				continue;
+			double dist = (mContacts[j].point - c.point).norm();
+			if(dist < nearest_dist) {
+				nearest = j;
+				nearest_dist = dist;
+			}
+		}
+		if(nearest != -1) {
+			mUsed[nearest] = true;
+			for(int i = 0; i < 3; i++)
+				x[3*k+i] = mContacts[nearest].x[i];
+			found = true;
+		}
+	}
+	if(mOthers.size() == n - 3 * num_contacts) {
+		for(int i = 0; i < mOthers.size(); i++)
+			x[3*num_contacts+i] = mOthers[i];
+		found = found || mOthers.size() > 0;
+	}
+	return found;
+}
+void
+WarmStartPgsSolver::
+Store(int n, double* x, int num_contacts)
+{
+	const dart::collision::CollisionResult& result = mConstraintSolver->getLastCollisionResult();
+	mContacts.resize(num_contacts);
+	for(int k = 0; k < num_contacts; k++) {
+		const dart::collision::Contact& c = result.getContacts()[k];
+		mContacts[k].frame1 = c.collisionObject1->getShapeFrame();
+		mContacts[k].frame2 = c.collisionObject2->getShapeFrame();
+		mContacts[k].point = c.point;
+		for(int i = 0; i < 3; i++)
+			mContacts[k].x[i] = x[3*k+i];
+	}
+	mOthers.assign(x + 3 * num_contacts, x + n);
+}
+void
+WarmStartPgsSolver::
+solve(int n, double* A, double* x, double* b, int nub, double* lo, double* hi, int* findex)
+{
+	const int nskip = Pad(n);
+	const double eps = 1e-9;
+
+	int num_contacts;
+	if(this->WarmStart(n, x, findex, num_contacts))
+		mNumWarmStarts += 1;
+	mNumSolves += 1;
+
+	std::vector<double> inv_diag(n, 0);
+	for(int i = 0; i < n; i++) {
+		if(A[nskip*i+i] >= eps)
+			inv_diag[i] = 1.0 / A[nskip*i+i];
+		else
+			x[i] = 0;
+	}
+
+	for(int iter = 0; iter < mMaxIteration; iter++) {
+		mNumIterations += 1;
+		bool converged = true;
+		for(int i = 0; i < n; i++) {
+			if(inv_diag[i] == 0)
+				continue;
+			const double* A_i = A + nskip*i;
+			double new_x = b[i];
+			for(int j = 0; j < i; j++)
+				new_x -= A_i[j] * x[j];
+			for(int j = i + 1; j < n; j++)
+				new_x -= A_i[j] * x[j];
+			new_x *= inv_diag[i];
+
+			double lo_i = lo[i], hi_i = hi[i];
+			if(findex[i] >= 0) {
+				hi_i = hi[i] * x[findex[i]];
+				lo_i = -hi_i;
+			}
+			new_x = std::max(lo_i, std::min(hi_i, new_x));
+
+			double dx = std::abs(new_x - x[i]);
+			if(converged && std::abs(new_x) > eps && dx > 1e-6 && dx > mTolerance * std::abs(new_x))
+				converged = false;
+			x[i] = new_x;
+		}
+		if(converged)
+			break;
+	}
+	this->Store(n, x, num_contacts);
+}
+#ifndef NDEBUG
+bool
+WarmStartPgsSolver::
+canSolve(int n, const double* A)
+{
+	const int nskip = Pad(n);
+	for(int i = 0; i < n; i++) {
+		if(A[nskip*i+i] <= 0)
+			return false;
+	}
+	return true;
+}
+#endif
+}
@@ -0,0 +1,84 @@
+#ifndef __DEEP_PHYSICS_WARM_START_PGS_SOLVER_H__
+#define __DEEP_PHYSICS_WARM_START_PGS_SOLVER_H__
+#include "dart/dart.hpp"
+#include <vector>
+#include <map>
+namespace DPhy
+{
+/**
+*
+* @brief Projected Gauss-Seidel boxed LCP solver that starts from the impulses of the previous substep.
+* @details The constraint solver builds one contact constraint per contact of its last collision result, in that
+* order and ahead of the other constraints, each with a normal row and two friction rows. Impulses are kept per
+* contact and matched to the new contacts by the pair of shape frames and the nearest point, the remaining rows
+* (joint limits) are reused when their count is unchanged. Iterations stop once the relative change of every
+* impulse is below the tolerance, which for persistent foot contacts happens after a few sweeps. Termination
+* constants default to the ones of dart's PgsBoxedLcpSolver. If the rows do not have the expected layout the
+* solve starts cold.
+*
+*/
+class WarmStartPgsSolver : public dart::constraint::BoxedLcpSolver
+{
+public:
+	WarmStartPgsSolver(dart::constraint::ConstraintSolver* solver);
+
+	const std::string& getType() const override;
+	static const std::string& getStaticType();
+
+	void solve(int n, double* A, double* x, double* b, int nub, double* lo, double* hi, int* findex) override;
+#ifndef NDEBUG
+	bool canSolve(int n, const double* A) override;
+#endif
+
+	void SetOption(int max_iteration, double tolerance, double match_radius);
+	// forgets the cached impulses, after the skeleton is moved
+	void Clear();
+
+	// cached impulse with the shape frames replaced by their index in the list given to SetShapeFrames, so the
+	// cache can be moved to a solver of another world with the same skeletons
+	struct CachedImpulse
+	{
+		int frame1;
+		int frame2;
+		Eigen::Vector3d point;
+		double x[3];
+	};
+	void SetShapeFrames(const std::vector<const dart::dynamics::ShapeFrame*>& frames);
+	void GetCache(std::vector<CachedImpulse>& contacts, std::vector<double>& others);
+	void SetCache(const std::vector<CachedImpulse>& contacts, const std::vector<double>& others);
+
+	// solves, solves that started warm and sweeps since the last ClearStats
+	long GetNumSolves() { return mNumSolves; }
+	long GetNumWarmStarts() { return mNumWarmStarts; }
+	long GetNumIterations() { return mNumIterations; }
+	void ClearStats();
+private:
+	struct ContactImpulse
+	{
+		const dart::dynamics::ShapeFrame* frame1;
+		const dart::dynamics::ShapeFrame* frame2;
+		Eigen::Vector3d point;
+		double x[3];
+	};
+	// fills x with cached impulses, returns whether any was found
+	bool WarmStart(int n, double* x, int* findex, int& num_contacts);
+	void Store(int n, double* x, int num_contacts);
+
+	dart::constraint::ConstraintSolver* mConstraintSolver;
+
+	int mMaxIteration;
+	double mTolerance;
+	double mMatchRadius;
+
+	std::vector<ContactImpulse> mContacts;
+	std::vector<double> mOthers;
+	std::vector<bool> mUsed;
+	std::vector<const dart::dynamics::ShapeFrame*> mShapeFrames;
+	std::map<const dart::dynamics::ShapeFrame*, int> mShapeFrameIndex;
+
+	long mNumSolves;
+	long mNumWarmStarts;
+	long mNumIterations;
+};
+}
+#endif
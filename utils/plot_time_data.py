@@ -37,5 +37,28 @@ def plot():
 
 	plt.show()
 
+def plot_scaling(path):
+	# csv written by network/scaling.py or bench/scaling_bench
+	data = np.genfromtxt(path, delimiter=',', names=True)
+
+	fig, (ax0, ax1, ax2) = plt.subplots(1, 3, figsize=(15, 4))
+	for n in np.unique(data['num_slaves']):
+		d = data[data['num_slaves'] == n]
+		ax0.plot(d['num_threads'], d['samples_per_sec'], marker='o', label='{} slaves'.format(int(n)))
+		ax1.plot(d['num_threads'], d['p50_ms'], marker='o', label='{} slaves p50'.format(int(n)))
+		ax1.plot(d['num_threads'], d['p99_ms'], linestyle='--', label='{} slaves p99'.format(int(n)))
+		ax2.plot(d['num_threads'], d['efficiency'], marker='o', label='{} slaves'.format(int(n)))
+
+	for ax, label in zip((ax0, ax1, ax2), ('samples/sec', 'step latency (ms)', 'parallel efficiency')):
+		ax.set_xlabel('threads')
+		ax.set_ylabel(label)
+		ax.legend(fontsize=8)
+	ax2.set_ylim([0, 1.1])
+
+	plt.show()
+
 if __name__=="__main__":
-	plot()
\ No newline at end of file
+	if len(sys.argv) > 1:
+		plot_scaling(sys.argv[1])
+	else:
+		plot()
\ No newline at end of file